@@ -0,0 +1,283 @@
+#include "wake_arena.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef ESP_PLATFORM
+	#include <esp_heap_caps.h>
+#endif
+
+#define ARENA_ALIGNMENT		8
+#define ALIGN_UP(x)			(((x) + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1))
+
+/* Every block is preceded by its size so the last block can be found and grown. */
+typedef struct {
+	size_t size;
+	size_t padding;
+} BlockHeader;
+
+static uint8_t *arena = 0;
+static size_t capacity = 0;
+static size_t top = 0;
+static size_t lastBlock = (size_t)-1;
+static size_t peak = 0;
+static int inPsram = 0;
+
+static void *overflow[WAKE_ARENA_MAX_OVERFLOW];
+static size_t overflowSize[WAKE_ARENA_MAX_OVERFLOW];
+/* in the order of allocation, so wakeArenaReset() knows which came after the mark */
+static unsigned overflowSerial[WAKE_ARENA_MAX_OVERFLOW];
+static unsigned nextOverflowSerial = 0;
+static size_t overflowUsed = 0;
+static size_t overflowPeak = 0;
+static unsigned overflowRefused = 0;
+
+static uint8_t *fixed = 0;
+static size_t fixedCapacity = 0;
+static size_t fixedTop = 0;
+static size_t fixedLastBlock = (size_t)-1;
+static size_t fixedPeak = 0;
+static int fixedInUse = 0;
+
+static int inArena(void *ptr) {
+	return arena && (uint8_t *)ptr >= arena && (uint8_t *)ptr < arena + capacity;
+}
+
+static int inFixed(void *ptr) {
+	return fixed && (uint8_t *)ptr >= fixed && (uint8_t *)ptr < fixed + fixedCapacity;
+}
+
+/* Like the arena without the heap behind it. */
+static void *fixedAlloc(size_t size) {
+	size_t needed = sizeof(BlockHeader) + ALIGN_UP(size);
+
+	if (fixedTop + needed > fixedCapacity)
+		return 0;
+
+	BlockHeader *header = (BlockHeader *)(fixed + fixedTop);
+	header->size = size;
+	fixedLastBlock = fixedTop;
+	fixedTop += needed;
+	if (fixedTop > fixedPeak)
+		fixedPeak = fixedTop;
+	return header + 1;
+}
+
+static void *overflowAlloc(size_t size) {
+	for (int i = 0; i < WAKE_ARENA_MAX_OVERFLOW; ++i) {
+		if (!overflow[i]) {
+			void *ptr = malloc(size);
+			if (!ptr)
+				return 0;
+			overflow[i] = ptr;
+			overflowSize[i] = size;
+			overflowSerial[i] = nextOverflowSerial++;
+			overflowUsed += size;
+			if (overflowUsed > overflowPeak)
+				overflowPeak = overflowUsed;
+			return ptr;
+		}
+	}
+
+	/* an untracked block would never be released */
+	overflowRefused++;
+	return 0;
+}
+
+static void overflowFree(void *ptr) {
+	for (int i = 0; i < WAKE_ARENA_MAX_OVERFLOW; ++i) {
+		if (overflow[i] == ptr) {
+			overflow[i] = 0;
+			overflowUsed -= overflowSize[i];
+			break;
+		}
+	}
+	free(ptr);
+}
+
+size_t wakeArenaInit(size_t size) {
+	if (arena)
+		return capacity;
+
+#ifdef ESP_PLATFORM
+	if (heap_caps_get_total_size(MALLOC_CAP_SPIRAM) > 0) {
+		arena = (uint8_t *)heap_caps_malloc(size, MALLOC_CAP_SPIRAM);
+		inPsram = arena != 0;
+	}
+	if (!arena) {
+		size_t largest = heap_caps_get_largest_free_block(MALLOC_CAP_8BIT);
+		if (largest < WAKE_ARENA_HEAP_RESERVE + WAKE_ARENA_MIN_SIZE)
+			return 0;
+		if (size > largest - WAKE_ARENA_HEAP_RESERVE)
+			size = largest - WAKE_ARENA_HEAP_RESERVE;
+		arena = (uint8_t *)heap_caps_malloc(size, MALLOC_CAP_8BIT);
+	}
+#else
+	arena = (uint8_t *)malloc(size);
+#endif
+	if (!arena)
+		return 0;
+
+	capacity = size;
+	top = 0;
+	lastBlock = (size_t)-1;
+	peak = 0;
+	return capacity;
+}
+
+void *wakeArenaAlloc(size_t size) {
+	if (fixedInUse)
+		return fixedAlloc(size);
+	return wakeArenaAllocBeside(size);
+}
+
+void *wakeArenaAllocBeside(size_t size) {
+	size_t needed = sizeof(BlockHeader) + ALIGN_UP(size);
+
+	if (!arena || top + needed > capacity)
+		return overflowAlloc(size);
+
+	BlockHeader *header = (BlockHeader *)(arena + top);
+	header->size = size;
+	lastBlock = top;
+	top += needed;
+	if (top > peak)
+		peak = top;
+	return header + 1;
+}
+
+void *wakeArenaRealloc(void *ptr, size_t oldSize, size_t newSize) {
+	if (!ptr)
+		return wakeArenaAlloc(newSize);
+
+	if (inArena(ptr) && (uint8_t *)ptr - sizeof(BlockHeader) == arena + lastBlock) {
+		size_t end = lastBlock + sizeof(BlockHeader) + ALIGN_UP(newSize);
+		if (end <= capacity) {
+			((BlockHeader *)ptr - 1)->size = newSize;
+			top = end;
+			if (top > peak)
+				peak = top;
+			return ptr;
+		}
+	}
+
+	void *moved = wakeArenaAlloc(newSize);
+	if (!moved)
+		return 0;
+	memcpy(moved, ptr, oldSize < newSize ? oldSize : newSize);
+	wakeArenaFree(ptr);
+	return moved;
+}
+
+void wakeArenaFree(void *ptr) {
+	if (!ptr)
+		return;
+
+	if (inFixed(ptr)) {
+		if ((uint8_t *)ptr - sizeof(BlockHeader) == fixed + fixedLastBlock) {
+			fixedTop = fixedLastBlock;
+			fixedLastBlock = (size_t)-1;
+		}
+		return;
+	}
+
+	if (!inArena(ptr)) {
+		overflowFree(ptr);
+		return;
+	}
+
+	/* Only the last block can be handed back, the previous one is not known anymore afterwards. */
+	if ((uint8_t *)ptr - sizeof(BlockHeader) == arena + lastBlock) {
+		top = lastBlock;
+		lastBlock = (size_t)-1;
+	}
+}
+
+void wakeArenaRelease(void) {
+	for (int i = 0; i < WAKE_ARENA_MAX_OVERFLOW; ++i) {
+		if (overflow[i]) {
+			free(overflow[i]);
+			overflow[i] = 0;
+		}
+	}
+	overflowUsed = 0;
+
+#ifdef ESP_PLATFORM
+	heap_caps_free(arena);
+#else
+	free(arena);
+#endif
+	arena = 0;
+	capacity = 0;
+	top = 0;
+	lastBlock = (size_t)-1;
+	inPsram = 0;
+
+	fixed = 0;
+	fixedCapacity = 0;
+	fixedInUse = 0;
+}
+
+WakeArenaMark wakeArenaMark(void) {
+	WakeArenaMark mark = {top, lastBlock, nextOverflowSerial};
+	return mark;
+}
+
+void wakeArenaReset(WakeArenaMark mark) {
+	for (int i = 0; i < WAKE_ARENA_MAX_OVERFLOW; ++i) {
+		/* allocated at or after the mark, also once the serials wrapped around */
+		if (overflow[i] && overflowSerial[i] - mark.overflowSerial < nextOverflowSerial - mark.overflowSerial)
+			overflowFree(overflow[i]);
+	}
+	if (mark.top <= top) {
+		top = mark.top;
+		lastBlock = mark.lastBlock;
+	}
+}
+
+size_t wakeArenaCapacity(void) {
+	return capacity;
+}
+
+size_t wakeArenaUsed(void) {
+	return top + overflowUsed;
+}
+
+size_t wakeArenaPeak(void) {
+	return peak;
+}
+
+void wakeArenaResetPeak(void) {
+	peak = top;
+	overflowPeak = overflowUsed;
+}
+
+size_t wakeArenaOverflowPeak(void) {
+	return overflowPeak;
+}
+
+unsigned wakeArenaOverflowRefused(void) {
+	return overflowRefused;
+}
+
+int wakeArenaInPsram(void) {
+	return inPsram;
+}
+
+void wakeArenaSetFixed(void *buffer, size_t size) {
+	fixed = (uint8_t *)buffer;
+	fixedCapacity = size;
+	fixedTop = 0;
+	fixedLastBlock = (size_t)-1;
+	fixedPeak = 0;
+	fixedInUse = 0;
+}
+
+void wakeArenaUseFixed(int use) {
+	fixedInUse = use && fixed;
+}
+
+size_t wakeArenaFixedPeak(void) {
+	return fixedPeak;
+}
@@ -0,0 +1,90 @@
+/*
+ * Wake scoped bump allocator.
+ *
+ * Every large buffer of a wake (download, frame buffer, image decoder state) is taken from one
+ * arena that is reserved at the start of the wake and released as a whole before deep sleep or
+ * restart, so the heap never fragments between wakes and the allocation pattern is the same on
+ * every wake. The arena lives in PSRAM when the board has it.
+ */
+
+#ifndef _WAKE_ARENA_H_
+#define _WAKE_ARENA_H_
+
+#include <stddef.h>
+
+#ifndef WAKE_ARENA_SIZE
+	#define WAKE_ARENA_SIZE			(256 * 1024)
+#endif
+/* Internal RAM left to WiFi and TLS when there is no PSRAM. */
+#ifndef WAKE_ARENA_HEAP_RESERVE
+	#define WAKE_ARENA_HEAP_RESERVE	(48 * 1024)
+#endif
+/*
+ * wakeArenaInit() fails rather than reserve less: the 61440 byte frame buffer of the panel and its neighbours.
+ * The frame buffer is taken first, before the download, so it always sits at the start of the arena. The download
+ * gets what is left and beyond that the tracked overflow, a download that does not fit fails before any drawing.
+ * The PNG decoder has a workspace of its own, see ws75bepd_png.h.
+ */
+#ifndef WAKE_ARENA_MIN_SIZE
+	#define WAKE_ARENA_MIN_SIZE		(61 * 1024)
+#endif
+/* Allocations that do not fit are served by the heap and tracked so they are released too, beyond that they fail. */
+#ifndef WAKE_ARENA_MAX_OVERFLOW
+	#define WAKE_ARENA_MAX_OVERFLOW	16
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Reserves up to size bytes. Returns the number of bytes actually reserved, 0 below WAKE_ARENA_MIN_SIZE. */
+size_t wakeArenaInit(size_t size);
+
+void *wakeArenaAlloc(size_t size);
+
+/* Grows in place if ptr is the last allocation, otherwise allocates and copies. */
+void *wakeArenaRealloc(void *ptr, size_t oldSize, size_t newSize);
+
+/* Only the last allocation is actually reclaimed, everything else is reclaimed by wakeArenaRelease(). */
+void wakeArenaFree(void *ptr);
+
+void wakeArenaRelease(void);
+
+/* Where the arena stands, to hand back everything allocated after it at once. */
+typedef struct WakeArenaMark {
+	size_t top;
+	size_t lastBlock;
+	unsigned overflowSerial;
+} WakeArenaMark;
+
+WakeArenaMark wakeArenaMark(void);
+/* Reclaims the arena blocks and frees the heap blocks allocated since mark, those before it stay valid. */
+void wakeArenaReset(WakeArenaMark mark);
+
+size_t wakeArenaCapacity(void);
+size_t wakeArenaUsed(void);
+size_t wakeArenaPeak(void);
+/* Starts a new peak measurement at the current fill level. */
+void wakeArenaResetPeak(void);
+size_t wakeArenaOverflowPeak(void);
+/* Heap allocations turned down because the overflow table was full. */
+unsigned wakeArenaOverflowRefused(void);
+int wakeArenaInPsram(void);
+
+/*
+ * A region beside the arena for a working set that is known in advance. While it is in use allocations
+ * come from the region and fail once it is full instead of going to the heap. Its blocks can be freed
+ * while it is not in use, wakeArenaSetFixed() empties it and wakeArenaRelease() forgets it.
+ */
+void wakeArenaSetFixed(void *buffer, size_t size);
+void wakeArenaUseFixed(int use);
+/* Allocates from the arena even while the region is in use, for buffers that outlive the working set. */
+void *wakeArenaAllocBeside(size_t size);
+/* The most of the region in use since wakeArenaSetFixed(). */
+size_t wakeArenaFixedPeak(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _WAKE_ARENA_H_ */
@@ -22,6 +22,21 @@
 #define VCM_DC_SETTING                  0x82
 #define FLASH_MODE                      0xE5
 
+/* Waveform tables, used instead of the OTP when PANEL_SETTING_REG_EN is set. */
+#define LUT_VCOM                        0x20
+#define LUT_BLACK                       0x21
+#define LUT_WHITE                       0x22
+#define LUT_GRAY_1                      0x23
+#define LUT_GRAY_2                      0x24
+#define LUT_RED_0                       0x25
+#define LUT_RED_1                       0x26
+#define LUT_RED_2                       0x27
+#define LUT_RED_3                       0x28
+#define LUT_XON                         0x29
+
+/* Bit of the first PANEL_SETTING byte selecting the LUT registers. */
+#define PANEL_SETTING_REG_EN            0x20
+
 #define DATA_START_TRANSMISSION_1       0x10
 
 #define POWER_OFF                       0x02
@@ -6,7 +6,7 @@
  */
 
 
-// definitions for Waveshare ESP32 Display Driver board
+// definitions for Waveshare ESP32 Display Driver board, every display has its own pins so one board can drive several panels
 
 #ifndef GDISP_LLD_BOARD_H
 #define GDISP_LLD_BOARD_H
@@ -14,43 +14,58 @@
 #include <Arduino.h>
 #include <gfx.h>
 #include "WS75bEPD.h"
-
-#define PIN_SPI_SCK  13
-#define PIN_SPI_DIN  14
-#define PIN_SPI_CS   15
-#define PIN_SPI_BUSY 25
-#define PIN_SPI_RST  26
-#define PIN_SPI_DC   27
+#include "ws75bepd_driver.h"
 
 #define GPIO_PIN_SET   1
 #define GPIO_PIN_RESET 0
 
-static GFXINLINE void spi_transfer(gU8 data) {
-    digitalWrite(PIN_SPI_CS, GPIO_PIN_RESET);
+static WS75bEPDPins boardPins[GDISP_TOTAL_DISPLAYS];
+static gBool boardPinsSet[GDISP_TOTAL_DISPLAYS];
+
+#define BOARD_PINS(g)	((const WS75bEPDPins *)(g)->board)
+
+static GFXINLINE void set_board_pins(unsigned display, const WS75bEPDPins *pins) {
+    if (display >= GDISP_TOTAL_DISPLAYS)
+        return;
+    boardPins[display] = *pins;
+    boardPinsSet[display] = gTrue;
+}
 
+static GFXINLINE void spi_shift_out(const WS75bEPDPins *pins, gU8 data) {
     for (int i=0; i<8; ++i) {
-        if ((data & 0x80) == 0) digitalWrite(PIN_SPI_DIN, GPIO_PIN_RESET);
-        else                    digitalWrite(PIN_SPI_DIN, GPIO_PIN_SET);
+        if ((data & 0x80) == 0) digitalWrite(pins->din, GPIO_PIN_RESET);
+        else                    digitalWrite(pins->din, GPIO_PIN_SET);
     
         data <<= 1;
-        digitalWrite(PIN_SPI_SCK, GPIO_PIN_SET);
-        digitalWrite(PIN_SPI_SCK, GPIO_PIN_RESET);
+        digitalWrite(pins->sck, GPIO_PIN_SET);
+        digitalWrite(pins->sck, GPIO_PIN_RESET);
     }
+}
 
-    digitalWrite(PIN_SPI_CS, GPIO_PIN_SET);
+static GFXINLINE void spi_transfer(const WS75bEPDPins *pins, gU8 data) {
+    digitalWrite(pins->cs, GPIO_PIN_RESET);
+    spi_shift_out(pins, data);
+    digitalWrite(pins->cs, GPIO_PIN_SET);
 }
 
 static GFXINLINE void init_board(GDisplay *g) {
-    pinMode(PIN_SPI_BUSY, INPUT);
-    pinMode(PIN_SPI_RST, OUTPUT);
-    pinMode(PIN_SPI_DC, OUTPUT);
+    unsigned display = g->controllerdisplay;
+
+    if (!boardPinsSet[display])
+        boardPins[display] = ws75bepdDefaultPins;
+    g->board = &boardPins[display];
+    const WS75bEPDPins *pins = BOARD_PINS(g);
 
-    pinMode(PIN_SPI_SCK, OUTPUT);
-    pinMode(PIN_SPI_DIN, OUTPUT);
-    pinMode(PIN_SPI_CS, OUTPUT);
+    pinMode(pins->busy, INPUT);
+    pinMode(pins->rst, OUTPUT);
+    pinMode(pins->dc, OUTPUT);
 
-    digitalWrite(PIN_SPI_CS, HIGH);
-    digitalWrite(PIN_SPI_SCK, LOW);
+    pinMode(pins->sck, OUTPUT);
+    pinMode(pins->din, OUTPUT);
+    pinMode(pins->cs, OUTPUT);
+
+    digitalWrite(pins->cs, HIGH);
+    digitalWrite(pins->sck, LOW);
 }
 
 static GFXINLINE void post_init_board(GDisplay *g) {
@@ -59,9 +74,9 @@ static GFXINLINE void post_init_board(GDisplay *g) {
 
 static GFXINLINE void setpin_reset(GDisplay *g, gBool state) {
 	if (state) {
-        digitalWrite(PIN_SPI_RST, HIGH);
+        digitalWrite(BOARD_PINS(g)->rst, HIGH);
     } else {
-        digitalWrite(PIN_SPI_RST, LOW);
+        digitalWrite(BOARD_PINS(g)->rst, LOW);
     }
 }
 
@@ -74,17 +89,27 @@ static GFXINLINE void release_bus(GDisplay *g) {
 }
 
 static GFXINLINE void write_data(GDisplay *g, gU8 data) {
-	digitalWrite(PIN_SPI_DC, HIGH);
-    spi_transfer(data);
+	digitalWrite(BOARD_PINS(g)->dc, HIGH);
+    spi_transfer(BOARD_PINS(g), data);
 }
 
 static GFXINLINE void wait_until_idle(GDisplay *g) {
-    while(digitalRead(PIN_SPI_BUSY) == 0) gfxSleepMilliseconds(100);  
+    while(digitalRead(BOARD_PINS(g)->busy) == 0) gfxSleepMilliseconds(10);
+}
+
+static GFXINLINE void delay_ms(GDisplay *g, gDelay ms) {
+	(void) g;
+	gfxSleepMilliseconds(ms);
+}
+
+static GFXINLINE gU32 board_millis(GDisplay *g) {
+	(void) g;
+	return millis();
 }
 
 static GFXINLINE void write_cmd(GDisplay *g, gU8 reg){
-    digitalWrite(PIN_SPI_DC, LOW);
-    spi_transfer(reg);
+    digitalWrite(BOARD_PINS(g)->dc, LOW);
+    spi_transfer(BOARD_PINS(g), reg);
 }
 
 static GFXINLINE void write_reg(GDisplay *g, gU8 reg, gU8 data){
@@ -92,12 +117,19 @@ static GFXINLINE void write_reg(GDisplay *g, gU8 reg, gU8 data){
     write_data(g, data);
 }
 
-static GFXINLINE void write_reg_data(GDisplay *g, gU8 reg, gU8 *data, gU8 len) {
+/* Sends the bytes in one transfer, chip select stays low and DC high for all of them. */
+static GFXINLINE void write_data_block(GDisplay *g, const gU8 *data, gU32 len) {
+    const WS75bEPDPins *pins = BOARD_PINS(g);
+    digitalWrite(pins->dc, HIGH);
+    digitalWrite(pins->cs, GPIO_PIN_RESET);
+    for (gU32 i=0; i<len; ++i)
+        spi_shift_out(pins, data[i]);
+    digitalWrite(pins->cs, GPIO_PIN_SET);
+}
+
+static GFXINLINE void write_reg_data(GDisplay *g, gU8 reg, const gU8 *data, gU8 len) {
     write_cmd(g, reg);
-    for (int i=0; i<len; ++i) {
-        write_data(g, *data);
-        data++;
-    }
+    write_data_block(g, data, len);
 }
 
 #endif /* GDISP_LLD_BOARD_H */
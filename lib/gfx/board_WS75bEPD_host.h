@@ -0,0 +1,195 @@
+/*
+ * This file is subject to the terms of the GFX License. If a copy of
+ * the license was not distributed with this file, you can obtain one at:
+ *
+ *              http://ugfx.io/license.html
+ */
+
+
+// mock board for host builds (WS75bEPD_HOST): captures what would go over SPI and simulates the timing of the panel
+
+#ifndef GDISP_LLD_BOARD_H
+#define GDISP_LLD_BOARD_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <gfx.h>
+#include "WS75bEPD.h"
+#include "ws75bepd_driver.h"
+#include "ws75bepd_pack.h"
+
+/* Rough timings of the real board, the bit banged SPI needs about 20 us per single byte transfer. */
+#ifndef WS75bEPD_HOST_BYTE_US
+	#define WS75bEPD_HOST_BYTE_US		16
+#endif
+/* toggling chip select and DC around a transfer */
+#ifndef WS75bEPD_HOST_SELECT_US
+	#define WS75bEPD_HOST_SELECT_US		4
+#endif
+#ifndef WS75bEPD_HOST_POWER_ON_MS
+	#define WS75bEPD_HOST_POWER_ON_MS	120
+#endif
+/* refresh with the OTP waveform */
+#ifndef WS75bEPD_HOST_REFRESH_MS
+	#define WS75bEPD_HOST_REFRESH_MS	16000
+#endif
+/* a waveform frame at the 50 Hz of PLL_CONTROL 0x3c, refreshes from the LUT registers take as many frames as LUT_VCOM */
+#define WS75bEPD_HOST_FRAME_MS			20
+#define WS75bEPD_HOST_LUT_SIZE			60
+
+typedef struct WS75bEPDHostBoard {
+	/* data bytes following the last DATA_START_TRANSMISSION_1 */
+	gU8 capture[WS75bEPD_STREAM_BYTES];
+	gU32 captureLength;
+
+	/* simulated time, ownNowUs or the clock all boards share, see ws75bepdHostShareClock */
+	unsigned long long *nowUs;
+	unsigned long long ownNowUs;
+	unsigned long long busyUntilUs;
+	gU32 refreshMs;
+
+	gU8 lastCommand;
+	gU32 commandBytes;		/* data bytes since the last command */
+	gBool registerLut;		/* PANEL_SETTING_REG_EN */
+	gU8 lutVcom[WS75bEPD_HOST_LUT_SIZE];
+	gU32 lutVcomLength;
+	gU32 commands;
+	gU32 dataBytes;
+	gU32 resets;
+	gU32 delayMs;
+	gU32 busyMs;
+
+	/* optional, one line per command, delay and busy wait */
+	FILE *trace;
+} WS75bEPDHostBoard;
+
+#define HOST_BOARD(g)	((WS75bEPDHostBoard *)(g)->board)
+
+static unsigned long long sharedNowUs;
+
+static GFXINLINE void set_board_pins(unsigned display, const WS75bEPDPins *pins) {
+	(void) display;
+	(void) pins;
+}
+
+static GFXINLINE void advance_clock(WS75bEPDHostBoard *board, gU32 us) {
+	*board->nowUs += us;
+	if (ws75bepdHostClock)
+		ws75bepdHostClock(us);
+}
+
+static GFXINLINE void init_board(GDisplay *g) {
+	if (!g->board) {
+		g->board = calloc(1, sizeof(WS75bEPDHostBoard));
+		HOST_BOARD(g)->refreshMs = WS75bEPD_HOST_REFRESH_MS;
+		HOST_BOARD(g)->nowUs = ws75bepdHostShareClock ? &sharedNowUs : &HOST_BOARD(g)->ownNowUs;
+	}
+}
+
+static GFXINLINE void post_init_board(GDisplay *g) {
+	(void) g;
+}
+
+static GFXINLINE void setpin_reset(GDisplay *g, gBool state) {
+	if (!state)
+		HOST_BOARD(g)->resets++;
+}
+
+static GFXINLINE void acquire_bus(GDisplay *g) {
+	(void) g;
+}
+
+static GFXINLINE void release_bus(GDisplay *g) {
+	(void) g;
+}
+
+static GFXINLINE void delay_ms(GDisplay *g, gDelay ms) {
+	WS75bEPDHostBoard *board = HOST_BOARD(g);
+	advance_clock(board, ms * 1000);
+	board->delayMs += ms;
+	if (board->trace)
+		fprintf(board->trace, "%10.3f delay %u ms\n", *board->nowUs / 1000.0, (unsigned)ms);
+}
+
+static GFXINLINE gU32 board_millis(GDisplay *g) {
+	return *HOST_BOARD(g)->nowUs / 1000;
+}
+
+static GFXINLINE void receive_data(WS75bEPDHostBoard *board, gU8 data) {
+	advance_clock(board, WS75bEPD_HOST_BYTE_US);
+	board->dataBytes++;
+	if (board->lastCommand == PANEL_SETTING && board->commandBytes == 0)
+		board->registerLut = (data & PANEL_SETTING_REG_EN) != 0;
+	if (board->lastCommand == LUT_VCOM && board->commandBytes < WS75bEPD_HOST_LUT_SIZE)
+		board->lutVcom[board->lutVcomLength++] = data;
+	board->commandBytes++;
+	if (board->lastCommand == DATA_START_TRANSMISSION_1 && board->captureLength < WS75bEPD_STREAM_BYTES)
+		board->capture[board->captureLength++] = data;
+}
+
+static GFXINLINE void write_data(GDisplay *g, gU8 data) {
+	advance_clock(HOST_BOARD(g), WS75bEPD_HOST_SELECT_US);
+	receive_data(HOST_BOARD(g), data);
+}
+
+static GFXINLINE void write_data_block(GDisplay *g, const gU8 *data, gU32 len) {
+	advance_clock(HOST_BOARD(g), WS75bEPD_HOST_SELECT_US);
+	for (gU32 i=0; i<len; ++i)
+		receive_data(HOST_BOARD(g), data[i]);
+}
+
+/* Every group of 6 bytes runs the frames of its four phases as often as its last byte says. */
+static GFXINLINE gU32 lut_refresh_ms(const WS75bEPDHostBoard *board) {
+	gU32 frames = 0;
+	for (gU32 i = 0; i + 6 <= board->lutVcomLength; i += 6)
+		frames += (board->lutVcom[i + 1] + board->lutVcom[i + 2] + board->lutVcom[i + 3] + board->lutVcom[i + 4]) * board->lutVcom[i + 5];
+	return frames * WS75bEPD_HOST_FRAME_MS;
+}
+
+static GFXINLINE void wait_until_idle(GDisplay *g) {
+	WS75bEPDHostBoard *board = HOST_BOARD(g);
+	if (board->busyUntilUs > *board->nowUs) {
+		gU32 waited = (board->busyUntilUs - *board->nowUs) / 1000;
+		board->busyMs += waited;
+		advance_clock(board, board->busyUntilUs - *board->nowUs);
+		if (board->trace)
+			fprintf(board->trace, "%10.3f busy %u ms\n", *board->nowUs / 1000.0, (unsigned)waited);
+	}
+}
+
+static GFXINLINE void write_cmd(GDisplay *g, gU8 reg){
+	WS75bEPDHostBoard *board = HOST_BOARD(g);
+	advance_clock(board, WS75bEPD_HOST_SELECT_US + WS75bEPD_HOST_BYTE_US);
+	board->lastCommand = reg;
+	board->commandBytes = 0;
+	board->commands++;
+	if (board->trace)
+		fprintf(board->trace, "%10.3f cmd 0x%02x\n", *board->nowUs / 1000.0, reg);
+
+	switch (reg) {
+		case DATA_START_TRANSMISSION_1:
+			board->captureLength = 0;
+			break;
+		case LUT_VCOM:
+			board->lutVcomLength = 0;
+			break;
+		case POWER_ON:
+			board->busyUntilUs = *board->nowUs + WS75bEPD_HOST_POWER_ON_MS * 1000ull;
+			break;
+		case DISPLAY_REFRESH:
+			board->busyUntilUs = *board->nowUs + (board->registerLut ? lut_refresh_ms(board) : board->refreshMs) * 1000ull;
+			break;
+	}
+}
+
+static GFXINLINE void write_reg(GDisplay *g, gU8 reg, gU8 data){
+    write_cmd(g, reg);
+    write_data(g, data);
+}
+
+static GFXINLINE void write_reg_data(GDisplay *g, gU8 reg, const gU8 *data, gU8 len) {
+    write_cmd(g, reg);
+    write_data_block(g, data, len);
+}
+
+#endif /* GDISP_LLD_BOARD_H */
@@ -13,184 +13,312 @@
 #include "gdisp_lld_config.h"
 #include "ugfx/src/gdisp/gdisp_driver.h"
 
-#include "board_WS75bEPD.h"
+#ifdef WS75bEPD_HOST
+	#include "board_WS75bEPD_host.h"
+#else
+	#include "board_WS75bEPD.h"
+	#include "freertos/FreeRTOS.h"
+	#include "freertos/task.h"
+#endif
 #include "WS75bEPD.h"
+#include "gfx_arena.h"
+#include "ws75bepd_driver.h"
+#include "ws75bepd_dither.h"
+#include "ws75bepd_pack.h"
+#include "ws75bepd_pipeline.h"
+#include "ws75bepd_scale.h"
 
 /*===========================================================================*/
 /* Driver local definitions.                                                 */
 /*===========================================================================*/
 
-#ifndef GDISP_SCREEN_HEIGHT
-	#define GDISP_SCREEN_HEIGHT		384
-#endif
-#ifndef GDISP_SCREEN_WIDTH
-	#define GDISP_SCREEN_WIDTH		640
-#endif
+static const gU8 powerSettingData[] = {0x37, 0x00};
+static const gU8 panelSettingData[] = {0xcf, 0x08};
+static const gU8 boosterSoftStartData[] = {0xc7, 0xcc, 0x28};
+static const gU8 pllControlData[] = {0x3c};
+static const gU8 temperateCalibrationData[] = {0x00};
+static const gU8 vcomAndDataIntervalData[] = {0x77};
+static const gU8 tconSettingData[] = {0x22};
+static const gU8 tconResolutionData[] = {0x02, 0x80, 0x01, 0x80};
+static const gU8 vcmDcSettingData[] = {0x1e};
+static const gU8 flashModeData[] = {0x03};
+
+typedef struct WS75bEPDRegister {
+	gU8 reg;
+	const gU8 *data;
+	gU8 length;
+} WS75bEPDRegister;
 
-gU8 powerSettingData[] = {0x37, 0x00};
-gU8 panelSettingData[] = {0xcf, 0x08};
-gU8 boosterSoftStartData[] = {0xc7, 0xcc, 0x28};
-gU8 pllControlData[] = {0x3c};
-gU8 temperateCalibrationData[] = {0x00};
-gU8 vcomAndDataIntervalData[] = {0x77};
-gU8 tconSettingData[] = {0x22};
-gU8 tconResolutionData[] = {0x02, 0x80, 0x01, 0x80};
-gU8 vcmDcSettingData[] = {0x1e};
-gU8 flashModeData[] = {0x03};
-
-/* dithering theshold matrix */
-gU8 thresholdMatrix[] = {0, 7, 3, 6, 5, 2, 4, 1, 8};
-float thresholdDivisor = 9;
-
-
-/* Every data byte determines 4 pixels. */
-#ifndef WS75bEPD_PPB
-  #define WS75bEPD_PPB   4
-#endif
+/*
+ * The start up sequence according to WaveShare: power and booster, POWER_ON and its busy wait, then the
+ * rest of the configuration. Each table goes out back to back under one bus acquisition, every register
+ * still as its own command byte followed by one block of data.
+ */
+static const WS75bEPDRegister powerSequence[] = {
+	{POWER_SETTING, powerSettingData, sizeof(powerSettingData)},
+	{PANEL_SETTING, panelSettingData, sizeof(panelSettingData)},
+	{BOOSTER_SOFT_START, boosterSoftStartData, sizeof(boosterSoftStartData)},
+};
+
+static const WS75bEPDRegister configSequence[] = {
+	{PLL_CONTROL, pllControlData, sizeof(pllControlData)},
+	{TEMP_SENSOR_CTRL, temperateCalibrationData, sizeof(temperateCalibrationData)},
+	{VCOM_AND_DATA_INTERVAL_SETTING, vcomAndDataIntervalData, sizeof(vcomAndDataIntervalData)},
+	{TCON_SETTING, tconSettingData, sizeof(tconSettingData)},
+	{TCON_RESOLUTION, tconResolutionData, sizeof(tconResolutionData)},
+	{VCM_DC_SETTING, vcmDcSettingData, sizeof(vcmDcSettingData)},
+	{FLASH_MODE, flashModeData, sizeof(flashModeData)},
+};
+
+/*
+ * Black and white waveform for frames without red. Every group of 6 bytes holds the levels of four
+ * phases (2 bits each, 00 GND, 01 VDH, 10 VDL, 11 floating), the frames of the four phases and how
+ * often the group repeats. A short shake balances the charge, then every pixel is driven to its color.
+ * 60 frames at 50 Hz instead of the 16 s of the OTP waveform, tune on the panel against ghosting.
+ */
+#define FAST_SHAKE_FRAMES		10
+#define FAST_DRIVE_FRAMES		20
+
+static const gU8 fastLutVcom[] = {0x00, FAST_SHAKE_FRAMES, FAST_SHAKE_FRAMES, FAST_DRIVE_FRAMES, FAST_DRIVE_FRAMES, 1};
+static const gU8 fastLutBlack[] = {0x62, FAST_SHAKE_FRAMES, FAST_SHAKE_FRAMES, FAST_DRIVE_FRAMES, FAST_DRIVE_FRAMES, 1};	/* VDH VDL GND VDL */
+static const gU8 fastLutWhite[] = {0x91, FAST_SHAKE_FRAMES, FAST_SHAKE_FRAMES, FAST_DRIVE_FRAMES, FAST_DRIVE_FRAMES, 1};	/* VDL VDH GND VDH */
+
+const WS75bEPDLut ws75bepdFastLut = {
+	/* gray and red pixels get the white waveform */
+	{fastLutVcom, fastLutBlack, fastLutWhite, fastLutWhite, fastLutWhite, fastLutWhite, fastLutWhite, fastLutWhite, fastLutWhite, 0},
+	{sizeof(fastLutVcom), sizeof(fastLutBlack), sizeof(fastLutWhite), sizeof(fastLutWhite), sizeof(fastLutWhite),
+	 sizeof(fastLutWhite), sizeof(fastLutWhite), sizeof(fastLutWhite), sizeof(fastLutWhite), 0}
+};
+
+/* What the controller is known to be doing, so no reset or register write is sent twice. */
+typedef enum WS75bEPDPanelState {
+	WS75bEPD_PANEL_UNKNOWN,			/* after the MCU started, the controller may still be awake */
+	WS75bEPD_PANEL_DEEP_SLEEP,		/* only a reset wakes it up, the registers are lost */
+	WS75bEPD_PANEL_READY			/* configured and powered on */
+} WS75bEPDPanelState;
+
+typedef struct WS75bEPDPrivate {
+	WS75bEPDPanelState panel;
+	const WS75bEPDLut *loadedLut;		/* in the LUT registers and used instead of the OTP, 0 for the OTP */
+	WS75bEPDRefresh refresh;
+	const WS75bEPDLut *lut;			/* for WS75bEPD_REFRESH_FAST */
+	WS75bEPDDither ditherMode;
+	WS75bEPDDiffusion diffusion;
+	gU8 *frame;		/* see ws75bepd_pack.h for the layout, allocated by the first pixel that is not white */
+	gBool frameFailed;		/* the frame buffer could not be allocated, it is not tried again */
+	gBool pixelsLost;		/* pixels that were not white were dropped for want of the frame buffer */
+	WS75bEPDScaler *scaler;		/* while WS75bEPD_CONTROL_SCALE is active */
+	gCoord width, height;		/* of the display while the scaler has the size of the image */
+	struct WS75bEPDPipeline *pipeline;		/* while WS75bEPD_CONTROL_PIPELINE is active */
+	gBool overlap;		/* WS75bEPD_CONTROL_OVERLAP */
+	gBool refreshing;		/* DISPLAY_REFRESH was sent and BUSY not waited for yet */
+	gU32 refreshStart;
+} WS75bEPDPrivate;
+
+#define PRIV(g)		((WS75bEPDPrivate *)(g)->priv)
 
 /*===========================================================================*/
 /* Driver local variables.                                                   */
 /*===========================================================================*/
 
-/* initialization variables according to WaveShare. */
-// gU8 LUTDefault_full[]    = {0x02,0x02,0x01,0x11,0x12,0x12,0x22,0x22,0x66,0x69,0x69,0x59,0x58,0x99,0x99,0x88,0x00,0x00,0x00,0x00,0xF8,0xB4,0x13,0x51,0x35,0x51,0x51,0x19,0x01,0x00}; // Initialize the full display
+/* SCK, DIN, CS, BUSY, RST and DC */
+const WS75bEPDPins ws75bepdDefaultPins = {13, 14, 15, 25, 26, 27};
+
+gU32 ws75bepdRefreshBusyMs = 0;
+WS75bEPDRefresh ws75bepdLastRefresh = WS75bEPD_REFRESH_FULL;
+gBool ws75bepdFlushRefused = gFalse;
+WS75bEPDScaleStats ws75bepdLastScale;
+WS75bEPDPipelineStats ws75bepdLastPipeline;
 
-# define BLOCK_SIZE(x) sizeof(x) / sizeof(x[0])
 /*===========================================================================*/
 /* Driver local functions.                                                   */
 /*===========================================================================*/
 
-static inline void startUpDisplay(GDisplay* g) {
-	write_reg_data(g, POWER_SETTING, powerSettingData, BLOCK_SIZE(powerSettingData));
-	write_reg_data(g, PANEL_SETTING, panelSettingData, BLOCK_SIZE(panelSettingData));
-	write_reg_data(g, BOOSTER_SOFT_START, boosterSoftStartData, BLOCK_SIZE(boosterSoftStartData));
+static void resetDisplay(GDisplay* g) {
+	setpin_reset(g, gFalse);
+	delay_ms(g, 200);
+	setpin_reset(g, gTrue);
+	delay_ms(g, 200);
+}
+
+static void panelDeepSleep(GDisplay* g);
+
+/* Waits for the end of the refresh the last flush started and puts the panel back to sleep. */
+static void finishRefresh(GDisplay* g) {
+	if (!PRIV(g)->refreshing)
+		return;
+
+	PRIV(g)->refreshing = gFalse;
+	wait_until_idle(g);
+	ws75bepdRefreshBusyMs = board_millis(g) - PRIV(g)->refreshStart;
+	panelDeepSleep(g);
+}
+
+static void writeRegisters(GDisplay* g, const WS75bEPDRegister *registers, unsigned count) {
+	for (unsigned i = 0; i < count; i++)
+		write_reg_data(g, registers[i].reg, registers[i].data, registers[i].length);
+}
+
+/* Wakes and configures the controller unless it is ready already. */
+static void panelReady(GDisplay* g) {
+	finishRefresh(g);
+	if (PRIV(g)->panel == WS75bEPD_PANEL_READY)
+		return;
+
+	resetDisplay(g);
+	acquire_bus(g);
+	writeRegisters(g, powerSequence, sizeof(powerSequence) / sizeof(powerSequence[0]));
 	write_cmd(g, POWER_ON);
 	wait_until_idle(g);
+	writeRegisters(g, configSequence, sizeof(configSequence) / sizeof(configSequence[0]));
+	release_bus(g);
+	PRIV(g)->panel = WS75bEPD_PANEL_READY;
+	PRIV(g)->loadedLut = 0;
+	g->g.Powermode = gPowerOn;
+}
 
-	write_reg_data(g, PLL_CONTROL, pllControlData, BLOCK_SIZE(pllControlData));
-	write_reg_data(g, TEMP_SENSOR_CTRL, temperateCalibrationData, BLOCK_SIZE(temperateCalibrationData));
-	write_reg_data(g, VCOM_AND_DATA_INTERVAL_SETTING, vcomAndDataIntervalData, BLOCK_SIZE(vcomAndDataIntervalData));
-	write_reg_data(g, TCON_SETTING, tconSettingData, BLOCK_SIZE(tconSettingData));
-	write_reg_data(g, TCON_RESOLUTION, tconResolutionData, BLOCK_SIZE(tconResolutionData));
-	write_reg_data(g, VCM_DC_SETTING, vcmDcSettingData, BLOCK_SIZE(vcmDcSettingData));
-	write_reg_data(g, FLASH_MODE, flashModeData, BLOCK_SIZE(flashModeData));
+static void panelDeepSleep(GDisplay* g) {
+	finishRefresh(g);
+	if (PRIV(g)->panel == WS75bEPD_PANEL_DEEP_SLEEP)
+		return;
 
-	write_cmd(g, DATA_START_TRANSMISSION_1);
-	gfxSleepMilliseconds(2);
+	acquire_bus(g);
+	write_cmd(g, POWER_OFF);
+	write_reg(g, DEEP_SLEEP_MODE, 0xA5);
+	release_bus(g);
+	PRIV(g)->panel = WS75bEPD_PANEL_DEEP_SLEEP;
+	g->g.Powermode = gPowerDeepSleep;
 }
 
-inline gU8 orderedDithering(GDisplay* g, gCoord x, gCoord y) {
-	gColor luma = EXACT_LUMA_OF(g->p.color);
-	float thresholdingFactor = (float)(thresholdMatrix[y % 3 * 3 + x % 3]) / thresholdDivisor - 0.5;
+/* Switches between the OTP and the LUT registers, the panel has to be ready. */
+static void selectWaveform(GDisplay* g, gBool fast) {
+	const WS75bEPDLut *lut = fast ? PRIV(g)->lut : 0;
+	if (PRIV(g)->loadedLut == lut)
+		return;
 
-	luma = luma + (int)(128.0 * thresholdingFactor);
+	gU8 panelSetting[] = {panelSettingData[0], panelSettingData[1]};
+	if (lut)
+		panelSetting[0] |= PANEL_SETTING_REG_EN;
 
-	gU8 colorValue;
-	if (luma < 128) {
-		colorValue = PIXEL_COLOR_BLACK;
-	} else {
-		colorValue = PIXEL_COLOR_WHITE;
+	acquire_bus(g);
+	write_reg_data(g, PANEL_SETTING, panelSetting, sizeof(panelSetting));
+	if (lut) {
+		for (int i = 0; i < WS75bEPD_LUT_COUNT; i++) {
+			if (lut->length[i])
+				write_reg_data(g, LUT_VCOM + i, lut->data[i], lut->length[i]);
+		}
 	}
-	return colorValue;
+	release_bus(g);
+	PRIV(g)->loadedLut = lut;
 }
 
-static inline void resetDisplay(GDisplay* g) {
-	setpin_reset(g, gFalse);
-	gfxSleepMilliseconds(200);
-	setpin_reset(g, gTrue);
-	gfxSleepMilliseconds(200);
+/* A red pixel is 01 in any of the 2 bit fields. */
+static inline gBool hasRed(gU8 pixelValues) {
+	return (pixelValues & ~(pixelValues >> 1) & 0x55) != 0;
 }
 
-LLDSPEC gBool gdisp_lld_init(GDisplay *g) {
-	/* Use the private area as a frame buffer.
-	*
-	* The frame buffer will be one big array of bytes storing all the pixels with WS29EPD_PPB pixel per byte.
-	* For the layout, the frame will be stored line by line in the x-direction.
-	* So: [Line x=0][Line x=1][Line x=2] ... [Line x=GDISP_SCREEN_WIDTH/WS29EPD_PPB]
-	* And every x-line contains GDISP_SCREEN_HEIGHT y-values:
-	* [y=0; y=1; y=2; y=3; ...; y=GDISP_SCREEN_HEIGHT][y=0; y=1; y=2; y=3; ...; y=GDISP_SCREEN_HEIGHT]...
-	*
-	*/
-
-	g->priv = gfxAlloc((GDISP_SCREEN_WIDTH / WS75bEPD_PPB) * GDISP_SCREEN_HEIGHT * sizeof(gU8));
-	if (!g->priv)
+static gBool frameHasRed(const gU8 *frame) {
+	if (!frame)
 		return gFalse;
+	for (gU32 i = 0; i < WS75bEPD_FRAME_BYTES; i++) {
+		if (hasRed(frame[i]))
+			return gTrue;
+	}
+	return gFalse;
+}
 
-	/* Initialize the LL hardware. */
-	init_board(g);
+static gBool payloadHasRed(const gU8 *payload, const WS75bEPDFrameHeader *header) {
+	if (header->encoding == WS75bEPD_ENCODING_PACKBITS) {
+		WS75bEPDUnpacker unpacker;
+		gU8 pixelValues;
+		ws75bepdUnpackBegin(&unpacker, payload, header->payloadLength);
+		while (ws75bepdUnpackByte(&unpacker, &pixelValues)) {
+			if (hasRed(pixelValues))
+				return gTrue;
+		}
+		return gFalse;
+	}
+	for (gU32 i = 0; i < header->payloadLength; i++) {
+		if (hasRed(payload[i]))
+			return gTrue;
+	}
+	return gFalse;
+}
 
-	/* Hardware reset. */
-	resetDisplay(g);
+static inline gU8 orderedDithering(gColor color, gCoord x, gCoord y) {
+	return ws75bepdQuantiseOrdered(RED_OF(color), GREEN_OF(color), BLUE_OF(color), x, y);
+}
 
-	/* Acquire the bus for the whole initialization. */
-	acquire_bus(g);
+/* Diffuses along the rows as they are drawn, so it works on the orientation independent coordinates. */
+static inline gU8 diffusedDithering(GDisplay* g, gColor color, gCoord px, gCoord py) {
+	return ws75bepdQuantiseDiffused(&PRIV(g)->diffusion, RED_OF(color), GREEN_OF(color), BLUE_OF(color), px, py);
+}
+
+static gBool setDitherMode(GDisplay* g, WS75bEPDDither mode) {
+	WS75bEPDDiffusion *diffusion = &PRIV(g)->diffusion;
+
+	if (mode == WS75bEPD_DITHER_DIFFUSION && !diffusion->current) {
+		/* wide enough for every orientation */
+		diffusion->width = GDISP_SCREEN_WIDTH > GDISP_SCREEN_HEIGHT ? GDISP_SCREEN_WIDTH : GDISP_SCREEN_HEIGHT;
+		diffusion->current = gfxAlloc(diffusion->width * 3 * sizeof(gI16));
+		diffusion->next = gfxAlloc(diffusion->width * 3 * sizeof(gI16));
+		if (!diffusion->current || !diffusion->next) {
+			gfxFree(diffusion->next);
+			gfxFree(diffusion->current);
+			diffusion->current = diffusion->next = 0;
+			return gFalse;
+		}
+	}
+	if (mode == WS75bEPD_DITHER_DIFFUSION)
+		ws75bepdDiffusionReset(diffusion, -1);
+	PRIV(g)->ditherMode = mode;
+	return gTrue;
+}
 
-	/* Send the initialization commands. (according to WaveShare) */
-	startUpDisplay(g);
+/* A frame that was never drawn to is all white, so native frames and blank screens need no frame buffer. */
+static gU8 *frameBuffer(GDisplay* g) {
+	if (!PRIV(g)->frame && !PRIV(g)->frameFailed) {
+		PRIV(g)->frame = gfxAllocBeside(WS75bEPD_FRAME_BYTES);
+		if (PRIV(g)->frame)
+			memset(PRIV(g)->frame, 0xff, WS75bEPD_FRAME_BYTES);		/* PIXEL_COLOR_WHITE in every pixel */
+		else
+			PRIV(g)->frameFailed = gTrue;
+	}
+	return PRIV(g)->frame;
+}
 
-	release_bus(g);
+LLDSPEC gBool gdisp_lld_init(GDisplay *g) {
+	/* The private area holds the dithering state, the frame buffer follows on demand. */
+	g->priv = gfxAlloc(sizeof(WS75bEPDPrivate));
+	if (!g->priv)
+		return gFalse;
+	memset(g->priv, 0, sizeof(WS75bEPDPrivate));
+	PRIV(g)->ditherMode = WS75bEPD_DITHER_ORDERED;
+	PRIV(g)->refresh = WS75bEPD_REFRESH_FULL;
+	PRIV(g)->lut = &ws75bepdFastLut;
+
+	/* Initialize the LL hardware. */
+	init_board(g);
 
 	/* Finish board initialization. */
 	post_init_board(g);
 
-	/* Initialise the GDISP structure */
+	/* Initialise the GDISP structure. The panel is reset and started by the first flush, see panelReady(). */
 	g->g.Width = GDISP_SCREEN_WIDTH;
 	g->g.Height = GDISP_SCREEN_HEIGHT;
 	g->g.Orientation = gOrientation0;
-	g->g.Powermode = gPowerOn;
+	g->g.Powermode = gPowerDeepSleep;
 	return gTrue;
 }
 
-#if GDISP_HARDWARE_DRAWPIXEL
-LLDSPEC void gdisp_lld_draw_pixel(GDisplay *g) {
+/* Orientation dependent coordinates, for gdisp_lld_draw_pixel() and the pixels of the scaler. */
+static void drawPixel(GDisplay *g, gCoord px, gCoord py, gColor color) {
 	gCoord		x, y;
 
-	switch(g->g.Orientation) {
-	default:
-	case gOrientation0:
-		x = g->p.x;
-		y = g->p.y;
-		break;
-	case gOrientation90:
-		x = g->p.y;
-		y = GDISP_SCREEN_HEIGHT - 1 - g->p.x;
-		break;
-	case gOrientation180:
-		x = GDISP_SCREEN_WIDTH - 1 - g->p.x;
-		y = GDISP_SCREEN_HEIGHT - 1 - g->p.y;
-		break;
-	case gOrientation270:
-		x = GDISP_SCREEN_HEIGHT - 1 - g->p.y;
-		y = g->p.x;
-		break;
-	}
+	ws75bepdMapOrientation(g->g.Orientation, px, py, &x, &y);
 
-	// 1. Delete old color (delete high or low bits depending on position)
-	gU8 bitmask;
-	gU8 shift;
-	switch (x % 4) {
-		case 0:
-			bitmask = 252;  // 1111 1100
-			shift = 0;
-			break;
-		case 1:
-			bitmask = 243;  // 1111 0011
-			shift = 2;
-			break;
-		case 2:
-			bitmask = 207;  // 1100 1111
-			shift = 4;
-			break;
-		default:
-			bitmask = 63;   // 0011 1111
-			shift = 6;
-			break;
-	}
-	((gU8 *)g->priv)[(GDISP_SCREEN_HEIGHT*(x/WS75bEPD_PPB)) + y] &= bitmask;
-	
-	// 2. set new color
 	gU8 colorValue;
-	switch (g->p.color) {
+	switch (color) {
 		case GFX_WHITE:
 			colorValue = PIXEL_COLOR_WHITE;
 			break;
@@ -201,77 +329,387 @@ LLDSPEC void gdisp_lld_draw_pixel(GDisplay *g) {
 			colorValue = PIXEL_COLOR_RED;
 			break;
 		default:
-			colorValue = orderedDithering(g, x, y);
-	}	
-	((gU8 *)g->priv)[(GDISP_SCREEN_HEIGHT*(x/WS75bEPD_PPB)) + y] |= colorValue << shift;
+			if (PRIV(g)->ditherMode == WS75bEPD_DITHER_DIFFUSION)
+				colorValue = diffusedDithering(g, color, px, py);
+			else
+				colorValue = orderedDithering(color, x, y);
+	}
+	if (!PRIV(g)->frame && colorValue == PIXEL_COLOR_WHITE)
+		return;
+	if (frameBuffer(g))
+		ws75bepdSetPixel(PRIV(g)->frame, x, y, colorValue);
+	else
+		PRIV(g)->pixelsLost = gTrue;
 }
+
+#ifndef WS75bEPD_HOST
+#ifndef WS75bEPD_PIPELINE_STACK
+	#define WS75bEPD_PIPELINE_STACK		2048
 #endif
 
-#if GDISP_HARDWARE_FLUSH
-static inline gU8 convertPixel(gU8 data) {
-	// pixel data is in the two-most right bits
-	data = data & 3;
-	if (data == 1) {
-		// the pixel is supposed to be red, we need to adjust
-		data <<= 2;
+typedef struct WS75bEPDPipeline {
+	WS75bEPDRing ring;
+	WS75bEPDRun *run;			/* being filled by the producer, not published yet */
+	GDisplay *g;
+	TaskHandle_t producer;
+	TaskHandle_t consumer;
+	gBool stop;					/* set by the producer after the last run */
+	gBool stopped;				/* set by the consumer after it packed the last run */
+	gU32 start;
+	WS75bEPDPipelineStats stats;	/* the consumer only writes consumerWaits and consumerUs */
+} WS75bEPDPipeline;
+
+/* The consumer, dithers and packs the runs on the other core until it is stopped. */
+static void pipelineTask(void *param) {
+	WS75bEPDPipeline *p = param;
+
+	for (;;) {
+		WS75bEPDRun *run = ws75bepdRingRead(&p->ring);
+		if (!run) {
+			/* the last run may have been published after the ring was looked at, but not after stop was set */
+			if (__atomic_load_n(&p->stop, __ATOMIC_ACQUIRE)) {
+				if (!(run = ws75bepdRingRead(&p->ring)))
+					break;
+			} else {
+				p->stats.consumerWaits++;
+				ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+				continue;
+			}
+		}
+		gU32 start = micros();
+		for (gCoord i = 0; i < run->count; i++)
+			drawPixel(p->g, run->x + i, run->y, run->colors[i]);
+		p->stats.consumerUs += micros() - start;
+		ws75bepdRingRelease(&p->ring);
+		xTaskNotifyGive(p->producer);
 	}
-	return data;
+	__atomic_store_n(&p->stopped, gTrue, __ATOMIC_RELEASE);
+	xTaskNotifyGive(p->producer);
+	/* deleted by endPipeline() */
+	for (;;)
+		ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
 }
 
-LLDSPEC void gdisp_lld_flush(GDisplay *g) {
-	// the display needs to awake from deep sleep, so we first check the current powerMode and if the display is not
-	// sleeping, we need to put it to sleep and then awake it
-	gdispGSetPowerMode(g, gPowerDeepSleep);
-	gdispGSetPowerMode(g, gPowerOn);
+static void publishRun(WS75bEPDPipeline *p) {
+	ws75bepdRingPublish(&p->ring);
+	p->run = 0;
+	p->stats.runs++;
+	xTaskNotifyGive(p->consumer);
+}
 
-	acquire_bus(g);
-		
-	for(int i=0; i<GDISP_SCREEN_HEIGHT; i++)
-		for(int j=0; j<=((g->g.Width-1)/WS75bEPD_PPB); j++) {
-			gU8 pixelValues = ((gU8 *)g->priv)[(GDISP_SCREEN_HEIGHT*j) + i];
-			// as we are storing a pixel in 2 bits instead of 4 we need to extract that data now
-			for (int k=0; k<2; ++k) {
-				// put the pixels we are currently dealing with to the lower part
-				pixelValues >>= k * 4;
-				// first pixel is implemented in the third and fourth bit from the right (ENDIANESS!!)
-				gU8 firstPixel = convertPixel(pixelValues >> 2);
-				// the second pixel is in the most right bits
-				gU8 secondPixel = convertPixel(pixelValues);
-				gU8 data = (secondPixel << 4) | firstPixel;
-				write_data(g, data);
-			}
+/* The producer, runs on the core of the decoder. */
+static void pipelinePixel(GDisplay *g, gCoord x, gCoord y, gColor color) {
+	WS75bEPDPipeline *p = PRIV(g)->pipeline;
+	WS75bEPDRun *run = p->run;
+
+	if (run && (y != run->y || x != run->x + run->count || run->count == WS75bEPD_PIPELINE_RUN_PIXELS)) {
+		publishRun(p);
+		run = 0;
+	}
+	if (!run) {
+		if (!(run = ws75bepdRingWrite(&p->ring))) {
+			gU32 start = micros();
+			p->stats.producerWaits++;
+			do {
+				ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+			} while (!(run = ws75bepdRingWrite(&p->ring)));
+			p->stats.producerWaitUs += micros() - start;
 		}
-		
-	/* Update the screen. */
+		run->x = x;
+		run->y = y;
+		run->count = 0;
+		p->run = run;
+	}
+	run->colors[run->count++] = color;
+	p->stats.pixels++;
+}
+
+/* Waits until the consumer packed every pixel and stops it. */
+static void endPipeline(GDisplay *g) {
+	WS75bEPDPipeline *p = PRIV(g)->pipeline;
+
+	if (!p)
+		return;
+	PRIV(g)->pipeline = 0;
+	if (p->run)
+		publishRun(p);
+	/* the consumer is only deleted below, it can be notified even if it saw stop already */
+	gU32 drain = micros();
+	__atomic_store_n(&p->stop, gTrue, __ATOMIC_RELEASE);
+	xTaskNotifyGive(p->consumer);
+	while (!__atomic_load_n(&p->stopped, __ATOMIC_ACQUIRE))
+		ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+	vTaskDelete(p->consumer);
+
+	gU32 end = micros();
+	p->stats.producerWaitUs += end - drain;
+	p->stats.elapsedUs = end - p->start;
+	ws75bepdLastPipeline = p->stats;
+	gfxFree(p);
+}
+
+static void beginPipeline(GDisplay *g) {
+	endPipeline(g);
+	memset(&ws75bepdLastPipeline, 0, sizeof(ws75bepdLastPipeline));
+
+	/* The consumer must not allocate, the arena is not thread safe. The diffusion rows are there already. */
+	if (!frameBuffer(g))
+		return;
+	WS75bEPDPipeline *p = gfxAlloc(sizeof(WS75bEPDPipeline));
+	if (!p)
+		return;
+	memset(p, 0, sizeof(WS75bEPDPipeline));
+	p->g = g;
+	p->producer = xTaskGetCurrentTaskHandle();
+	p->start = micros();
+	if (xTaskCreatePinnedToCore(pipelineTask, "ws75bepd", WS75bEPD_PIPELINE_STACK, p, uxTaskPriorityGet(0), &p->consumer,
+			xPortGetCoreID() ? 0 : 1) != pdPASS) {
+		gfxFree(p);
+		return;
+	}
+	PRIV(g)->pipeline = p;
+}
+#else
+/* The host tools draw inline. */
+#define pipelinePixel		drawPixel
+
+static void endPipeline(GDisplay *g) {
+	(void)g;
+}
+
+static void beginPipeline(GDisplay *g) {
+	(void)g;
+	memset(&ws75bepdLastPipeline, 0, sizeof(ws75bepdLastPipeline));
+}
+#endif
+
+#if GDISP_HARDWARE_DRAWPIXEL
+LLDSPEC void gdisp_lld_draw_pixel(GDisplay *g) {
+	/* the scaler stays on the core of the decoder, the pixels it emits go through the pipeline */
+	WS75bEPDScaleEmit emit = PRIV(g)->pipeline ? pipelinePixel : drawPixel;
+
+	if (PRIV(g)->scaler)
+		ws75bepdScalePixel(g, PRIV(g)->scaler, g->p.x, g->p.y, g->p.color, emit);
+	else
+		emit(g, g->p.x, g->p.y, g->p.color);
+}
+#endif
+
+static void endScale(GDisplay *g) {
+	WS75bEPDScaler *scaler = PRIV(g)->scaler;
+
+	if (!scaler)
+		return;
+	PRIV(g)->scaler = 0;
+	ws75bepdScaleEnd(g, scaler, drawPixel);
+	ws75bepdLastScale = scaler->stats;
+	gfxFree(scaler);
+
+	g->g.Width = PRIV(g)->width;
+	g->g.Height = PRIV(g)->height;
+	g->clipx0 = g->clipy0 = 0;
+	g->clipx1 = g->g.Width;
+	g->clipy1 = g->g.Height;
+}
+
+/*
+ * The display takes the size of the source image so GDISP does not clip it, the scaler maps the pixels
+ * back to the display.
+ */
+static void beginScale(GDisplay *g, const WS75bEPDScale *scale) {
+	endScale(g);
+
+	WS75bEPDScaler *scaler = gfxAlloc(sizeof(WS75bEPDScaler));
+	if (!scaler)
+		return;
+	if (!ws75bepdScaleBegin(scaler, scale, g->g.Width, g->g.Height)) {
+		gfxFree(scaler);
+		return;
+	}
+	PRIV(g)->scaler = scaler;
+	PRIV(g)->width = g->g.Width;
+	PRIV(g)->height = g->g.Height;
+	g->g.Width = scale->width;
+	g->g.Height = scale->height;
+	g->clipx0 = g->clipy0 = 0;
+	g->clipx1 = g->g.Width;
+	g->clipy1 = g->g.Height;
+}
+
+/* Collects the bytes of one panel row, so the row goes to the panel as one block. */
+typedef struct WS75bEPDRowWriter {
+	gU32 length;
+	gU8 data[WS75bEPD_STREAM_BYTES / GDISP_SCREEN_HEIGHT];
+} WS75bEPDRowWriter;
+
+/* red only matters for WS75bEPD_REFRESH_AUTO, the callers only scan the frame then. */
+static void beginFrame(GDisplay *g, WS75bEPDRowWriter *row, gBool red) {
+	WS75bEPDRefresh refresh = PRIV(g)->refresh;
+	if (refresh == WS75bEPD_REFRESH_AUTO)
+		refresh = red ? WS75bEPD_REFRESH_FULL : WS75bEPD_REFRESH_FAST;
+
+	panelReady(g);
+	selectWaveform(g, refresh == WS75bEPD_REFRESH_FAST);
+	ws75bepdLastRefresh = refresh;
+	acquire_bus(g);
+	write_cmd(g, DATA_START_TRANSMISSION_1);
+	delay_ms(g, 2);
+	row->length = 0;
+}
+
+static inline void sendByte(GDisplay *g, WS75bEPDRowWriter *row, gU8 pixelValues) {
+	ws75bepdExpandByte(pixelValues, row->data + row->length);
+	row->length += 2;
+	if (row->length == sizeof(row->data)) {
+		write_data_block(g, row->data, row->length);
+		row->length = 0;
+	}
+}
+
+static void endFrame(GDisplay *g, WS75bEPDRowWriter *row) {
+	if (row->length)
+		write_data_block(g, row->data, row->length);
+
+	/* Update the screen. The bus is free for the other panels while this one refreshes. */
 	write_cmd(g, DISPLAY_REFRESH);
-	wait_until_idle(g);
+	PRIV(g)->refreshStart = board_millis(g);
+	PRIV(g)->refreshing = gTrue;
 	release_bus(g);
 
-	// put display back to sleep
-	gdispGSetPowerMode(g, gPowerDeepSleep);
+	// put display back to sleep, right away or once another call needs the panel
+	if (!PRIV(g)->overlap)
+		finishRefresh(g);
+}
+
+#if GDISP_HARDWARE_FLUSH
+LLDSPEC void gdisp_lld_flush(GDisplay *g) {
+	endPipeline(g);
+
+	const gU8 *frame = PRIV(g)->frame;
+	WS75bEPDRowWriter row;
+
+	/* without the frame buffer the panel would get an all white frame instead of the image drawn */
+	ws75bepdFlushRefused = !frame && PRIV(g)->pixelsLost;
+	PRIV(g)->pixelsLost = gFalse;
+	if (ws75bepdFlushRefused)
+		return;
+
+	beginFrame(g, &row, PRIV(g)->refresh == WS75bEPD_REFRESH_AUTO && frameHasRed(frame));
+	for (gU32 i = 0; i < WS75bEPD_FRAME_BYTES; i++)
+		sendByte(g, &row, frame ? ws75bepdStreamByte(frame, i) : 0xff);
+	endFrame(g, &row);
+}
+#endif
+
+void ws75bepdFlushFrame(GDisplay *g, const gU8 *payload, const WS75bEPDFrameHeader *header) {
+	WS75bEPDRowWriter row;
+
+	endPipeline(g);
+	ws75bepdFlushRefused = gFalse;
+	beginFrame(g, &row, PRIV(g)->refresh == WS75bEPD_REFRESH_AUTO && payloadHasRed(payload, header));
+	if (header->encoding == WS75bEPD_ENCODING_PACKBITS) {
+		WS75bEPDUnpacker unpacker;
+		gU8 pixelValues;
+		ws75bepdUnpackBegin(&unpacker, payload, header->payloadLength);
+		while (ws75bepdUnpackByte(&unpacker, &pixelValues))
+			sendByte(g, &row, pixelValues);
+	} else {
+		for (gU32 i = 0; i < header->payloadLength; i++)
+			sendByte(g, &row, payload[i]);
+	}
+	endFrame(g, &row);
+}
+
+void ws75bepdFinishRefresh(GDisplay *g) {
+	finishRefresh(g);
+}
+
+void ws75bepdSetPins(unsigned display, const WS75bEPDPins *pins) {
+	set_board_pins(display, pins);
+}
+
+gU8 *ws75bepdFrame(GDisplay *g) {
+	endPipeline(g);
+	return frameBuffer(g);
+}
+
+void ws75bepdReadRegion(GDisplay *g, gCoord x, gCoord y, gCoord cx, gCoord cy, gU8 *out) {
+	gU32 i = 0;
+	gCoord fx, fy;
+
+	endPipeline(g);
+	memset(out, 0, WS75bEPD_REGION_BYTES(cx, cy));
+	for (gCoord py = y; py < y + cy; py++) {
+		for (gCoord px = x; px < x + cx; px++, i++) {
+			ws75bepdMapOrientation(g->g.Orientation, px, py, &fx, &fy);
+			gU8 colorValue = PRIV(g)->frame ? ws75bepdGetPixel(PRIV(g)->frame, fx, fy) : PIXEL_COLOR_WHITE;
+			out[i / WS75bEPD_PPB] |= colorValue << ((i % WS75bEPD_PPB) * 2);
+		}
+	}
+}
+
+gBool ws75bepdWriteRegion(GDisplay *g, gCoord x, gCoord y, gCoord cx, gCoord cy, const gU8 *packed, gU32 length) {
+	WS75bEPDUnpacker unpacker;
+	gU8 *frame;
+	gU8 pixelValues = 0;
+	gU32 i = 0;
+	gCoord fx, fy;
+
+	endPipeline(g);
+	frame = frameBuffer(g);
+	if (!frame)
+		return gFalse;
+	ws75bepdUnpackBegin(&unpacker, packed, length);
+	for (gCoord py = y; py < y + cy; py++) {
+		for (gCoord px = x; px < x + cx; px++, i++) {
+			if (i % WS75bEPD_PPB == 0 && !ws75bepdUnpackByte(&unpacker, &pixelValues))
+				return gFalse;
+			ws75bepdMapOrientation(g->g.Orientation, px, py, &fx, &fy);
+			ws75bepdSetPixel(frame, fx, fy, (pixelValues >> ((i % WS75bEPD_PPB) * 2)) & 3);
+		}
+	}
+	return ws75bepdUnpackComplete(&unpacker);
+}
+
+#ifdef WS75bEPD_HOST
+gBool ws75bepdHostShareClock = gFalse;
+void (*ws75bepdHostClock)(gU32 us) = 0;
+
+gU32 ws75bepdHostCapture(GDisplay *g, const gU8 **data) {
+	*data = HOST_BOARD(g)->capture;
+	return HOST_BOARD(g)->captureLength;
+}
+
+void ws75bepdHostStats(GDisplay *g, WS75bEPDHostStats *stats) {
+	WS75bEPDHostBoard *board = HOST_BOARD(g);
+	stats->commands = board->commands;
+	stats->dataBytes = board->dataBytes;
+	stats->resets = board->resets;
+	stats->delayMs = board->delayMs;
+	stats->busyMs = board->busyMs;
+	stats->elapsedMs = *board->nowUs / 1000;
+}
+
+void ws75bepdHostTrace(GDisplay *g, FILE *trace) {
+	HOST_BOARD(g)->trace = trace;
 }
 #endif
 
 #if GDISP_NEED_CONTROL && GDISP_HARDWARE_CONTROL
 LLDSPEC void gdisp_lld_control(GDisplay *g) {
+	if (g->p.x != WS75bEPD_CONTROL_PIPELINE)
+		endPipeline(g);
+
 	switch(g->p.x) {
 	case GDISP_CONTROL_POWER:
-		if (g->g.Powermode == (gPowermode)g->p.ptr)
-			return;
 		switch((gPowermode)g->p.ptr) {
 			case gPowerOff:
 			case gPowerSleep:
 			case gPowerDeepSleep:
-				acquire_bus(g); // Put de display in deep sleep
-				write_cmd(g, POWER_OFF);
-				write_reg(g, DEEP_SLEEP_MODE, 0xA5);
-				release_bus(g);
+				panelDeepSleep(g);
 				break;
 			case gPowerOn:
-				resetDisplay(g);
-				acquire_bus(g); // Awake the display again
-				startUpDisplay(g);
-				release_bus(g);
+				panelReady(g);
 				break;
 			default:
 				return;
@@ -304,6 +742,39 @@ LLDSPEC void gdisp_lld_control(GDisplay *g) {
 		}
 		g->g.Orientation = (gOrientation)g->p.ptr;
 		return;
+
+	case WS75bEPD_CONTROL_DITHER:
+		setDitherMode(g, (WS75bEPDDither)(size_t)g->p.ptr);
+		return;
+
+	case WS75bEPD_CONTROL_REFRESH:
+		PRIV(g)->refresh = (WS75bEPDRefresh)(size_t)g->p.ptr;
+		return;
+
+	case WS75bEPD_CONTROL_SCALE:
+		if (g->p.ptr)
+			beginScale(g, (const WS75bEPDScale *)g->p.ptr);
+		else
+			endScale(g);
+		return;
+
+	case WS75bEPD_CONTROL_PIPELINE:
+		if (g->p.ptr)
+			beginPipeline(g);
+		else
+			endPipeline(g);
+		return;
+
+	case WS75bEPD_CONTROL_OVERLAP:
+		PRIV(g)->overlap = g->p.ptr != 0;
+		if (!PRIV(g)->overlap)
+			finishRefresh(g);
+		return;
+
+	case WS75bEPD_CONTROL_LUT:
+		/* uploaded by the next fast refresh */
+		PRIV(g)->lut = g->p.ptr ? (const WS75bEPDLut *)g->p.ptr : &ws75bepdFastLut;
+		return;
 	default:
 		return;
 	}
@@ -1 +1,3 @@
+#include "gfx.h"
+#include "gfx_arena.h"
 #include "ugfx/src/gfx_mk.c"
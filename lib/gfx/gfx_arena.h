@@ -0,0 +1,26 @@
+/*
+ * Routes the uGFX heap through the wake arena.
+ *
+ * Include after gfx.h. The FreeRTOS port maps gfxAlloc()/gfxFree() straight onto the FreeRTOS heap,
+ * so every allocation of uGFX itself (the image decoders and fonts in gfx.c) and of the driver ends
+ * up in the arena and is released with it before deep sleep.
+ */
+
+#ifndef _GFX_ARENA_H
+#define _GFX_ARENA_H
+
+#include "wake_arena.h"
+
+/* WAKE_ARENA_NO_GFX keeps the heap for the multi threaded host tools, the arena is not thread safe. */
+#if defined(gfxAlloc) && defined(gfxFree) && !defined(WAKE_ARENA_NO_GFX)
+	#undef gfxAlloc
+	#undef gfxFree
+	#define gfxAlloc(sz)		wakeArenaAlloc(sz)
+	#define gfxFree(ptr)		wakeArenaFree(ptr)
+	/* the driver's own buffers stay out of the PNG workspace, see ws75bepd_png.h */
+	#define gfxAllocBeside(sz)	wakeArenaAllocBeside(sz)
+#else
+	#define gfxAllocBeside(sz)	gfxAlloc(sz)
+#endif
+
+#endif /* _GFX_ARENA_H */
@@ -22,6 +22,13 @@
 #ifndef _GFXCONF_H
 #define _GFXCONF_H
 
+/* Build profiles. The lean profile (BUILD_PROFILE_LEAN) only shows native frames and PNGs and writes with a single font. */
+#ifdef BUILD_PROFILE_LEAN
+    #define GFX_FULL_PROFILE                         GFXOFF
+#else
+    #define GFX_FULL_PROFILE                         GFXON
+#endif
+
 ///////////////////////////////////////////////////////////////////////////
 // GFX - Compatibility options                                           //
 ///////////////////////////////////////////////////////////////////////////
@@ -32,10 +39,15 @@
 // GOS - One of these must be defined, preferably in your Makefile       //
 ///////////////////////////////////////////////////////////////////////////
 //#define GFX_USE_OS_CHIBIOS                           GFXOFF
+// WS75bEPD_HOST builds the driver with the mock board for the host tools
+#ifndef WS75bEPD_HOST
 #define GFX_USE_OS_FREERTOS                          GFXON
+#endif
 //    #define GFX_FREERTOS_USE_TRACE                   GFXOFF
 //#define GFX_USE_OS_WIN32                             GFXOFF
-//#define GFX_USE_OS_LINUX                             GFXOFF
+#ifdef WS75bEPD_HOST
+#define GFX_USE_OS_LINUX                             GFXON
+#endif
 //#define GFX_USE_OS_OSX                               GFXOFF
 //#define GFX_USE_OS_ECOS                              GFXOFF
 //#define GFX_USE_OS_RAWRTOS                           GFXOFF
@@ -59,7 +71,9 @@
 //    #define GFX_CPU_NO_ALIGNMENT_FAULTS              GFXOFF
 //    #define GFX_CPU_ENDIAN                           GFX_CPU_ENDIAN_UNKNOWN
 //    #define GFX_OS_HEAP_SIZE                         0
+#ifndef WS75bEPD_HOST
    #define GFX_OS_NO_INIT                           GFXON
+#endif
 //    #define GFX_OS_INIT_NO_WARNING                   GFXOFF
 //    #define GFX_OS_PRE_INIT_FUNCTION                 myHardwareInitRoutine
 //    #define GFX_OS_EXTRA_INIT_FUNCTION               myOSInitRoutine
@@ -84,7 +98,7 @@
 //#define GDISP_NEED_ELLIPSE                           GFXOFF
 //#define GDISP_NEED_ARC                               GFXOFF
 //#define GDISP_NEED_ARCSECTORS                        GFXOFF
-#define GDISP_NEED_CONVEX_POLYGON                    GFXON
+#define GDISP_NEED_CONVEX_POLYGON                    GFX_FULL_PROFILE
 //#define GDISP_NEED_SCROLL                            GFXOFF
 //#define GDISP_NEED_PIXELREAD                         GFXOFF
 #define GDISP_NEED_CONTROL                           GFXON
@@ -92,21 +106,21 @@
 //#define GDISP_NEED_MULTITHREAD                       GFXOFF
 //#define GDISP_NEED_STREAMING                         GFXOFF
 #define GDISP_NEED_TEXT                              GFXON
-   #define GDISP_NEED_TEXT_WORDWRAP                  GFXON
+   #define GDISP_NEED_TEXT_WORDWRAP                  GFX_FULL_PROFILE
 //    #define GDISP_NEED_TEXT_BOXPADLR                 1
 //    #define GDISP_NEED_TEXT_BOXPADTB                 1
    #define GDISP_NEED_ANTIALIAS                     GFXOFF
-   #define GDISP_NEED_UTF8                          GFXON
+   #define GDISP_NEED_UTF8                          GFX_FULL_PROFILE
 //    #define GDISP_NEED_TEXT_KERNING                  GFXOFF
 //    #define GDISP_INCLUDE_FONT_UI1                   GFXOFF
 //    #define GDISP_INCLUDE_FONT_UI2                   GFXOFF		// The smallest preferred font.
 //    #define GDISP_INCLUDE_FONT_LARGENUMBERS          GFXOFF
 //    #define GDISP_INCLUDE_FONT_DEJAVUSANS10          GFXOFF
-   #define GDISP_INCLUDE_FONT_DEJAVUSANS12           GFXON
-   #define GDISP_INCLUDE_FONT_DEJAVUSANS16           GFXON
+   #define GDISP_INCLUDE_FONT_DEJAVUSANS12           GFX_FULL_PROFILE
+   #define GDISP_INCLUDE_FONT_DEJAVUSANS16           GFX_FULL_PROFILE
    #define GDISP_INCLUDE_FONT_DEJAVUSANS20           GFXON
 //    #define GDISP_INCLUDE_FONT_DEJAVUSANS24          GFXOFF
-   #define GDISP_INCLUDE_FONT_DEJAVUSANS32           GFXON
+   #define GDISP_INCLUDE_FONT_DEJAVUSANS32           GFX_FULL_PROFILE
 //    #define GDISP_INCLUDE_FONT_DEJAVUSANSBOLD12      GFXOFF
 //    #define GDISP_INCLUDE_FONT_FIXED_10X20           GFXOFF
 //    #define GDISP_INCLUDE_FONT_FIXED_7X14            GFXOFF
@@ -123,17 +137,17 @@
 //    #define GDISP_NEED_IMAGE_NATIVE                  GFXOFF
 //    #define GDISP_NEED_IMAGE_GIF                     GFXOFF
 //        #define GDISP_IMAGE_GIF_BLIT_BUFFER_SIZE     32
-//    #define GDISP_NEED_IMAGE_BMP                     GFXOFF
-//        #define GDISP_NEED_IMAGE_BMP_1               GFXON
-//        #define GDISP_NEED_IMAGE_BMP_4               GFXON
-//        #define GDISP_NEED_IMAGE_BMP_4_RLE           GFXON
-//        #define GDISP_NEED_IMAGE_BMP_8               GFXON
-//        #define GDISP_NEED_IMAGE_BMP_8_RLE           GFXON
-//        #define GDISP_NEED_IMAGE_BMP_16              GFXON
-//        #define GDISP_NEED_IMAGE_BMP_24              GFXON
-//        #define GDISP_NEED_IMAGE_BMP_32              GFXON
+   #define GDISP_NEED_IMAGE_BMP                     GFX_FULL_PROFILE
+       #define GDISP_NEED_IMAGE_BMP_1               GFXON
+       #define GDISP_NEED_IMAGE_BMP_4               GFXON
+       #define GDISP_NEED_IMAGE_BMP_4_RLE           GFXOFF
+       #define GDISP_NEED_IMAGE_BMP_8               GFXON
+       #define GDISP_NEED_IMAGE_BMP_8_RLE           GFXOFF
+       #define GDISP_NEED_IMAGE_BMP_16              GFXON
+       #define GDISP_NEED_IMAGE_BMP_24              GFXON
+       #define GDISP_NEED_IMAGE_BMP_32              GFXON
 //        #define GDISP_IMAGE_BMP_BLIT_BUFFER_SIZE     32
-//    #define GDISP_NEED_IMAGE_JPG                     GFXOFF
+   #define GDISP_NEED_IMAGE_JPG                     GFX_FULL_PROFILE
    #define GDISP_NEED_IMAGE_PNG                     GFXON
 //        #define GDISP_NEED_IMAGE_PNG_INTERLACED      GFXOFF
 //        #define GDISP_NEED_IMAGE_PNG_TRANSPARENCY    GFXON
@@ -164,7 +178,12 @@
 #define GDISP_NEED_STARTUP_LOGO                      GFXOFF
 #define GDISP_STARTUP_LOGO_TIMEOUT                   0 
 
-//#define GDISP_TOTAL_DISPLAYS                         1
+// the host tools use one display per worker thread, the firmware one per panel on the board
+#ifdef WS75bEPD_HOST_DISPLAYS
+#define GDISP_TOTAL_DISPLAYS                         WS75bEPD_HOST_DISPLAYS
+#elif defined(WS75bEPD_PANELS)
+#define GDISP_TOTAL_DISPLAYS                         WS75bEPD_PANELS
+#endif
 
 //#define GDISP_DRIVER_LIST                            GDISPVMT_Win32, GDISPVMT_Win32
 //    #ifdef GDISP_DRIVER_LIST
@@ -333,6 +352,9 @@
 //#define GFILE_ALLOW_FLOATS                           GFXOFF
 //#define GFILE_ALLOW_DEVICESPECIFIC                   GFXOFF
 //#define GFILE_MAX_GFILES                             3
+#ifdef WS75bEPD_HOST_DISPLAYS
+#define GFILE_MAX_GFILES                             (WS75bEPD_HOST_DISPLAYS + 2)
+#endif
 
 ///////////////////////////////////////////////////////////////////////////
 // GADC                                                                  //
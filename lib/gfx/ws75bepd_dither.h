@@ -0,0 +1,118 @@
+/*
+ * This file is subject to the terms of the GFX License. If a copy of
+ * the license was not distributed with this file, you can obtain one at:
+ *
+ *              http://ugfx.io/license.html
+ */
+
+/*
+ * Black/white/red quantisation of the WS75bEPD driver.
+ *
+ * ws75bepdPaletteLut is generated by scripts/generate_palette_lut.py and maps every 15 bit RGB color
+ * to the pair of palette colors that mixes to it best and the share of the second color, so both
+ * dithering modes cost one table lookup per pixel.
+ *
+ * The pairs are chosen by distance in linear light, as the panel mixes its pixels. Error diffusion
+ * works in linear light as well, in 12 bits per channel, so both modes agree on mid-greys: the error
+ * is added to the linear input, converted back to sRGB for the table lookup and the residual is taken
+ * against the palette color in linear light.
+ */
+
+#ifndef _WS75bEPD_DITHER_H_
+#define _WS75bEPD_DITHER_H_
+
+#include <string.h>
+
+#include "gfx.h"
+#include "gdisp_lld_config.h"
+
+/* PIXEL_COLOR_* of gdisp_lld_config.h to the color of the panel in linear light. */
+extern const unsigned short ws75bepdPaletteLinear[4][3];
+extern const unsigned short ws75bepdSrgbToLinear[256];
+/* Indexed by the top WS75bEPD_LINEAR_TO_SRGB_BITS of a linear channel. */
+extern const unsigned char ws75bepdLinearToSrgb[1 << 10];
+extern const unsigned char ws75bepdPaletteLut[1 << 15];
+
+#define WS75bEPD_LINEAR_MAX				4095
+#define WS75bEPD_LINEAR_TO_SRGB_BITS	10
+
+#define WS75bEPD_LUT_INDEX(r, g, b)		((((r) >> 3) << 10) | (((g) >> 3) << 5) | ((b) >> 3))
+#define WS75bEPD_LUT_PRIMARY(e)			((e) >> 6)
+#define WS75bEPD_LUT_SECONDARY(e)		(((e) >> 4) & 3)
+/* Share of the secondary color in 1/30. */
+#define WS75bEPD_LUT_MIX(e)				((e) & 15)
+
+/* dithering theshold matrix */
+static const gU8 thresholdMatrix[] = {0, 7, 3, 6, 5, 2, 4, 1, 8};
+
+static GFXINLINE gU8 ws75bepdQuantiseOrdered(gU8 r, gU8 g, gU8 b, gCoord x, gCoord y) {
+	gU8 entry = ws75bepdPaletteLut[WS75bEPD_LUT_INDEX(r, g, b)];
+	gU8 threshold = thresholdMatrix[y % 3 * 3 + x % 3];
+
+	/* mix/30 > (threshold + 0.5)/9 */
+	if (3 * WS75bEPD_LUT_MIX(entry) > 10 * threshold + 5)
+		return WS75bEPD_LUT_SECONDARY(entry);
+	return WS75bEPD_LUT_PRIMARY(entry);
+}
+
+/* Floyd-Steinberg error diffusion, works on pixels arriving row by row from left to right. */
+typedef struct WS75bEPDDiffusion {
+	gI16 *current;		/* 3 channels per pixel of the current row, in linear light */
+	gI16 *next;
+	gCoord width;
+	gCoord row;
+} WS75bEPDDiffusion;
+
+static GFXINLINE int clampLinear(int value) {
+	return value < 0 ? 0 : (value > WS75bEPD_LINEAR_MAX ? WS75bEPD_LINEAR_MAX : value);
+}
+
+static GFXINLINE gU8 linearToSrgb(int value) {
+	return ws75bepdLinearToSrgb[value >> (12 - WS75bEPD_LINEAR_TO_SRGB_BITS)];
+}
+
+static GFXINLINE void ws75bepdDiffusionReset(WS75bEPDDiffusion *d, gCoord row) {
+	memset(d->current, 0, d->width * 3 * sizeof(gI16));
+	memset(d->next, 0, d->width * 3 * sizeof(gI16));
+	d->row = row;
+}
+
+static GFXINLINE gU8 ws75bepdQuantiseDiffused(WS75bEPDDiffusion *d, gU8 r, gU8 g, gU8 b, gCoord x, gCoord y) {
+	if (y != d->row) {
+		if (y == d->row + 1) {
+			gI16 *swap = d->current;
+			d->current = d->next;
+			d->next = swap;
+			memset(d->next, 0, d->width * 3 * sizeof(gI16));
+			d->row = y;
+		} else {
+			/* not drawn in order, start over */
+			ws75bepdDiffusionReset(d, y);
+		}
+	}
+	if (x < 0 || x >= d->width)
+		return ws75bepdQuantiseOrdered(r, g, b, x, y);
+
+	gI16 *error = d->current + x * 3;
+	int wanted[3] = {
+		clampLinear(ws75bepdSrgbToLinear[r] + error[0]),
+		clampLinear(ws75bepdSrgbToLinear[g] + error[1]),
+		clampLinear(ws75bepdSrgbToLinear[b] + error[2])
+	};
+	gU8 color = WS75bEPD_LUT_PRIMARY(ws75bepdPaletteLut[WS75bEPD_LUT_INDEX(linearToSrgb(wanted[0]),
+		linearToSrgb(wanted[1]), linearToSrgb(wanted[2]))]);
+
+	for (int c = 0; c < 3; ++c) {
+		int residual = wanted[c] - ws75bepdPaletteLinear[color][c];
+		if (x + 1 < d->width) {
+			d->current[(x + 1) * 3 + c] += residual * 7 / 16;
+			d->next[(x + 1) * 3 + c] += residual / 16;
+		}
+		if (x > 0)
+			d->next[(x - 1) * 3 + c] += residual * 3 / 16;
+		d->next[x * 3 + c] += residual * 5 / 16;
+	}
+	return color;
+}
+
+#endif /* _WS75bEPD_DITHER_H_ */
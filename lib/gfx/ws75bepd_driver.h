@@ -0,0 +1,186 @@
+/*
+ * This file is subject to the terms of the GFX License. If a copy of
+ * the license was not distributed with this file, you can obtain one at:
+ *
+ *              http://ugfx.io/license.html
+ */
+
+/* Interface of the WS75bEPD driver beyond the GDISP API. */
+
+#ifndef _WS75bEPD_DRIVER_H_
+#define _WS75bEPD_DRIVER_H_
+
+#include "gfx.h"
+#include "ws75bepd_frame.h"
+
+/* Selects how colors other than black, white and red are mapped to the panel, ptr is a WS75bEPDDither. */
+#define WS75bEPD_CONTROL_DITHER			(GDISP_CONTROL_LLD + 0)
+
+typedef enum WS75bEPDDither {
+	WS75bEPD_DITHER_ORDERED,		/* 3x3 threshold matrix, works in any drawing order */
+	WS75bEPD_DITHER_DIFFUSION		/* Floyd-Steinberg, needs rows drawn top to bottom, left to right, so not for JPEG */
+} WS75bEPDDither;
+
+/* Selects the waveform of the following flushes, ptr is a WS75bEPDRefresh. */
+#define WS75bEPD_CONTROL_REFRESH		(GDISP_CONTROL_LLD + 1)
+
+typedef enum WS75bEPDRefresh {
+	WS75bEPD_REFRESH_FULL,			/* three color waveform from the OTP of the panel */
+	WS75bEPD_REFRESH_FAST,			/* black and white waveform of the LUT registers, red turns white */
+	WS75bEPD_REFRESH_AUTO			/* FAST for frames without red, FULL otherwise */
+} WS75bEPDRefresh;
+
+/* Replaces the waveform of WS75bEPD_REFRESH_FAST, ptr is a const WS75bEPDLut * that has to stay valid and unchanged, 0 restores ws75bepdFastLut. */
+#define WS75bEPD_CONTROL_LUT			(GDISP_CONTROL_LLD + 2)
+
+/* LUT_VCOM to LUT_XON of WS75bEPD.h, tables with length 0 are not written. */
+#define WS75bEPD_LUT_COUNT				10
+
+typedef struct WS75bEPDLut {
+	const gU8 *data[WS75bEPD_LUT_COUNT];
+	gU8 length[WS75bEPD_LUT_COUNT];
+} WS75bEPDLut;
+
+/*
+ * Scales and crops the image drawn next to the display, ptr is a WS75bEPDScale that is copied. Until the
+ * control is sent again with ptr 0 the display has the size of the source image and every drawn pixel is
+ * a source pixel, see ws75bepd_scale.h. Ignored if the size is out of range or there is no memory.
+ */
+#define WS75bEPD_CONTROL_SCALE			(GDISP_CONTROL_LLD + 3)
+/* Larger images could overflow the 32 bit sums of a display pixel. */
+#define WS75bEPD_SCALER_MAX_SIZE		4096
+
+typedef enum WS75bEPDScaleMode {
+	WS75bEPD_SCALE_FIT,				/* the whole image, white bars on two sides */
+	WS75bEPD_SCALE_FILL,			/* the whole display, the image is cropped on two sides */
+	WS75bEPD_SCALE_CENTER			/* not scaled, centered and cropped */
+} WS75bEPDScaleMode;
+
+typedef struct WS75bEPDScale {
+	gCoord width;					/* of the source image */
+	gCoord height;
+	WS75bEPDScaleMode mode;
+} WS75bEPDScale;
+
+typedef struct WS75bEPDScaleStats {
+	gU32 peakRows;					/* ring rows in use at once */
+	gU32 evictions;					/* rows emitted before they were complete */
+	gU32 bufferBytes;
+} WS75bEPDScaleStats;
+
+/* The last scaled image, valid after WS75bEPD_CONTROL_SCALE with ptr 0. */
+extern WS75bEPDScaleStats ws75bepdLastScale;
+
+/*
+ * Dithers and packs the pixels drawn next on the other core, see ws75bepd_pipeline.h. Any ptr other
+ * than 0 starts the pipeline, ptr 0 waits until every pixel is in the frame buffer and stops it. Every
+ * other call into the driver stops it as well. Pixels are drawn inline if there is no second core (the
+ * host tools) or no memory.
+ */
+#define WS75bEPD_CONTROL_PIPELINE		(GDISP_CONTROL_LLD + 4)
+
+typedef struct WS75bEPDPipelineStats {
+	gU32 pixels;					/* 0 if the pixels were drawn inline */
+	gU32 runs;
+	gU32 producerWaits;				/* the ring was full, the dithering is the slower stage */
+	gU32 consumerWaits;				/* the ring was empty, the decoder is the slower stage */
+	gU32 elapsedUs;					/* from the start until the last pixel was packed */
+	gU32 producerWaitUs;			/* the decoder waited for the ring or for the last runs */
+	gU32 consumerUs;				/* spent dithering and packing, what drawing inline would add */
+} WS75bEPDPipelineStats;
+
+/* The last pipeline, valid after WS75bEPD_CONTROL_PIPELINE with ptr 0. */
+extern WS75bEPDPipelineStats ws75bepdLastPipeline;
+
+/*
+ * Lets the following flushes return as soon as the panel refreshes instead of waiting for BUSY, ptr is a
+ * gBool. Meant for several panels on one board: the next panel gets its data while the last one refreshes.
+ * The refresh is finished, BUSY waited for and the panel put to deep sleep, by ws75bepdFinishRefresh() or
+ * by the next call that needs the panel.
+ */
+#define WS75bEPD_CONTROL_OVERLAP		(GDISP_CONTROL_LLD + 5)
+
+/* The default waveform of WS75bEPD_REFRESH_FAST. */
+extern const WS75bEPDLut ws75bepdFastLut;
+
+/* Pins of a panel. Panels on one board can share SCK, DIN and DC, each needs its own CS, BUSY and RST. */
+typedef struct WS75bEPDPins {
+	gU8 sck;
+	gU8 din;
+	gU8 cs;
+	gU8 busy;
+	gU8 rst;
+	gU8 dc;
+} WS75bEPDPins;
+
+/* The pins of the Waveshare ESP32 driver board, of every display without pins of its own. */
+extern const WS75bEPDPins ws75bepdDefaultPins;
+
+/* Sets the pins of a display before gfxInit() starts it. The mock board of the host builds ignores them. */
+void ws75bepdSetPins(unsigned display, const WS75bEPDPins *pins);
+
+/* Waits until the refresh a flush left running with WS75bEPD_CONTROL_OVERLAP is done, see ws75bepdRefreshBusyMs. */
+void ws75bepdFinishRefresh(GDisplay *g);
+
+/*
+ * The packed frame buffer of the display, see ws75bepd_pack.h for the layout. 0 if it can not be allocated,
+ * which is only tried once. Call it before drawing to find out whether the image can be kept at all.
+ */
+gU8 *ws75bepdFrame(GDisplay *g);
+
+/* Copies a region of the frame buffer to out, WS75bEPD_REGION_BYTES(cx, cy) bytes, see ws75bepd_pack.h. */
+void ws75bepdReadRegion(GDisplay *g, gCoord x, gCoord y, gCoord cx, gCoord cy, gU8 *out);
+
+/* Writes a region read by ws75bepdReadRegion() and compressed with ws75bepdPack() back to the frame buffer. */
+gBool ws75bepdWriteRegion(GDisplay *g, gCoord x, gCoord y, gCoord cx, gCoord cy, const gU8 *packed, gU32 length);
+
+#ifdef WS75bEPD_HOST
+#include <stdio.h>
+
+/* The bytes the last flush sent to the mock board of board_WS75bEPD_host.h. */
+gU32 ws75bepdHostCapture(GDisplay *g, const gU8 **data);
+
+/* What the mock board saw since the display was initialised. */
+typedef struct WS75bEPDHostStats {
+	gU32 commands;
+	gU32 dataBytes;
+	gU32 resets;
+	gU32 delayMs;
+	gU32 busyMs;
+	gU32 elapsedMs;			/* simulated time of the panel */
+} WS75bEPDHostStats;
+
+void ws75bepdHostStats(GDisplay *g, WS75bEPDHostStats *stats);
+
+/* Writes a line per command, delay and busy wait to trace, 0 stops tracing. */
+void ws75bepdHostTrace(GDisplay *g, FILE *trace);
+
+/*
+ * Set before gfxInit() to run all mock boards on one clock, like panels on one board whose transfers and
+ * BUSY waits take turns on one MCU. Off by default, every display has its own clock then.
+ */
+extern gBool ws75bepdHostShareClock;
+
+/* Called with every step of the simulated time of the mock boards, lets a simulator run them on its own clock. 0 by default. */
+extern void (*ws75bepdHostClock)(gU32 us);
+#endif
+
+/*
+ * Sends a native frame (ws75bepd_frame.h) to the panel, bypassing the frame buffer. PackBits payloads
+ * are unpacked while they are sent. The frame must have passed ws75bepdCheckFrame().
+ */
+void ws75bepdFlushFrame(GDisplay *g, const gU8 *payload, const WS75bEPDFrameHeader *header);
+
+/* Milliseconds the last finished refresh kept BUSY, from DISPLAY_REFRESH until the panel was idle. */
+extern gU32 ws75bepdRefreshBusyMs;
+
+/* Waveform of the last flush, WS75bEPD_REFRESH_FULL or WS75bEPD_REFRESH_FAST. */
+extern WS75bEPDRefresh ws75bepdLastRefresh;
+
+/*
+ * The last flush sent nothing and started no refresh: the frame buffer could not be allocated and
+ * pixels that were not white were drawn since the flush before. The panel keeps its image.
+ */
+extern gBool ws75bepdFlushRefused;
+
+#endif
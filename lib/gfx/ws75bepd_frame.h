@@ -0,0 +1,209 @@
+/*
+ * This file is subject to the terms of the GFX License. If a copy of
+ * the license was not distributed with this file, you can obtain one at:
+ *
+ *              http://ugfx.io/license.html
+ */
+
+/*
+ * Native frame file of the WS75bEPD driver, a frame that is already dithered and packed.
+ *
+ * Header, all numbers little endian:
+ *     0  "EPF1"
+ *     4  gU16 width of the panel
+ *     6  gU16 height of the panel
+ *     8  gU8  encoding of the payload, WS75bEPD_ENCODING_*
+ *     9  3 bytes reserved, 0
+ *    12  gU32 payload length
+ *    16  gU32 CRC-32 of the payload
+ *    20  gU32 CRC-32 of bytes 0 to 19
+ *
+ * The raw payload is the frame buffer in the order it is sent to the panel, see ws75bepdStreamByte().
+ * The PackBits payload is the raw payload compressed with PackBits, which suits frames that are
+ * mostly white with runs of black and red. It is unpacked byte by byte while it is sent to the panel.
+ */
+
+#ifndef _WS75bEPD_FRAME_H_
+#define _WS75bEPD_FRAME_H_
+
+#include <string.h>
+
+#include "gfx.h"
+#include "ws75bepd_pack.h"
+
+#define WS75bEPD_FRAME_MAGIC			"EPF1"
+#define WS75bEPD_FRAME_HEADER_SIZE		24
+
+#define WS75bEPD_ENCODING_RAW			0
+#define WS75bEPD_ENCODING_PACKBITS		1
+
+typedef struct WS75bEPDFrameHeader {
+	gU16 width;
+	gU16 height;
+	gU8 encoding;
+	gU32 payloadLength;
+	gU32 payloadCrc;
+} WS75bEPDFrameHeader;
+
+/* CRC-32 as used by zlib and PNG, start with crc = 0. */
+static GFXINLINE gU32 ws75bepdCrc32(gU32 crc, const gU8 *data, gU32 length) {
+	static const gU32 nibbleTable[16] = {
+		0x00000000, 0x1db71064, 0x3b6e20c8, 0x26d930ac, 0x76dc4190, 0x6b6b51f4, 0x4db26158, 0x5005713c,
+		0xedb88320, 0xf00f9344, 0xd6d6a3e8, 0xcb61b38c, 0x9b64c2b0, 0x86d3d2d4, 0xa00ae278, 0xbdbdf21c
+	};
+
+	crc = ~crc;
+	while (length--) {
+		crc ^= *data++;
+		crc = (crc >> 4) ^ nibbleTable[crc & 15];
+		crc = (crc >> 4) ^ nibbleTable[crc & 15];
+	}
+	return ~crc;
+}
+
+static GFXINLINE void ws75bepdPutU16(gU8 *out, gU16 value) {
+	out[0] = value & 0xff;
+	out[1] = value >> 8;
+}
+
+static GFXINLINE void ws75bepdPutU32(gU8 *out, gU32 value) {
+	ws75bepdPutU16(out, value & 0xffff);
+	ws75bepdPutU16(out + 2, value >> 16);
+}
+
+static GFXINLINE gU16 ws75bepdGetU16(const gU8 *in) {
+	return in[0] | (in[1] << 8);
+}
+
+static GFXINLINE gU32 ws75bepdGetU32(const gU8 *in) {
+	return ws75bepdGetU16(in) | ((gU32)ws75bepdGetU16(in + 2) << 16);
+}
+
+static GFXINLINE void ws75bepdWriteFrameHeader(const WS75bEPDFrameHeader *header, gU8 *out) {
+	memcpy(out, WS75bEPD_FRAME_MAGIC, 4);
+	ws75bepdPutU16(out + 4, header->width);
+	ws75bepdPutU16(out + 6, header->height);
+	out[8] = header->encoding;
+	out[9] = out[10] = out[11] = 0;
+	ws75bepdPutU32(out + 12, header->payloadLength);
+	ws75bepdPutU32(out + 16, header->payloadCrc);
+	ws75bepdPutU32(out + 20, ws75bepdCrc32(0, out, 20));
+}
+
+/* Returns gFalse if the data does not start with an intact frame header. */
+static GFXINLINE gBool ws75bepdReadFrameHeader(const gU8 *in, gU32 length, WS75bEPDFrameHeader *header) {
+	if (length < WS75bEPD_FRAME_HEADER_SIZE || memcmp(in, WS75bEPD_FRAME_MAGIC, 4) != 0)
+		return gFalse;
+	if (ws75bepdGetU32(in + 20) != ws75bepdCrc32(0, in, 20))
+		return gFalse;
+
+	header->width = ws75bepdGetU16(in + 4);
+	header->height = ws75bepdGetU16(in + 6);
+	header->encoding = in[8];
+	header->payloadLength = ws75bepdGetU32(in + 12);
+	header->payloadCrc = ws75bepdGetU32(in + 16);
+	return gTrue;
+}
+
+/* Compresses with PackBits, out needs room for length + (length + 127) / 128 bytes. Returns the compressed length. */
+static GFXINLINE gU32 ws75bepdPack(const gU8 *in, gU32 length, gU8 *out) {
+	gU32 i = 0, o = 0;
+
+	while (i < length) {
+		gU32 run = 1;
+		while (i + run < length && run < 128 && in[i + run] == in[i])
+			run++;
+		if (run > 1) {
+			out[o++] = 257 - run;
+			out[o++] = in[i];
+			i += run;
+			continue;
+		}
+
+		/* literals up to the next run of three */
+		gU32 start = i;
+		while (i < length && i - start < 128) {
+			if (i + 2 < length && in[i] == in[i + 1] && in[i] == in[i + 2])
+				break;
+			i++;
+		}
+		out[o++] = i - start - 1;
+		memcpy(out + o, in + start, i - start);
+		o += i - start;
+	}
+	return o;
+}
+
+/* Unpacks PackBits one byte at a time, so nothing but the compressed data has to be kept. */
+typedef struct WS75bEPDUnpacker {
+	const gU8 *in;
+	const gU8 *end;
+	gU8 count;			/* bytes left of the current run */
+	gBool repeat;
+} WS75bEPDUnpacker;
+
+static GFXINLINE void ws75bepdUnpackBegin(WS75bEPDUnpacker *u, const gU8 *in, gU32 length) {
+	u->in = in;
+	u->end = in + length;
+	u->count = 0;
+	u->repeat = gFalse;
+}
+
+/* Returns gFalse at the end of the data, which is only complete if ws75bepdUnpackComplete() says so. */
+static GFXINLINE gBool ws75bepdUnpackByte(WS75bEPDUnpacker *u, gU8 *out) {
+	while (!u->count) {
+		if (u->in >= u->end)
+			return gFalse;
+		gU8 n = *u->in++;
+		if (n == 128)
+			continue;
+		u->repeat = n > 128;
+		u->count = u->repeat ? 257 - n : n + 1;
+	}
+	if (u->in >= u->end)
+		return gFalse;
+
+	*out = *u->in;
+	if (--u->count == 0 || !u->repeat)
+		u->in++;
+	return gTrue;
+}
+
+static GFXINLINE gBool ws75bepdUnpackComplete(const WS75bEPDUnpacker *u) {
+	return !u->count && u->in == u->end;
+}
+
+/*
+ * Checks everything that can be checked before the panel is powered: the header, the size of the
+ * panel, the CRC of the payload and that the payload unpacks to exactly one frame.
+ */
+static GFXINLINE gBool ws75bepdCheckFrame(const gU8 *in, gU32 length, WS75bEPDFrameHeader *header) {
+	if (!ws75bepdReadFrameHeader(in, length, header))
+		return gFalse;
+	if (header->width != GDISP_SCREEN_WIDTH || header->height != GDISP_SCREEN_HEIGHT)
+		return gFalse;
+	if (header->payloadLength > length - WS75bEPD_FRAME_HEADER_SIZE)
+		return gFalse;
+
+	const gU8 *payload = in + WS75bEPD_FRAME_HEADER_SIZE;
+	if (ws75bepdCrc32(0, payload, header->payloadLength) != header->payloadCrc)
+		return gFalse;
+
+	switch (header->encoding) {
+	case WS75bEPD_ENCODING_RAW:
+		return header->payloadLength == WS75bEPD_FRAME_BYTES;
+	case WS75bEPD_ENCODING_PACKBITS: {
+		WS75bEPDUnpacker unpacker;
+		gU32 unpacked = 0;
+		gU8 byte;
+		ws75bepdUnpackBegin(&unpacker, payload, header->payloadLength);
+		while (unpacked <= WS75bEPD_FRAME_BYTES && ws75bepdUnpackByte(&unpacker, &byte))
+			unpacked++;
+		return unpacked == WS75bEPD_FRAME_BYTES && ws75bepdUnpackComplete(&unpacker);
+	}
+	default:
+		return gFalse;
+	}
+}
+
+#endif /* _WS75bEPD_FRAME_H_ */
@@ -0,0 +1,116 @@
+/*
+ * This file is subject to the terms of the GFX License. If a copy of
+ * the license was not distributed with this file, you can obtain one at:
+ *
+ *              http://ugfx.io/license.html
+ */
+
+/*
+ * Frame buffer layout of the WS75bEPD driver, shared with the host tools so they produce exactly
+ * the bytes the driver would send.
+ *
+ * The frame buffer stores 2 bits per pixel (PIXEL_COLOR_*), WS75bEPD_PPB pixels per byte with the
+ * left-most pixel in the lowest bits. It is stored column of bytes by column of bytes:
+ * [Line x=0][Line x=1][Line x=2] ... [Line x=GDISP_SCREEN_WIDTH/WS75bEPD_PPB]
+ * and every x-line contains GDISP_SCREEN_HEIGHT y-values.
+ * The panel expects 4 bits per pixel, so every frame buffer byte is sent as two bytes.
+ */
+
+#ifndef _WS75bEPD_PACK_H_
+#define _WS75bEPD_PACK_H_
+
+#include "gfx.h"
+#include "gdisp_lld_config.h"
+
+#ifndef GDISP_SCREEN_HEIGHT
+	#define GDISP_SCREEN_HEIGHT		384
+#endif
+#ifndef GDISP_SCREEN_WIDTH
+	#define GDISP_SCREEN_WIDTH		640
+#endif
+
+/* Every data byte determines 4 pixels. */
+#ifndef WS75bEPD_PPB
+  #define WS75bEPD_PPB   4
+#endif
+
+#define WS75bEPD_FRAME_BYTES		((GDISP_SCREEN_WIDTH / WS75bEPD_PPB) * GDISP_SCREEN_HEIGHT)
+/* Bytes sent to the panel for a full frame. */
+#define WS75bEPD_STREAM_BYTES		(WS75bEPD_FRAME_BYTES * 2)
+
+/* Maps orientation dependent coordinates to the coordinates of the panel. */
+static GFXINLINE void ws75bepdMapOrientation(gOrientation orientation, gCoord px, gCoord py, gCoord *x, gCoord *y) {
+	switch(orientation) {
+	default:
+	case gOrientation0:
+		*x = px;
+		*y = py;
+		break;
+	case gOrientation90:
+		*x = py;
+		*y = GDISP_SCREEN_HEIGHT - 1 - px;
+		break;
+	case gOrientation180:
+		*x = GDISP_SCREEN_WIDTH - 1 - px;
+		*y = GDISP_SCREEN_HEIGHT - 1 - py;
+		break;
+	case gOrientation270:
+		*x = GDISP_SCREEN_HEIGHT - 1 - py;
+		*y = px;
+		break;
+	}
+}
+
+static GFXINLINE gU32 ws75bepdFrameIndex(gCoord x, gCoord y) {
+	return (GDISP_SCREEN_HEIGHT * (x / WS75bEPD_PPB)) + y;
+}
+
+static GFXINLINE void ws75bepdSetPixel(gU8 *frame, gCoord x, gCoord y, gU8 colorValue) {
+	gU8 shift = (x % WS75bEPD_PPB) * 2;
+	gU8 *byte = frame + ws75bepdFrameIndex(x, y);
+
+	*byte = (*byte & ~(3 << shift)) | (colorValue << shift);
+}
+
+static GFXINLINE gU8 ws75bepdGetPixel(const gU8 *frame, gCoord x, gCoord y) {
+	return (frame[ws75bepdFrameIndex(x, y)] >> ((x % WS75bEPD_PPB) * 2)) & 3;
+}
+
+/*
+ * A region of the display packed for caching: the pixels row by row in orientation dependent
+ * coordinates, WS75bEPD_PPB pixels per byte with the first pixel in the lowest bits.
+ */
+#define WS75bEPD_REGION_BYTES(cx, cy)	(((gU32)(cx) * (cy) + WS75bEPD_PPB - 1) / WS75bEPD_PPB)
+
+static GFXINLINE gU8 ws75bepdConvertPixel(gU8 data) {
+	// pixel data is in the two-most right bits
+	data = data & 3;
+	if (data == 1) {
+		// the pixel is supposed to be red, we need to adjust
+		data <<= 2;
+	}
+	return data;
+}
+
+/* The two bytes sent to the panel for one frame buffer byte. */
+static GFXINLINE void ws75bepdExpandByte(gU8 pixelValues, gU8 *out) {
+	// as we are storing a pixel in 2 bits instead of 4 we need to extract that data now
+	for (int k=0; k<2; ++k) {
+		// put the pixels we are currently dealing with to the lower part
+		pixelValues >>= k * 4;
+		// first pixel is implemented in the third and fourth bit from the right (ENDIANESS!!)
+		gU8 firstPixel = ws75bepdConvertPixel(pixelValues >> 2);
+		// the second pixel is in the most right bits
+		gU8 secondPixel = ws75bepdConvertPixel(pixelValues);
+		out[k] = (secondPixel << 4) | firstPixel;
+	}
+}
+
+/* Frame buffer byte for the i-th byte of a frame in the order it is sent, row by row. */
+static GFXINLINE gU8 ws75bepdStreamByte(const gU8 *frame, gU32 i) {
+	gU32 row = i / (GDISP_SCREEN_WIDTH / WS75bEPD_PPB);
+	gU32 column = i % (GDISP_SCREEN_WIDTH / WS75bEPD_PPB);
+	return frame[(GDISP_SCREEN_HEIGHT * column) + row];
+}
+
+#endif /* _WS75bEPD_PACK_H_ */
@@ -0,0 +1,71 @@
+/*
+ * This file is subject to the terms of the GFX License. If a copy of
+ * the license was not distributed with this file, you can obtain one at:
+ *
+ *              http://ugfx.io/license.html
+ */
+
+/*
+ * Ring of pixel runs between the image decoder and the dithering of the WS75bEPD driver.
+ *
+ * The decoder (and the scaler, if one is active) runs on the core that called gdispImageDraw() and
+ * fills runs of horizontally adjacent pixels, a task on the other core dithers them and packs them
+ * into the frame buffer. There is exactly one producer and one consumer: head is only written by
+ * the producer, tail only by the consumer, and each publishes its index with release semantics
+ * after it is done with the run, so no lock is needed.
+ */
+
+#ifndef _WS75bEPD_PIPELINE_H_
+#define _WS75bEPD_PIPELINE_H_
+
+#include "gfx.h"
+
+#ifndef WS75bEPD_PIPELINE_RUNS
+	#define WS75bEPD_PIPELINE_RUNS		8
+#endif
+/* One row of a 640 pixel image takes five runs, decoders draw at most a row at a time. */
+#ifndef WS75bEPD_PIPELINE_RUN_PIXELS
+	#define WS75bEPD_PIPELINE_RUN_PIXELS	128
+#endif
+
+typedef struct WS75bEPDRun {
+	gCoord x, y;			/* of the first pixel */
+	gCoord count;
+	gColor colors[WS75bEPD_PIPELINE_RUN_PIXELS];
+} WS75bEPDRun;
+
+typedef struct WS75bEPDRing {
+	gU32 head;				/* runs published, written by the producer */
+	gU32 tail;				/* runs consumed, written by the consumer */
+	WS75bEPDRun runs[WS75bEPD_PIPELINE_RUNS];
+} WS75bEPDRing;
+
+/* The run the producer fills next, 0 while the ring is full. */
+static GFXINLINE WS75bEPDRun *ws75bepdRingWrite(WS75bEPDRing *r) {
+	if (r->head - __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE) == WS75bEPD_PIPELINE_RUNS)
+		return 0;
+	return &r->runs[r->head % WS75bEPD_PIPELINE_RUNS];
+}
+
+/* Hands the run of ws75bepdRingWrite() to the consumer. */
+static GFXINLINE void ws75bepdRingPublish(WS75bEPDRing *r) {
+	__atomic_store_n(&r->head, r->head + 1, __ATOMIC_RELEASE);
+}
+
+/* The oldest published run, 0 while the ring is empty. */
+static GFXINLINE WS75bEPDRun *ws75bepdRingRead(WS75bEPDRing *r) {
+	if (__atomic_load_n(&r->head, __ATOMIC_ACQUIRE) == r->tail)
+		return 0;
+	return &r->runs[r->tail % WS75bEPD_PIPELINE_RUNS];
+}
+
+/* Hands the run of ws75bepdRingRead() back to the producer. */
+static GFXINLINE void ws75bepdRingRelease(WS75bEPDRing *r) {
+	__atomic_store_n(&r->tail, r->tail + 1, __ATOMIC_RELEASE);
+}
+
+static GFXINLINE gBool ws75bepdRingEmpty(WS75bEPDRing *r) {
+	return __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE) == r->head;
+}
+
+#endif /* _WS75bEPD_PIPELINE_H_ */
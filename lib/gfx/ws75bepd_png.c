@@ -0,0 +1,86 @@
+/*
+ * This file is subject to the terms of the GFX License. If a copy of
+ * the license was not distributed with this file, you can obtain one at:
+ *
+ *              http://ugfx.io/license.html
+ */
+
+#include <string.h>
+
+#include "ws75bepd_png.h"
+#include "wake_arena.h"
+
+/* Reserved at link time, so a PNG never competes with the downloads and the frame buffer for memory. */
+static gU32 workspace[(WS75bEPD_PNG_WORKSPACE_BYTES + 3) / 4];
+
+static gU32 readU32(const gU8 *p) {
+	return ((gU32)p[0] << 24) | ((gU32)p[1] << 16) | ((gU32)p[2] << 8) | p[3];
+}
+
+static gU8 channels(gU8 colorType) {
+	switch(colorType) {
+	case 0:	return 1;		/* grayscale */
+	case 2:	return 3;		/* RGB */
+	case 3:	return 1;		/* palette */
+	case 4:	return 2;		/* grayscale with alpha */
+	case 6:	return 4;		/* RGBA */
+	default: return 0;
+	}
+}
+
+WS75bEPDPngFit ws75bepdPngCheck(const gU8 *data, gU32 size, WS75bEPDPngInfo *info) {
+	static const gU8 signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+	gU8 n;
+
+	/* the signature, then IHDR with its length of 13 */
+	if (size < 8 + 8 + 13 || memcmp(data, signature, 8) || readU32(data + 8) != 13 || memcmp(data + 12, "IHDR", 4))
+		return WS75bEPD_PNG_INVALID;
+
+	info->width = readU32(data + 16);
+	info->height = readU32(data + 20);
+	info->bitDepth = data[24];
+	info->colorType = data[25];
+	info->interlace = data[28];
+	n = channels(info->colorType);
+	if (!info->width || !info->height || !n || !info->bitDepth || info->bitDepth > 16)
+		return WS75bEPD_PNG_INVALID;
+	/* 64 bits at most per pixel, the row size stays in 32 bits below 2^24 */
+	if (info->width > 0xFFFFFF)
+		return WS75bEPD_PNG_TOO_WIDE;
+	info->rowBytes = (info->width * n * info->bitDepth + 7) / 8 + 1;
+
+	#if !GDISP_NEED_IMAGE_PNG_INTERLACED
+		if (info->interlace)
+			return WS75bEPD_PNG_INTERLACED;
+	#endif
+	/* the decoder keeps the row it unfilters and the one before */
+	if (info->rowBytes > WS75bEPD_PNG_ROW_BYTES)
+		return WS75bEPD_PNG_TOO_WIDE;
+	return WS75bEPD_PNG_FITS;
+}
+
+const char *ws75bepdPngFitName(WS75bEPDPngFit fit) {
+	switch(fit) {
+	case WS75bEPD_PNG_FITS:			return "fits";
+	case WS75bEPD_PNG_INVALID:		return "no PNG header";
+	case WS75bEPD_PNG_INTERLACED:	return "interlaced";
+	case WS75bEPD_PNG_TOO_WIDE:		return "rows too wide";
+	default:						return "?";
+	}
+}
+
+void ws75bepdPngReset(void) {
+	wakeArenaSetFixed(workspace, sizeof(workspace));
+}
+
+void ws75bepdPngEnter(void) {
+	wakeArenaUseFixed(1);
+}
+
+void ws75bepdPngLeave(void) {
+	wakeArenaUseFixed(0);
+}
+
+gU32 ws75bepdPngPeak(void) {
+	return wakeArenaFixedPeak();
+}
@@ -0,0 +1,85 @@
+/*
+ * This file is subject to the terms of the GFX License. If a copy of
+ * the license was not distributed with this file, you can obtain one at:
+ *
+ *              http://ugfx.io/license.html
+ */
+
+/*
+ * Bounded working set for the uGFX PNG decoder.
+ *
+ * While an image is open the decoder takes a block for its state, the inflate window among it, and two
+ * rows of filtered scanlines from gfxAlloc(). Inside ws75bepdPngEnter() and ws75bepdPngLeave() those
+ * allocations come from a workspace reserved at link time instead of the wake arena, and fail once it is
+ * full instead of going to the heap. ws75bepdPngCheck() tells from the IHDR chunk whether an image fits
+ * before anything is opened or drawn. The frame buffer and the rows of the scaler are allocated while the
+ * decoder draws but outlive it, the driver takes them beside the workspace with gfxAllocBeside().
+ *
+ * The workspace only works where gfx_arena.h routes gfxAlloc(), not with WAKE_ARENA_NO_GFX. It is static,
+ * WS75bEPD_PNG_WORKSPACE_BYTES of .bss for good, 41986 bytes with the 640 pixel panel and the defaults.
+ */
+
+#ifndef _WS75bEPD_PNG_H_
+#define _WS75bEPD_PNG_H_
+
+#include "gfx.h"
+#include "ws75bepd_pack.h"
+
+#ifndef GDISP_IMAGE_PNG_Z_BUFFER_SIZE
+	#define GDISP_IMAGE_PNG_Z_BUFFER_SIZE	32768
+#endif
+
+/*
+ * The rest of the decoder state: Huffman tables, file and blit buffers, the palette and the block headers. The uGFX
+ * private state is not visible outside its decoder, tools/pngbench fails when a decode takes more.
+ */
+#ifndef WS75bEPD_PNG_STATE_BYTES
+	#define WS75bEPD_PNG_STATE_BYTES		4096
+#endif
+
+/* A row of RGBA with 8 bits per channel as wide as the panel in any orientation, plus the filter byte. */
+#define WS75bEPD_PNG_ROW_BYTES				\
+	((GDISP_SCREEN_WIDTH > GDISP_SCREEN_HEIGHT ? GDISP_SCREEN_WIDTH : GDISP_SCREEN_HEIGHT) * 4 + 1)
+
+#define WS75bEPD_PNG_WORKSPACE_BYTES		\
+	(GDISP_IMAGE_PNG_Z_BUFFER_SIZE + WS75bEPD_PNG_STATE_BYTES + 2 * WS75bEPD_PNG_ROW_BYTES)
+
+typedef enum WS75bEPDPngFit {
+	WS75bEPD_PNG_FITS,
+	WS75bEPD_PNG_INVALID,			/* no PNG signature or IHDR chunk */
+	WS75bEPD_PNG_INTERLACED,		/* and GDISP_NEED_IMAGE_PNG_INTERLACED is off */
+	WS75bEPD_PNG_TOO_WIDE			/* the two rows do not fit */
+} WS75bEPDPngFit;
+
+typedef struct WS75bEPDPngInfo {
+	gU32 width;
+	gU32 height;
+	gU8 bitDepth;
+	gU8 colorType;
+	gU8 interlace;
+	gU32 rowBytes;					/* of one filtered scanline, with the filter byte */
+} WS75bEPDPngInfo;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+WS75bEPDPngFit ws75bepdPngCheck(const gU8 *data, gU32 size, WS75bEPDPngInfo *info);
+
+const char *ws75bepdPngFitName(WS75bEPDPngFit fit);
+
+/* Empties the workspace, before the image is opened. */
+void ws75bepdPngReset(void);
+
+/* Open and draw the image in between, scale and pipeline controls outside as they allocate for the driver. */
+void ws75bepdPngEnter(void);
+void ws75bepdPngLeave(void);
+
+/* The most of the workspace in use since ws75bepdPngReset(). */
+gU32 ws75bepdPngPeak(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
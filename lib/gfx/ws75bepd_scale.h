@@ -0,0 +1,231 @@
+/*
+ * This file is subject to the terms of the GFX License. If a copy of
+ * the license was not distributed with this file, you can obtain one at:
+ *
+ *              http://ugfx.io/license.html
+ */
+
+/*
+ * Streaming scaler of the WS75bEPD driver, sits between the image decoders and the dithering.
+ *
+ * The decoder draws the image at its own size, every source pixel is spread over the display pixels it
+ * overlaps with fixed-point area averaging. Both sizes are reduced by their greatest common divisor, a
+ * source pixel then covers a units and a display pixel b units along each axis, so the weights are
+ * exact integers and a display pixel is complete once its weights add up to bx * by.
+ *
+ * Display pixels are accumulated in a small ring of rows that are allocated on first use, a row is
+ * handed back as soon as all its pixels are complete. Decoders that do not draw row by row (the MCUs
+ * of JPEG) may need more rows than the ring has, the row furthest away is then emitted early with what
+ * it has got so far and counted in evictions.
+ */
+
+#ifndef _WS75bEPD_SCALE_H_
+#define _WS75bEPD_SCALE_H_
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "gfx.h"
+#include "ws75bepd_driver.h"
+
+#ifndef WS75bEPD_SCALER_ROWS
+	#define WS75bEPD_SCALER_ROWS		6
+#endif
+
+typedef void (*WS75bEPDScaleEmit)(GDisplay *g, gCoord x, gCoord y, gColor color);
+
+typedef struct WS75bEPDScaleRow {
+	gCoord row;				/* display row, -1 if free */
+	gCoord done;			/* completed pixels */
+	gU32 *sums;				/* red, green, blue and weight of every display pixel */
+} WS75bEPDScaleRow;
+
+typedef struct WS75bEPDScaler {
+	gCoord srcWidth, srcHeight;
+	/* the scaled image on the display, the offset is negative where it is cropped */
+	gCoord offsetX, offsetY;
+	gCoord scaledWidth, scaledHeight;
+	/* visible part of the scaled image in display coordinates */
+	gCoord x0, x1, y0, y1;
+	gU32 ax, bx, ay, by;
+	gBool direct;			/* every display pixel is covered by a single source pixel */
+	WS75bEPDScaleRow rows[WS75bEPD_SCALER_ROWS];
+	WS75bEPDScaleStats stats;
+} WS75bEPDScaler;
+
+static GFXINLINE gU32 ws75bepdGcd(gU32 a, gU32 b) {
+	while (b) {
+		gU32 t = a % b;
+		a = b;
+		b = t;
+	}
+	return a;
+}
+
+/* Returns gFalse for sizes the scaler can not handle. */
+static GFXINLINE gBool ws75bepdScaleBegin(WS75bEPDScaler *s, const WS75bEPDScale *scale, gCoord width, gCoord height) {
+	if (scale->width <= 0 || scale->height <= 0 || scale->width > WS75bEPD_SCALER_MAX_SIZE || scale->height > WS75bEPD_SCALER_MAX_SIZE)
+		return gFalse;
+
+	memset(s, 0, sizeof(*s));
+	s->srcWidth = scale->width;
+	s->srcHeight = scale->height;
+	s->scaledWidth = scale->width;
+	s->scaledHeight = scale->height;
+
+	/* wider than the display compares srcWidth / srcHeight > width / height */
+	gBool wider = (gU32)scale->width * height > (gU32)scale->height * width;
+	if (scale->mode == WS75bEPD_SCALE_FIT || scale->mode == WS75bEPD_SCALE_FILL) {
+		gU32 scaledWidth, scaledHeight;
+		if (wider == (scale->mode == WS75bEPD_SCALE_FIT)) {
+			scaledWidth = width;
+			scaledHeight = ((gU32)scale->height * width + scale->width / 2) / scale->width;
+		} else {
+			scaledHeight = height;
+			scaledWidth = ((gU32)scale->width * height + scale->height / 2) / scale->height;
+		}
+		/* filling with a very narrow image */
+		if (scaledWidth > WS75bEPD_SCALER_MAX_SIZE || scaledHeight > WS75bEPD_SCALER_MAX_SIZE)
+			return gFalse;
+		s->scaledWidth = scaledWidth < 1 ? 1 : scaledWidth;
+		s->scaledHeight = scaledHeight < 1 ? 1 : scaledHeight;
+	}
+	s->offsetX = (width - s->scaledWidth) / 2;
+	s->offsetY = (height - s->scaledHeight) / 2;
+	s->x0 = s->offsetX < 0 ? 0 : s->offsetX;
+	s->y0 = s->offsetY < 0 ? 0 : s->offsetY;
+	s->x1 = s->offsetX + s->scaledWidth > width ? width : s->offsetX + s->scaledWidth;
+	s->y1 = s->offsetY + s->scaledHeight > height ? height : s->offsetY + s->scaledHeight;
+
+	gU32 gx = ws75bepdGcd(s->scaledWidth, s->srcWidth);
+	gU32 gy = ws75bepdGcd(s->scaledHeight, s->srcHeight);
+	s->ax = s->scaledWidth / gx;
+	s->bx = s->srcWidth / gx;
+	s->ay = s->scaledHeight / gy;
+	s->by = s->srcHeight / gy;
+	s->direct = s->bx == 1 && s->by == 1;
+
+	for (int i = 0; i < WS75bEPD_SCALER_ROWS; i++)
+		s->rows[i].row = -1;
+	return gTrue;
+}
+
+static GFXINLINE void ws75bepdScaleEmitRow(GDisplay *g, WS75bEPDScaler *s, WS75bEPDScaleRow *r, WS75bEPDScaleEmit emit) {
+	for (gCoord x = s->x0; x < s->x1; x++) {
+		gU32 *sum = r->sums + (x - s->x0) * 4;
+		if (sum[3]) {
+			gU32 half = sum[3] / 2;
+			emit(g, x, r->row, RGB2COLOR((sum[0] + half) / sum[3], (sum[1] + half) / sum[3], (sum[2] + half) / sum[3]));
+		}
+	}
+	r->row = -1;
+}
+
+/* The ring row for a display row, evicting the row furthest away if the ring is full. 0 without memory. */
+static GFXINLINE WS75bEPDScaleRow *ws75bepdScaleRow(GDisplay *g, WS75bEPDScaler *s, gCoord row, WS75bEPDScaleEmit emit) {
+	WS75bEPDScaleRow *slot = 0, *furthest = 0;
+	gU32 used = 0;
+
+	for (int i = 0; i < WS75bEPD_SCALER_ROWS; i++) {
+		WS75bEPDScaleRow *r = &s->rows[i];
+		if (r->row == row)
+			return r;
+		if (r->row < 0) {
+			if (!slot || (!slot->sums && r->sums))
+				slot = r;
+			continue;
+		}
+		used++;
+		if (!furthest || abs(r->row - row) > abs(furthest->row - row))
+			furthest = r;
+	}
+
+	if (!slot) {
+		ws75bepdScaleEmitRow(g, s, furthest, emit);
+		s->stats.evictions++;
+		slot = furthest;
+		used--;
+	}
+	if (!slot->sums) {
+		gU32 bytes = (s->x1 - s->x0) * 4 * sizeof(gU32);
+		slot->sums = gfxAllocBeside(bytes);
+		if (!slot->sums)
+			return 0;
+		s->stats.bufferBytes += bytes;
+	}
+	memset(slot->sums, 0, (s->x1 - s->x0) * 4 * sizeof(gU32));
+	slot->row = row;
+	slot->done = 0;
+	if (++used > s->stats.peakRows)
+		s->stats.peakRows = used;
+	return slot;
+}
+
+/* Adds a source pixel, display pixels it completes are passed to emit. */
+static GFXINLINE void ws75bepdScalePixel(GDisplay *g, WS75bEPDScaler *s, gCoord sx, gCoord sy, gColor color, WS75bEPDScaleEmit emit) {
+	if (sx < 0 || sy < 0 || sx >= s->srcWidth || sy >= s->srcHeight)
+		return;
+
+	/* the source pixel covers [u0, u1) x [v0, v1) in units of the reduced grid */
+	gU32 u0 = sx * s->ax, u1 = u0 + s->ax;
+	gU32 v0 = sy * s->ay, v1 = v0 + s->ay;
+	gU32 full = s->bx * s->by;
+
+	for (gU32 j = v0 / s->by; j * s->by < v1; j++) {
+		gCoord y = s->offsetY + j;
+		if (y < s->y0 || y >= s->y1)
+			continue;
+		if (s->direct) {
+			for (gU32 i = u0; i < u1; i++) {
+				gCoord x = s->offsetX + i;
+				if (x >= s->x0 && x < s->x1)
+					emit(g, x, y, color);
+			}
+			continue;
+		}
+
+		gU32 top = v0 > j * s->by ? v0 : j * s->by;
+		gU32 bottom = v1 < (j + 1) * s->by ? v1 : (j + 1) * s->by;
+		WS75bEPDScaleRow *r = 0;
+
+		for (gU32 i = u0 / s->bx; i * s->bx < u1; i++) {
+			gCoord x = s->offsetX + i;
+			if (x < s->x0 || x >= s->x1)
+				continue;
+			if (!r && !(r = ws75bepdScaleRow(g, s, y, emit)))
+				return;
+
+			gU32 left = u0 > i * s->bx ? u0 : i * s->bx;
+			gU32 right = u1 < (i + 1) * s->bx ? u1 : (i + 1) * s->bx;
+			gU32 weight = (right - left) * (bottom - top);
+			gU32 *sum = r->sums + (x - s->x0) * 4;
+			sum[0] += RED_OF(color) * weight;
+			sum[1] += GREEN_OF(color) * weight;
+			sum[2] += BLUE_OF(color) * weight;
+			sum[3] += weight;
+			if (sum[3] < full)
+				continue;
+
+			gU32 half = full / 2;
+			emit(g, x, y, RGB2COLOR((sum[0] + half) / full, (sum[1] + half) / full, (sum[2] + half) / full));
+			sum[3] = 0;
+			if (++r->done == s->x1 - s->x0)
+				r->row = -1;
+		}
+	}
+}
+
+/* Emits what is left in the ring, the rows of images that were not drawn completely, and frees it. */
+static GFXINLINE void ws75bepdScaleEnd(GDisplay *g, WS75bEPDScaler *s, WS75bEPDScaleEmit emit) {
+	for (int i = WS75bEPD_SCALER_ROWS - 1; i >= 0; i--) {
+		if (s->rows[i].row >= 0) {
+			ws75bepdScaleEmitRow(g, s, &s->rows[i], emit);
+			s->stats.evictions++;
+		}
+		if (s->rows[i].sums)
+			gfxFree(s->rows[i].sums);
+		s->rows[i].sums = 0;
+	}
+}
+
+#endif /* _WS75bEPD_SCALE_H_ */
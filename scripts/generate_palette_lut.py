@@ -0,0 +1,123 @@
+"""
+Generates lib/gfx/ws75bepd_palette_lut.c, the black/white/red quantisation table of the WS75bEPD driver.
+
+Every 15 bit RGB color is mapped to the two palette colors whose mix comes closest to it in linear light
+and to the share of the second color in that mix:
+
+    bit 7..6  primary palette color (PIXEL_COLOR_*), the one closer to the input
+    bit 5..4  secondary palette color
+    bit 3..0  share of the secondary color in 1/30, 0 to 15
+
+Error diffusion works in the same linear light, the file also holds the palette in linear light and the tables
+that convert 8 bit sRGB channels to 12 bit linear ones and back.
+
+Runs as a PlatformIO pre script and can also be called directly: python3 scripts/generate_palette_lut.py
+"""
+
+import os
+
+# PIXEL_COLOR_* values of gdisp_lld_config.h and the sRGB colors they show on the panel
+PALETTE = {
+    0: (0, 0, 0),        # black
+    3: (255, 255, 255),  # white
+    1: (255, 0, 0),      # red
+}
+# channel weights of the distance, roughly the luminance contribution of each channel
+WEIGHTS = (0.30, 0.59, 0.11)
+MIX_STEPS = 30
+# linear light of the diffusion in 12 bits, converted back to sRGB from the top 10 bits
+LINEAR_MAX = 4095
+LINEAR_TO_SRGB_BITS = 10
+
+
+def linear(value):
+    value /= 255.0
+    if value <= 0.04045:
+        return value / 12.92
+    return ((value + 0.055) / 1.055) ** 2.4
+
+
+def srgb(value):
+    if value <= 0.0031308:
+        value *= 12.92
+    else:
+        value = 1.055 * value ** (1 / 2.4) - 0.055
+    return int(round(min(max(value, 0.0), 1.0) * 255))
+
+
+def distance(a, b):
+    return sum(w * (x - y) ** 2 for w, x, y in zip(WEIGHTS, a, b))
+
+
+def quantise(color, palette):
+    best = None
+    indices = sorted(palette)
+    for i, p in enumerate(indices):
+        for q in indices[i + 1:]:
+            a, b = palette[p], palette[q]
+            direction = [y - x for x, y in zip(a, b)]
+            length = sum(w * d * d for w, d in zip(WEIGHTS, direction))
+            share = sum(w * d * (c - x) for w, d, c, x in zip(WEIGHTS, direction, color, a)) / length
+            share = min(max(share, 0.0), 1.0)
+            mixed = [x + share * d for x, d in zip(a, direction)]
+            error = distance(color, mixed)
+            if best is None or error < best[0]:
+                if share > 0.5:
+                    best = (error, q, p, 1.0 - share)
+                else:
+                    best = (error, p, q, share)
+    _, primary, secondary, share = best
+    mix = min(int(round(share * MIX_STEPS)), 15)
+    return (primary << 6) | (secondary << 4) | mix
+
+
+def generate(path):
+    palette = {index: tuple(linear(c) for c in rgb) for index, rgb in PALETTE.items()}
+    entries = []
+    for index in range(1 << 15):
+        r = (index >> 10) & 31
+        g = (index >> 5) & 31
+        b = index & 31
+        # expand 5 bit channels to 8 bits the same way the driver truncates them
+        color = tuple(linear((c << 3) | (c >> 2)) for c in (r, g, b))
+        entries.append(quantise(color, palette))
+
+    def to_linear(c):
+        return int(round(linear(c) * LINEAR_MAX))
+
+    to_srgb = [srgb((i + 0.5) / (1 << LINEAR_TO_SRGB_BITS)) for i in range(1 << LINEAR_TO_SRGB_BITS)]
+
+    lines = [
+        "/* Generated by scripts/generate_palette_lut.py, do not edit. */",
+        "",
+        "const unsigned short ws75bepdPaletteLinear[4][3] = {",
+    ]
+    for index in range(4):
+        lines.append("\t{%d, %d, %d}," % tuple(to_linear(c) for c in PALETTE.get(index, (0, 0, 0))))
+    lines += ["};", "", "const unsigned short ws75bepdSrgbToLinear[256] = {"]
+    for start in range(0, 256, 16):
+        lines.append("\t" + ",".join("%d" % to_linear(c) for c in range(start, start + 16)) + ",")
+    lines += ["};", "", "const unsigned char ws75bepdLinearToSrgb[%d] = {" % len(to_srgb)]
+    for start in range(0, len(to_srgb), 16):
+        lines.append("\t" + ",".join("%d" % v for v in to_srgb[start:start + 16]) + ",")
+    lines += ["};", "", "const unsigned char ws75bepdPaletteLut[%d] = {" % len(entries)]
+    for start in range(0, len(entries), 16):
+        lines.append("\t" + ",".join("0x%02x" % e for e in entries[start:start + 16]) + ",")
+    lines += ["};", ""]
+
+    content = "\n".join(lines)
+    if os.path.exists(path):
+        with open(path) as existing:
+            if existing.read() == content:
+                return
+    with open(path, "w") as output:
+        output.write(content)
+
+
+try:
+    Import("env")  # noqa: F821, only defined when run by PlatformIO
+    project_dir = env["PROJECT_DIR"]  # noqa: F821
+except NameError:
+    project_dir = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..")
+
+generate(os.path.join(project_dir, "lib", "gfx", "ws75bepd_palette_lut.c"))
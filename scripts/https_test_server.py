@@ -0,0 +1,61 @@
+"""
+Serves a directory over HTTPS with TLS session resumption, to measure what resuming saves on the device.
+
+    openssl req -x509 -newkey rsa:2048 -nodes -days 365 -subj /CN=<host> -keyout key.pem -out cert.pem
+    python3 scripts/https_test_server.py --cert cert.pem --key key.pem --port 8443 data
+
+Point imageUrl at https://<host>:8443/<image> and pin the certificate with its fingerprint:
+
+    openssl x509 -in cert.pem -outform der | sha256sum
+
+Every connection is logged with the handshake it took. The device logs the same as [TLS] lines, compare the
+handshake time of the first wake after power on (full) with the following wakes (resumed), or set "resume" of the
+"tls" section in config.json to false for a baseline. --no-tickets makes the server fall back to session IDs.
+"""
+
+import argparse
+import functools
+import http.server
+import ssl
+import time
+
+
+class Handler(http.server.SimpleHTTPRequestHandler):
+    def setup(self):
+        super().setup()
+        self.server.connections += 1
+        resumed = self.connection.session_reused
+        self.server.resumed += resumed
+        print(f"{time.strftime('%H:%M:%S')} {self.client_address[0]} {self.connection.version()} "
+              f"{'resumed' if resumed else 'full'} handshake "
+              f"({self.server.resumed} of {self.server.connections} connections resumed)")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("directory")
+    parser.add_argument("--cert", required=True)
+    parser.add_argument("--key", required=True)
+    parser.add_argument("--port", type=int, default=8443)
+    parser.add_argument("--no-tickets", action="store_true")
+    args = parser.parse_args()
+
+    context = ssl.SSLContext(ssl.PROTOCOL_TLS_SERVER)
+    # the client speaks TLS 1.2, resumption of TLS 1.3 works differently
+    context.maximum_version = ssl.TLSVersion.TLSv1_2
+    context.load_cert_chain(args.cert, args.key)
+    # the session ID cache of the server context is always on
+    if args.no_tickets:
+        context.options |= ssl.OP_NO_TICKET
+
+    handler = functools.partial(Handler, directory=args.directory)
+    server = http.server.ThreadingHTTPServer(("", args.port), handler)
+    server.connections = 0
+    server.resumed = 0
+    server.socket = context.wrap_socket(server.socket, server_side=True)
+    print(f"serving {args.directory} on https://0.0.0.0:{args.port}")
+    server.serve_forever()
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,78 @@
+#ifndef _CONFIG_H_
+#define _CONFIG_H_
+
+#include "deadline.h"
+#include "energy.h"
+#include "scheduler.h"
+#include "tiles.h"
+
+// waveform of the panel: the full three color one, the fast black and white one, or fast unless there is red
+enum RefreshMode : uint8_t
+{
+  REFRESH_FULL,
+  REFRESH_FAST,
+  REFRESH_AUTO,
+};
+
+// how images that do not have the size of the panel are placed: as they are at the top left, scaled to fit the
+// panel, scaled to fill it (cropped), or centered (cropped)
+enum ScaleMode : uint8_t
+{
+  SCALE_NONE,
+  SCALE_FIT,
+  SCALE_FILL,
+  SCALE_CENTER,
+};
+
+// panels on the controller board, one uGFX display each, see lib/gfx/gfxconf.h
+#ifndef WS75bEPD_PANELS
+#define WS75bEPD_PANELS 1
+#endif
+const int MAX_PANELS = WS75bEPD_PANELS;
+
+// A panel on its own connector, it shares SCK, DIN and DC with the panel of the Waveshare board
+struct PanelConfig
+{
+  char imageUrl[64] = "";
+  int8_t cs = -1;
+  int8_t busy = -1;
+  int8_t rst = -1;
+};
+
+struct Config
+{
+  char imageUrl[64] = "";
+  // Floyd-Steinberg instead of ordered dithering for colors outside the palette
+  bool errorDiffusion = false;
+  RefreshMode refresh = REFRESH_FULL;
+  ScaleMode scale = SCALE_NONE;
+  // dither and pack on the second core while the first one decodes, false for the single core baseline
+  bool pipeline = true;
+  // decode unscaled PNGs in a workspace reserved at link time and turn down those that do not fit, see ws75bepd_png.h.
+  // The workspace takes about 41 kB of .bss whether this is on or not.
+  bool boundedPng = true;
+  // check the CRCs and the size of an image before the panel is opened for it, see verifyImage()
+  bool verifyImages = true;
+  // tiles drawn instead of imageUrl, each fetched and cached on its own
+  Layout layout;
+  // panel 0 is the one of the Waveshare board and shows imageUrl or the layout, only the others are configured here
+  PanelConfig panels[MAX_PANELS];
+  int panelCount = 1;
+  // the next panel gets its data while the last one refreshes, false waits for every refresh on its own
+  bool overlapRefresh = true;
+  Schedule schedule;
+  // how long the phases of a wake and the whole wake may take before it is cut short
+  WakeBudget budget;
+  EnergyProfile energy;
+  // ADC pin behind the battery voltage divider, -1 if the battery is not connected to one
+  int batteryPin = -1;
+  float batteryDividerRatio = 2.0f;
+  // the configuration window after power on closes after this long without a request, but stays open at most portalMaxS
+  uint16_t portalIdleS = 120;
+  uint16_t portalMaxS = 900;
+  // open the window after a restart, watchdog, brownout or panic too, so /log can be read right after the failure.
+  // Off, as a board that keeps restarting would otherwise run the window and the WiFi portal on every restart.
+  bool portalAfterReset = false;
+};
+
+#endif
@@ -0,0 +1,94 @@
+#include "deadline.h"
+
+#include "log.h"
+
+RTC_DATA_ATTR DeadlineStats deadlineStats;
+DeadlineStats deadlineStatsThisWake;
+
+static WakeBudget budget;
+static bool started = false;
+static uint32_t beginMs = 0;
+// what the phases took before deadlineBegin()
+static uint32_t spentBeforeMs[PHASE_COUNT];
+static bool cutShort = false;
+
+void deadlineBegin(const WakeBudget &wakeBudget)
+{
+  budget = wakeBudget;
+  started = true;
+  beginMs = millis();
+  for (int phase = 0; phase < PHASE_COUNT; ++phase)
+  {
+    spentBeforeMs[phase] = phaseElapsedMs(static_cast<Phase>(phase));
+  }
+}
+
+static uint32_t phaseSpentMs(Phase phase)
+{
+  return phaseElapsedMs(phase) - spentBeforeMs[phase];
+}
+
+uint32_t deadlineRemainingMs(Phase phase)
+{
+  uint32_t remaining = DEADLINE_NONE;
+  if (!started)
+  {
+    return remaining;
+  }
+  if (budget.phaseMs[phase])
+  {
+    uint32_t spent = phaseSpentMs(phase);
+    remaining = spent < budget.phaseMs[phase] ? budget.phaseMs[phase] - spent : 0;
+  }
+  if (budget.wakeMs)
+  {
+    uint32_t spent = millis() - beginMs;
+    remaining = min(remaining, spent < budget.wakeMs ? budget.wakeMs - spent : 0);
+  }
+  return remaining;
+}
+
+bool deadlinePassed(Phase phase)
+{
+  if (deadlineRemainingMs(phase) > 0)
+  {
+    return false;
+  }
+  deadlineCut(phase);
+  return true;
+}
+
+void deadlineCut(Phase phase)
+{
+  if (cutShort)
+  {
+    return;
+  }
+  cutShort = true;
+
+  // the budget that ran out, a phase that gave up early has no shortfall
+  uint32_t shortfall = 0;
+  if (started && budget.phaseMs[phase] && phaseSpentMs(phase) > budget.phaseMs[phase])
+  {
+    shortfall = phaseSpentMs(phase) - budget.phaseMs[phase];
+  }
+  uint32_t wakeSpent = millis() - beginMs;
+  if (started && budget.wakeMs && wakeSpent > budget.wakeMs)
+  {
+    shortfall = max(shortfall, wakeSpent - budget.wakeMs);
+  }
+
+  for (DeadlineStats *stats : {&deadlineStats, &deadlineStatsThisWake})
+  {
+    stats->cutShort++;
+    stats->cutShortIn[phase]++;
+    stats->shortfallMs += shortfall;
+  }
+  LOG_WARN("DEADLINE", "wake cut short in %s, %u ms past its budget, going to sleep (%u wakes cut short so far)",
+           phaseName(phase), shortfall, deadlineStats.cutShort);
+}
+
+bool deadlineCutShort()
+{
+  return cutShort;
+}
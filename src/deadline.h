@@ -0,0 +1,56 @@
+#ifndef _DEADLINE_H_
+#define _DEADLINE_H_
+
+#include <Arduino.h>
+
+#include "metrics.h"
+
+// Budgets that bound how long a wake keeps the radio and the CPU on.
+//
+// Every phase of metrics.h can have a budget for the time its PhaseTimers add up to, and the whole wake has one on top.
+// Cancellation is cooperative: WiFi, NTP and the downloads take what is left of their budget as their timeouts and ask
+// deadlinePassed() between reads and attempts, draw() asks between panels and tiles. The first phase that runs out
+// cuts the wake short, the shortfall is recorded and the wake goes to sleep until the next slot. A refresh that was
+// started always runs to its end, the panel would be left between two images.
+
+// deadlineRemainingMs() of a phase without a budget in a wake without one
+const uint32_t DEADLINE_NONE = UINT32_MAX;
+
+struct WakeBudget
+{
+  // from deadlineBegin() to deep sleep, 0 for none
+  uint32_t wakeMs = 120 * 1000;
+  // wifi, config, time, download, decode, flush and portal, 0 for none. The configuration window has limits of its own.
+  uint32_t phaseMs[PHASE_COUNT] = {20 * 1000, 0, 10 * 1000, 45 * 1000, 30 * 1000, 90 * 1000, 0};
+  // sleep of a wake that could not get the time, there is no slot to sleep until
+  uint32_t retryS = 15 * 60;
+};
+
+// Counters survive deep sleep like DownloadStats.
+struct DeadlineStats
+{
+  uint32_t cutShort = 0;
+  uint32_t cutShortIn[PHASE_COUNT] = {0};
+  // how far the phase or the wake was past its budget when it was cancelled
+  uint32_t shortfallMs = 0;
+};
+
+extern DeadlineStats deadlineStats;
+extern DeadlineStats deadlineStatsThisWake;
+
+// Starts the budgets, the time the phases took before does not count.
+void deadlineBegin(const WakeBudget &budget);
+
+// What is left of the budget of phase or of the wake, whichever is less, 0 once one of them ran out.
+uint32_t deadlineRemainingMs(Phase phase);
+
+// Cancellation point, true once phase or the wake is out of time. Cuts the wake short the first time.
+bool deadlinePassed(Phase phase);
+
+// Cuts the wake short in phase, for a phase that gives up before its budget runs out. Only the first cut is recorded.
+void deadlineCut(Phase phase);
+
+// The wake was cut short, nothing more is drawn.
+bool deadlineCutShort();
+
+#endif
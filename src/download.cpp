@@ -0,0 +1,382 @@
+#include "download.h"
+#include "deadline.h"
+#include "log.h"
+#include "metrics.h"
+#include "tls_client.h"
+#include "wake_arena.h"
+
+#include <cstring>
+#include <stdexcept>
+#include <HTTPClient.h>
+#include <lwip/sockets.h>
+
+RTC_DATA_ATTR DownloadStats downloadStats;
+DownloadStats downloadStatsThisWake;
+
+static const char *responseHeaders[] = {"Content-Range", "Transfer-Encoding", "X-Next-Refresh", "Cache-Control",
+                                        "Content-Type", "ETag"};
+
+// every format showImage() can decode, native frames first as they are the smallest and need no decoding
+#ifdef BUILD_PROFILE_LEAN
+static const char *ACCEPTED_TYPES = "application/x-epaper-frame, image/png;q=0.9";
+#else
+static const char *ACCEPTED_TYPES = "application/x-epaper-frame, image/png;q=0.9, image/jpeg;q=0.8, image/bmp;q=0.5";
+#endif
+
+// first allocation for responses of unknown length, doubled whenever it runs full
+static const size_t INITIAL_CAPACITY = 32 * 1024;
+// smallest free space we read into when the length is unknown
+static const size_t MIN_READ_SIZE = 4 * 1024;
+static const uint32_t READ_TIMEOUT_MS = 5000;
+
+void Download::reserve(size_t size)
+{
+  if (size <= capacity)
+  {
+    return;
+  }
+
+  size_t newCapacity = max(max(size, capacity * 2), INITIAL_CAPACITY);
+  if (total > 0)
+  {
+    // never grow beyond what the server announced
+    newCapacity = max(size, static_cast<size_t>(total));
+  }
+
+  uint8_t *buffer = static_cast<uint8_t *>(wakeArenaRealloc(data, position, newCapacity));
+  if (!buffer)
+  {
+    throw std::length_error("Download does not fit into memory");
+  }
+  data = buffer;
+  capacity = newCapacity;
+}
+
+void RequestHeaders::add(const String &name, const String &value)
+{
+  if (count < MAX_HEADERS)
+  {
+    names[count] = name;
+    values[count] = value;
+    count++;
+  }
+}
+
+// Parses the total size from a "bytes <start>-<end>/<total>" header and checks that it starts at position.
+static bool checkContentRange(const String &contentRange, int position, int total)
+{
+  int start = 0;
+  int end = 0;
+  int size = 0;
+  if (sscanf(contentRange.c_str(), "bytes %d-%d/%d", &start, &end, &size) != 3)
+  {
+    return false;
+  }
+  return start == position && size == total;
+}
+
+// Seconds from X-Next-Refresh, falling back to the max-age directive of Cache-Control, -1 if neither is given.
+static long parseRefreshHint(HTTPClient &https)
+{
+  String nextRefresh = https.header("X-Next-Refresh");
+  if (nextRefresh.length() > 0)
+  {
+    return max(nextRefresh.toInt(), 0L);
+  }
+
+  String cacheControl = https.header("Cache-Control");
+  int maxAge = cacheControl.indexOf("max-age=");
+  if (maxAge >= 0)
+  {
+    return max(atol(cacheControl.c_str() + maxAge + strlen("max-age=")), 0L);
+  }
+  return -1;
+}
+
+// Blocks in select() until the socket has data instead of polling, so the task sleeps while the radio receives.
+static bool waitForData(WiFiClient *stream, int fd, uint32_t timeoutMs)
+{
+  // the TLS client has whole records decrypted already that select() would not see, available() asks
+  // mbedtls_ssl_get_bytes_avail() first
+  if (stream->available())
+  {
+    return true;
+  }
+  if (fd < 0)
+  {
+    return false;
+  }
+
+  fd_set readable;
+  FD_ZERO(&readable);
+  FD_SET(fd, &readable);
+  timeval timeout = {static_cast<time_t>(timeoutMs / 1000), static_cast<suseconds_t>((timeoutMs % 1000) * 1000)};
+  return select(fd + 1, &readable, nullptr, nullptr, &timeout) > 0;
+}
+
+// Reads up to length bytes straight into the download buffer. Returns 0 at the end of the stream or on timeout.
+static size_t receive(WiFiClient *stream, int fd, Download &download, size_t length)
+{
+  // a server that trickles never hits the read timeout
+  if (deadlinePassed(PHASE_DOWNLOAD))
+  {
+    throw std::logic_error("Out of time");
+  }
+  if (!waitForData(stream, fd, min(READ_TIMEOUT_MS, deadlineRemainingMs(PHASE_DOWNLOAD))))
+  {
+    return 0;
+  }
+
+  download.reserve(download.position + length);
+  int count = stream->read(download.data + download.position, length);
+  if (count <= 0)
+  {
+    return 0;
+  }
+  if (!phaseMetrics.firstByteMs)
+  {
+    phaseMetrics.firstByteMs = millis();
+  }
+  download.position += count;
+  return count;
+}
+
+// Reads exactly length bytes, returns false if the stream ends early.
+static bool receiveExactly(WiFiClient *stream, int fd, Download &download, size_t length)
+{
+  while (length > 0)
+  {
+    size_t count = receive(stream, fd, download, length);
+    if (count == 0)
+    {
+      return false;
+    }
+    length -= count;
+  }
+  return true;
+}
+
+static void receiveIdentity(WiFiClient *stream, int fd, Download &download)
+{
+  if (download.total >= 0)
+  {
+    download.finished = receiveExactly(stream, fd, download, download.total - download.position);
+    return;
+  }
+
+  // no length given, the body ends when the server closes the connection
+  while (true)
+  {
+    download.reserve(download.position + MIN_READ_SIZE);
+    if (receive(stream, fd, download, download.capacity - download.position) == 0)
+    {
+      download.finished = !stream->connected();
+      return;
+    }
+  }
+}
+
+static void receiveChunked(WiFiClient *stream, int fd, Download &download)
+{
+  stream->setTimeout(READ_TIMEOUT_MS);
+  while (true)
+  {
+    String line = stream->readStringUntil('\n');
+    if (line.length() == 0)
+    {
+      return;
+    }
+
+    char *end = nullptr;
+    unsigned long chunkSize = strtoul(line.c_str(), &end, 16);
+    if (end == line.c_str())
+    {
+      throw std::logic_error("Malformed chunk header");
+    }
+
+    if (chunkSize == 0)
+    {
+      // skip the optional trailers up to the empty line
+      while (stream->readStringUntil('\n').length() > 1)
+      {
+      }
+      download.finished = true;
+      return;
+    }
+
+    if (!receiveExactly(stream, fd, download, chunkSize))
+    {
+      return;
+    }
+    // CRLF after the chunk data
+    stream->readStringUntil('\n');
+  }
+}
+
+// Ends the connection on every way out of fetchImage(), the receive functions and reserve() throw.
+struct ConnectionGuard
+{
+  HTTPClient &https;
+  ~ConnectionGuard()
+  {
+    https.end();
+  }
+};
+
+void fetchImage(const String &url, Download &download, const RequestHeaders &headers)
+{
+  // resumes the TLS session of the previous wake, plain HTTP goes through the default client. Declared first, as
+  // HTTPClient stops it again when it is destroyed.
+  ResumableTlsClient tlsClient(tlsSettings);
+  HTTPClient https;
+  ConnectionGuard guard{https};
+
+  LOG_INFO("HTTP", "GET %s", url.c_str());
+
+  bool began = url.startsWith("https://") ? https.begin(tlsClient, url) : https.begin(url);
+  if (!began)
+  {
+    LOG_ERROR("HTTP", "Can not establish connection to Server.");
+    throw std::logic_error("Can not establish HTTP connection!");
+  }
+
+  for (int i = 0; i < headers.count; ++i)
+  {
+    https.addHeader(headers.names[i], headers.values[i]);
+  }
+
+  https.addHeader("Accept", ACCEPTED_TYPES);
+
+  // ranges only make sense if we know how long the whole image is
+  bool resuming = download.position > 0 && download.total > 0;
+  if (resuming)
+  {
+    https.addHeader("Range", String("bytes=") + String(download.position) + "-");
+  }
+  https.collectHeaders(responseHeaders, sizeof(responseHeaders) / sizeof(responseHeaders[0]));
+
+  int httpCode = https.GET();
+  LOG_INFO("HTTP", "GET... code: %d", httpCode);
+
+  bool chunked = https.header("Transfer-Encoding").equalsIgnoreCase("chunked");
+  download.refreshHint = parseRefreshHint(https);
+  strlcpy(download.contentType, https.header("Content-Type").c_str(), sizeof(download.contentType));
+
+  download.notModified = false;
+  if (httpCode == HTTP_CODE_NOT_MODIFIED)
+  {
+    // only happens if the caller sent If-None-Match, its copy is still current
+    LOG_INFO("HTTP", "not modified");
+    download.notModified = true;
+    download.finished = true;
+    download.position = download.total = 0;
+    return;
+  }
+
+  String etag = https.header("ETag");
+  if (etag.length() < sizeof(download.etag))
+  {
+    strlcpy(download.etag, etag.c_str(), sizeof(download.etag));
+  }
+  else
+  {
+    // cut short it would never match, better not to send it back at all
+    download.etag[0] = '\0';
+  }
+
+  if (httpCode == HTTP_CODE_PARTIAL_CONTENT && resuming && !chunked)
+  {
+    if (!checkContentRange(https.header("Content-Range"), download.position, download.total))
+    {
+      LOG_WARN("HTTP", "Content-Range does not match, starting over");
+      download.position = 0;
+      throw std::logic_error("Unexpected Content-Range");
+    }
+    LOG_INFO("HTTP", "resuming at byte %d", download.position);
+    downloadStats.resumedBytes += download.position;
+    downloadStatsThisWake.resumedBytes += download.position;
+  }
+  else if (httpCode == HTTP_CODE_OK)
+  {
+    // either the first attempt or the server ignored the Range header
+    download.position = 0;
+    download.total = chunked ? -1 : https.getSize();
+    if (download.total > 0)
+    {
+      download.reserve(download.total);
+    }
+  }
+  else
+  {
+    LOG_WARN("HTTP", "GET... failed, error: %s", https.errorToString(httpCode).c_str());
+    throw std::logic_error("HTTP Code not OK");
+  }
+
+  download.finished = false;
+  WiFiClient *stream = https.getStreamPtr();
+  // WiFiClient::fd() is not virtual, the socket of the TLS client has to be asked for on the TLS client itself
+  int fd = stream == &tlsClient ? tlsClient.fd() : stream->fd();
+
+  int startPosition = download.position;
+  uint32_t receiveStart = millis();
+  if (chunked)
+  {
+    receiveChunked(stream, fd, download);
+  }
+  else
+  {
+    receiveIdentity(stream, fd, download);
+  }
+  phaseMetrics.receivedBytes += download.position - startPosition;
+  phaseMetrics.receiveMs += millis() - receiveStart;
+
+  if (!download.finished)
+  {
+    LOG_WARN("HTTP", "Connection closed after %d bytes", download.position);
+    if (download.total < 0)
+    {
+      // without a length we can not ask for the rest
+      download.position = 0;
+    }
+    throw std::logic_error("Connection closed before download finished");
+  }
+
+  download.total = download.position;
+  LOG_INFO("HTTP", "Finished Download of %d bytes", download.total);
+}
+
+bool downloadWithRetry(const String &url, Download &download, const RetryPolicy &policy, const RequestHeaders &headers)
+{
+  uint32_t backoff = policy.initialBackoffMs;
+
+  while (true)
+  {
+    downloadStats.attempts++;
+    downloadStatsThisWake.attempts++;
+    try
+    {
+      fetchImage(url, download, headers);
+      return true;
+    }
+    catch (const std::logic_error &e)
+    {
+      LOG_WARN("HTTP", "Could not fetch image: %s", e.what());
+    }
+
+    if (backoff >= deadlineRemainingMs(PHASE_DOWNLOAD))
+    {
+      LOG_ERROR("HTTP", "Download deadline exceeded");
+      downloadStats.deadlineMisses++;
+      downloadStatsThisWake.deadlineMisses++;
+      deadlineCut(PHASE_DOWNLOAD);
+      return false;
+    }
+
+    LOG_INFO("HTTP", "retrying in %u ms", backoff);
+    delay(backoff);
+    backoff = min(backoff * 2, policy.maxBackoffMs);
+
+    downloadStats.retries++;
+    downloadStatsThisWake.retries++;
+  }
+}
@@ -0,0 +1,65 @@
+#ifndef _DOWNLOAD_H_
+#define _DOWNLOAD_H_
+
+#include <Arduino.h>
+
+// Counters survive deep sleep so the airtime saved by resuming can be measured over many wakes.
+struct DownloadStats
+{
+  uint32_t attempts = 0;
+  uint32_t retries = 0;
+  uint32_t resumedBytes = 0;
+  uint32_t deadlineMisses = 0;
+};
+
+struct RetryPolicy
+{
+  uint32_t initialBackoffMs = 500;
+  uint32_t maxBackoffMs = 8000;
+};
+
+// The buffer lives in the wake arena and is released with it before deep sleep.
+struct Download
+{
+  uint8_t *data = nullptr;
+  size_t capacity = 0;
+  // -1 as long as the server did not tell us the length (chunked or close-delimited responses)
+  int total = -1;
+  int position = 0;
+  bool finished = false;
+  // seconds until the server expects new content, from X-Next-Refresh or Cache-Control: max-age, -1 if not given
+  long refreshHint = -1;
+  char contentType[32] = "";
+  // entity tag of the response, to be sent back as If-None-Match
+  char etag[64] = "";
+  // the server answered 304 to If-None-Match, there is no body
+  bool notModified = false;
+
+  // Grows the buffer to hold at least size bytes, keeping the bytes received so far.
+  // Throws std::length_error if there is not enough memory.
+  void reserve(size_t size);
+};
+
+// Extra headers sent with every request of a download.
+struct RequestHeaders
+{
+  static const int MAX_HEADERS = 8;
+  String names[MAX_HEADERS];
+  String values[MAX_HEADERS];
+  int count = 0;
+
+  void add(const String &name, const String &value);
+};
+
+extern DownloadStats downloadStats;
+extern DownloadStats downloadStatsThisWake;
+
+// Fetches the remaining bytes of download, resuming at download.position with a Range request.
+// Throws std::logic_error on any failure, leaving the bytes received so far in place.
+void fetchImage(const String &url, Download &download, const RequestHeaders &headers);
+
+// Calls fetchImage until the download is complete, backing off exponentially between attempts.
+// Returns false and cuts the wake short if the download budget runs out before, see deadline.h.
+bool downloadWithRetry(const String &url, Download &download, const RetryPolicy &policy, const RequestHeaders &headers);
+
+#endif
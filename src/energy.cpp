@@ -0,0 +1,67 @@
+#include "energy.h"
+
+static const float MS_PER_HOUR = 3600.0f * 1000.0f;
+
+const char *powerStateName(PowerState state)
+{
+  switch (state)
+  {
+  case POWER_RADIO:
+    return "radio";
+  case POWER_CPU:
+    return "cpu";
+  case POWER_SPI:
+    return "spi";
+  case POWER_PANEL_BUSY:
+    return "panel busy";
+  case POWER_SLEEP:
+    return "sleep";
+  default:
+    return "unknown";
+  }
+}
+
+float traceChargeMah(const EnergyProfile &profile, const PhaseTrace &trace)
+{
+  float charge = 0.0f;
+  for (int state = 0; state < POWER_STATE_COUNT; ++state)
+  {
+    charge += profile.currentMa[state] * trace.stateMs[state] / MS_PER_HOUR;
+  }
+  return charge;
+}
+
+void recordWake(EnergyLedger &ledger, const EnergyProfile &profile, const PhaseTrace &trace, uint32_t sleepSeconds)
+{
+  PhaseTrace sleep;
+  sleep.stateMs[POWER_SLEEP] = sleepSeconds * 1000;
+
+  uint32_t wakeMs = 0;
+  for (int state = 0; state < POWER_STATE_COUNT; ++state)
+  {
+    wakeMs += trace.stateMs[state];
+  }
+
+  ledger.wakes++;
+  ledger.lastWakeMah = traceChargeMah(profile, trace);
+  ledger.lastSleepMah = traceChargeMah(profile, sleep);
+  ledger.consumedMah += ledger.lastWakeMah + ledger.lastSleepMah;
+  ledger.lastCycleSeconds = wakeMs / 1000 + sleepSeconds;
+}
+
+float projectedRuntimeHours(const EnergyLedger &ledger, const EnergyProfile &profile)
+{
+  float cycleMah = ledger.lastWakeMah + ledger.lastSleepMah;
+  if (ledger.wakes == 0 || cycleMah <= 0.0f || ledger.lastCycleSeconds == 0)
+  {
+    return 0.0f;
+  }
+
+  float remainingMah = profile.batteryCapacityMah - ledger.consumedMah;
+  if (remainingMah <= 0.0f)
+  {
+    return 0.0f;
+  }
+  float cycles = remainingMah / cycleMah;
+  return cycles * ledger.lastCycleSeconds / 3600.0f;
+}
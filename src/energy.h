@@ -0,0 +1,54 @@
+#ifndef _ENERGY_H_
+#define _ENERGY_H_
+
+#include <stdint.h>
+
+// Does not depend on Arduino so it can be fed synthetic phase traces on the host.
+
+enum PowerState : uint8_t
+{
+  POWER_RADIO,      // WiFi connected and transferring, CPU active
+  POWER_CPU,        // CPU active, radio off or idle
+  POWER_SPI,        // sending the frame to the panel
+  POWER_PANEL_BUSY, // panel refreshing, CPU waiting for BUSY
+  POWER_SLEEP,      // deep sleep between wakes
+  POWER_STATE_COUNT
+};
+
+// Currents of the whole board in each state. The defaults are rough figures for an ESP32 DevKit with the Waveshare
+// driver board, the config should override them with measured values.
+struct EnergyProfile
+{
+  float currentMa[POWER_STATE_COUNT] = {120.0f, 40.0f, 45.0f, 30.0f, 0.15f};
+  float batteryCapacityMah = 2000.0f;
+};
+
+// Time spent in each state during one wake.
+struct PhaseTrace
+{
+  uint32_t stateMs[POWER_STATE_COUNT] = {0};
+};
+
+// Survives deep sleep, is reset together with the RTC memory when the battery is replaced.
+struct EnergyLedger
+{
+  uint32_t wakes = 0;
+  float consumedMah = 0.0f;
+  float lastWakeMah = 0.0f;
+  float lastSleepMah = 0.0f;
+  uint32_t lastCycleSeconds = 0;
+  uint16_t batteryMv = 0;
+};
+
+const char *powerStateName(PowerState state);
+
+// Charge used by a trace, including POWER_SLEEP if it contains any.
+float traceChargeMah(const EnergyProfile &profile, const PhaseTrace &trace);
+
+// Books a finished wake and the deep sleep that follows it.
+void recordWake(EnergyLedger &ledger, const EnergyProfile &profile, const PhaseTrace &trace, uint32_t sleepSeconds);
+
+// Hours until the battery is empty if every cycle costs as much as the last one, 0 if nothing was recorded yet.
+float projectedRuntimeHours(const EnergyLedger &ledger, const EnergyProfile &profile);
+
+#endif
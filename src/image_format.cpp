@@ -0,0 +1,196 @@
+#include "image_format.h"
+
+#include <string.h>
+
+extern "C"
+{
+#include "ws75bepd_frame.h"
+}
+
+static bool startsWith(const uint8_t *data, size_t size, const char *magic, size_t length)
+{
+  return size >= length && memcmp(data, magic, length) == 0;
+}
+
+ImageFormat detectImageFormat(const uint8_t *data, size_t size, const char *contentType)
+{
+  if (startsWith(data, size, "\x89PNG\r\n\x1a\n", 8))
+  {
+    return IMAGE_PNG;
+  }
+  if (startsWith(data, size, "\xff\xd8\xff", 3))
+  {
+    return IMAGE_JPEG;
+  }
+  if (startsWith(data, size, "BM", 2))
+  {
+    return IMAGE_BMP;
+  }
+  if (startsWith(data, size, "EPF1", 4))
+  {
+    return IMAGE_FRAME;
+  }
+
+  if (!contentType)
+  {
+    return IMAGE_UNKNOWN;
+  }
+  if (strncmp(contentType, "image/png", 9) == 0)
+  {
+    return IMAGE_PNG;
+  }
+  if (strncmp(contentType, "image/jpeg", 10) == 0)
+  {
+    return IMAGE_JPEG;
+  }
+  if (strncmp(contentType, "image/bmp", 9) == 0)
+  {
+    return IMAGE_BMP;
+  }
+  if (strncmp(contentType, "application/x-epaper-frame", 26) == 0)
+  {
+    return IMAGE_FRAME;
+  }
+  return IMAGE_UNKNOWN;
+}
+
+const char *imageFormatName(ImageFormat format)
+{
+  switch (format)
+  {
+  case IMAGE_PNG:
+    return "png";
+  case IMAGE_JPEG:
+    return "jpeg";
+  case IMAGE_BMP:
+    return "bmp";
+  case IMAGE_FRAME:
+    return "frame";
+  default:
+    return "unknown";
+  }
+}
+
+static uint32_t bigEndian16(const uint8_t *data)
+{
+  return (data[0] << 8) | data[1];
+}
+
+static uint32_t bigEndian32(const uint8_t *data)
+{
+  return (bigEndian16(data) << 16) | bigEndian16(data + 2);
+}
+
+static uint32_t littleEndian16(const uint8_t *data)
+{
+  return data[0] | (data[1] << 8);
+}
+
+static uint32_t littleEndian32(const uint8_t *data)
+{
+  return littleEndian16(data) | (littleEndian16(data + 2) << 16);
+}
+
+// The first start of frame marker, SOF0 to SOF15 without DHT, JPG and DAC.
+static bool jpegSize(const uint8_t *data, size_t size, uint32_t &width, uint32_t &height)
+{
+  size_t position = 2;
+  while (position + 4 <= size)
+  {
+    if (data[position] != 0xff)
+    {
+      return false;
+    }
+    uint8_t marker = data[position + 1];
+    if (marker == 0xff)
+    {
+      // fill byte
+      position++;
+      continue;
+    }
+    uint32_t length = bigEndian16(data + position + 2);
+    bool startOfFrame = marker >= 0xc0 && marker <= 0xcf && marker != 0xc4 && marker != 0xc8 && marker != 0xcc;
+    if (startOfFrame)
+    {
+      if (length < 7 || position + 9 > size)
+      {
+        return false;
+      }
+      height = bigEndian16(data + position + 5);
+      width = bigEndian16(data + position + 7);
+      return width > 0 && height > 0;
+    }
+    // the scan data starts before a start of frame
+    if (marker == 0xda || length < 2)
+    {
+      return false;
+    }
+    position += 2 + length;
+  }
+  return false;
+}
+
+bool imageSize(const uint8_t *data, size_t size, ImageFormat format, uint32_t &width, uint32_t &height)
+{
+  switch (format)
+  {
+  case IMAGE_PNG:
+    // the signature, then the length and type of IHDR
+    if (size < 24 || memcmp(data + 12, "IHDR", 4) != 0)
+    {
+      return false;
+    }
+    width = bigEndian32(data + 16);
+    height = bigEndian32(data + 20);
+    return true;
+  case IMAGE_JPEG:
+    return jpegSize(data, size, width, height);
+  case IMAGE_BMP:
+  {
+    if (size < 26)
+    {
+      return false;
+    }
+    // a negative height is a top-down bitmap
+    int32_t signedHeight = static_cast<int32_t>(littleEndian32(data + 22));
+    width = littleEndian32(data + 18);
+    height = signedHeight < 0 ? -signedHeight : signedHeight;
+    return true;
+  }
+  default:
+    return false;
+  }
+}
+
+bool checkPngChunks(const uint8_t *data, size_t size)
+{
+  size_t position = 8;
+  bool first = true;
+  bool imageData = false;
+  while (position + 12 <= size)
+  {
+    uint32_t length = bigEndian32(data + position);
+    const uint8_t *type = data + position + 4;
+    if (length > size - position - 12)
+    {
+      return false;
+    }
+    // the CRC covers the type and the data
+    if (ws75bepdCrc32(0, type, length + 4) != bigEndian32(type + 4 + length))
+    {
+      return false;
+    }
+    if (first && memcmp(type, "IHDR", 4) != 0)
+    {
+      return false;
+    }
+    first = false;
+    imageData = imageData || memcmp(type, "IDAT", 4) == 0;
+    position += 12 + length;
+    if (memcmp(type, "IEND", 4) == 0)
+    {
+      return imageData;
+    }
+  }
+  return false;
+}
@@ -0,0 +1,29 @@
+#ifndef _IMAGE_FORMAT_H_
+#define _IMAGE_FORMAT_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+enum ImageFormat : uint8_t
+{
+  IMAGE_UNKNOWN,
+  IMAGE_PNG,
+  IMAGE_JPEG,
+  IMAGE_BMP,
+  // native frame of the display driver, see ws75bepd_frame.h
+  IMAGE_FRAME,
+};
+
+// Looks at the magic bytes first and only falls back to the Content-Type the server sent.
+ImageFormat detectImageFormat(const uint8_t *data, size_t size, const char *contentType);
+
+const char *imageFormatName(ImageFormat format);
+
+// Width and height from the header of a PNG, JPEG or BMP, false if the header is cut off or malformed.
+bool imageSize(const uint8_t *data, size_t size, ImageFormat format, uint32_t &width, uint32_t &height);
+
+// Walks the chunks of a PNG from IHDR to IEND and checks their CRCs, which the uGFX decoder skips.
+// False if a chunk is damaged or cut off, or IHDR, IDAT or IEND is missing.
+bool checkPngChunks(const uint8_t *data, size_t size);
+
+#endif
@@ -0,0 +1,199 @@
+#include "log.h"
+
+#include <stdarg.h>
+
+LogStats logStats;
+
+// The RAM ring, head is only advanced by logWrite() and tail only by drain(), both under lock.
+static char buffer[LOG_BUFFER_SIZE];
+static uint32_t head = 0;
+static uint32_t tail = 0;
+static uint32_t reportedDrops = 0;
+static portMUX_TYPE lock = portMUX_INITIALIZER_UNLOCKED;
+static TaskHandle_t task = nullptr;
+
+// Not initialized by the bootloader, so it survives every reset but a power on. The magic tells it from garbage.
+struct RetainedLog
+{
+  uint32_t magic;
+  // bytes ever written, the ring holds the last LOG_RTC_SIZE of them
+  uint32_t head;
+  char data[LOG_RTC_SIZE];
+};
+
+static const uint32_t RETAINED_LOG_MAGIC = 0x4c4f4731;
+static RTC_NOINIT_ATTR RetainedLog retained;
+
+static char levelLetter(uint8_t level)
+{
+  switch (level)
+  {
+  case LOG_LEVEL_ERROR:
+    return 'E';
+  case LOG_LEVEL_WARN:
+    return 'W';
+  case LOG_LEVEL_INFO:
+    return 'I';
+  default:
+    return 'D';
+  }
+}
+
+// Writes the RAM ring to Serial until it is empty, on the UART task or, without one, on the caller.
+static void drain()
+{
+  while (true)
+  {
+    portENTER_CRITICAL(&lock);
+    uint32_t end = head;
+    uint32_t dropped = logStats.dropped;
+    portEXIT_CRITICAL(&lock);
+
+    if (tail == end)
+    {
+      if (dropped != reportedDrops)
+      {
+        Serial.printf("[LOG] %u lines dropped, the ring was full\r\n", dropped - reportedDrops);
+        reportedDrops = dropped;
+      }
+      return;
+    }
+
+    // up to the end of the ring, the rest in the next round
+    uint32_t start = tail % LOG_BUFFER_SIZE;
+    uint32_t length = min<uint32_t>(end - tail, LOG_BUFFER_SIZE - start);
+    Serial.write(reinterpret_cast<const uint8_t *>(buffer + start), length);
+
+    portENTER_CRITICAL(&lock);
+    tail += length;
+    portEXIT_CRITICAL(&lock);
+  }
+}
+
+static void uartTask(void *parameter)
+{
+  while (true)
+  {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    drain();
+  }
+}
+
+// Copies length bytes to the ring of size bytes at position, wrapping around its end.
+static void copyToRing(char *ring, uint32_t size, uint32_t position, const char *data, uint32_t length)
+{
+  uint32_t start = position % size;
+  uint32_t first = min(length, size - start);
+  memcpy(ring + start, data, first);
+  memcpy(ring, data + first, length - first);
+}
+
+void logInit()
+{
+  if (retained.magic != RETAINED_LOG_MAGIC)
+  {
+    retained.magic = RETAINED_LOG_MAGIC;
+    retained.head = 0;
+  }
+
+  // the wake runs on core 1, the UART task takes the gaps WiFi leaves on core 0
+  if (xTaskCreatePinnedToCore(uartTask, "log", 2560, nullptr, 1, &task, 0) != pdPASS)
+  {
+    task = nullptr;
+  }
+}
+
+void logFlush(uint32_t timeoutMs)
+{
+  uint32_t start = millis();
+  while (true)
+  {
+    portENTER_CRITICAL(&lock);
+    bool empty = head == tail;
+    portEXIT_CRITICAL(&lock);
+    if (empty || millis() - start >= timeoutMs)
+    {
+      break;
+    }
+    if (task)
+    {
+      delay(1);
+    }
+    else
+    {
+      drain();
+    }
+  }
+  // the last characters are still in the UART FIFO
+  Serial.flush();
+}
+
+String logRetained()
+{
+  char *text = static_cast<char *>(malloc(LOG_RTC_SIZE + 1));
+  if (!text)
+  {
+    return String();
+  }
+
+  portENTER_CRITICAL(&lock);
+  uint32_t length = min(retained.head, static_cast<uint32_t>(LOG_RTC_SIZE));
+  uint32_t start = (retained.head - length) % LOG_RTC_SIZE;
+  uint32_t first = min<uint32_t>(length, LOG_RTC_SIZE - start);
+  memcpy(text, retained.data + start, first);
+  memcpy(text + first, retained.data, length - first);
+  bool wrapped = retained.head > LOG_RTC_SIZE;
+  portEXIT_CRITICAL(&lock);
+  text[length] = '\0';
+
+  // the oldest line was partly overwritten
+  const char *complete = text;
+  if (wrapped)
+  {
+    const char *newline = strchr(text, '\n');
+    complete = newline ? newline + 1 : text + length;
+  }
+  String log(complete);
+  free(text);
+  return log;
+}
+
+void logWrite(uint8_t level, const char *tag, const char *format, ...)
+{
+  char line[LOG_LINE_SIZE];
+  int prefix = snprintf(line, sizeof(line), "%6lu %c [%s] ", millis(), levelLetter(level), tag);
+  va_list args;
+  va_start(args, format);
+  // room for CR LF
+  int message = vsnprintf(line + prefix, sizeof(line) - prefix - 2, format, args);
+  va_end(args);
+  uint32_t length = prefix + min(max(message, 0), static_cast<int>(sizeof(line) - prefix - 3));
+  line[length++] = '\r';
+  line[length++] = '\n';
+
+  portENTER_CRITICAL(&lock);
+  copyToRing(retained.data, LOG_RTC_SIZE, retained.head, line, length);
+  retained.head += length;
+  logStats.lines++;
+  bool fits = head - tail + length <= LOG_BUFFER_SIZE;
+  if (fits)
+  {
+    copyToRing(buffer, LOG_BUFFER_SIZE, head, line, length);
+    head += length;
+    logStats.peakBytes = max(logStats.peakBytes, head - tail);
+  }
+  else
+  {
+    logStats.dropped++;
+  }
+  portEXIT_CRITICAL(&lock);
+
+  if (!task)
+  {
+    drain();
+  }
+  else if (fits)
+  {
+    xTaskNotifyGive(task);
+  }
+}
@@ -0,0 +1,82 @@
+#ifndef _LOG_H_
+#define _LOG_H_
+
+#include <Arduino.h>
+
+// Leveled logging that keeps the UART off the wake path.
+//
+// A line is formatted into a RAM ring where it is logged and a task on the other core writes the ring to Serial, so
+// the caller pays for the formatting but not for the 87 us every character takes at 115200 baud. The line also goes
+// into a ring in RTC memory that survives deep sleep and ESP.restart(), the configuration window serves it at /log.
+//
+// Levels above LOG_LEVEL are compiled out together with their arguments, set it with -DLOG_LEVEL=LOG_LEVEL_DEBUG.
+
+#define LOG_LEVEL_NONE 0
+#define LOG_LEVEL_ERROR 1
+#define LOG_LEVEL_WARN 2
+#define LOG_LEVEL_INFO 3
+#define LOG_LEVEL_DEBUG 4
+
+#ifndef LOG_LEVEL
+#define LOG_LEVEL LOG_LEVEL_INFO
+#endif
+
+// RAM ring between the wake and the UART task, lines that do not fit are dropped and counted
+#ifndef LOG_BUFFER_SIZE
+#define LOG_BUFFER_SIZE 4096
+#endif
+
+// RTC ring with the most recent lines, shares the 8 kB of RTC slow memory with the RTC_DATA_ATTR variables
+#ifndef LOG_RTC_SIZE
+#define LOG_RTC_SIZE 2048
+#endif
+
+// longer lines are cut short
+const size_t LOG_LINE_SIZE = 192;
+
+struct LogStats
+{
+  uint32_t lines = 0;
+  uint32_t dropped = 0;
+  // the most the RAM ring held at once
+  uint32_t peakBytes = 0;
+};
+
+extern LogStats logStats;
+
+// Starts the UART task, call after Serial.begin(). Without the task every line is written to Serial right away.
+void logInit();
+
+// Waits up to timeoutMs until everything logged so far is written to Serial, before deep sleep or a restart.
+void logFlush(uint32_t timeoutMs = 500);
+
+// The RTC ring from the oldest complete line to the newest, with the lines of the wakes before a restart or crash.
+String logRetained();
+
+void logWrite(uint8_t level, const char *tag, const char *format, ...) __attribute__((format(printf, 3, 4)));
+
+#if LOG_LEVEL >= LOG_LEVEL_ERROR
+#define LOG_ERROR(tag, ...) logWrite(LOG_LEVEL_ERROR, tag, __VA_ARGS__)
+#else
+#define LOG_ERROR(tag, ...) ((void)0)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_WARN
+#define LOG_WARN(tag, ...) logWrite(LOG_LEVEL_WARN, tag, __VA_ARGS__)
+#else
+#define LOG_WARN(tag, ...) ((void)0)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_INFO
+#define LOG_INFO(tag, ...) logWrite(LOG_LEVEL_INFO, tag, __VA_ARGS__)
+#else
+#define LOG_INFO(tag, ...) ((void)0)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_DEBUG
+#define LOG_DEBUG(tag, ...) logWrite(LOG_LEVEL_DEBUG, tag, __VA_ARGS__)
+#else
+#define LOG_DEBUG(tag, ...) ((void)0)
+#endif
+
+#endif
@@ -1,15 +1,16 @@
 #include <Arduino.h>
 
 #include "config.h"
+#include "deadline.h"
 
 extern "C"
 {
 #include "gfx.h"
+#include "ws75bepd_driver.h"
+#include "ws75bepd_png.h"
 }
 
 #include <cstring>
-#include <memory>
-#include <HTTPClient.h>
 #include <time.h>
 
 #include <WiFi.h>
@@ -27,14 +28,15 @@ extern "C"
 
 #include "SPIFFS.h"
 
-struct Config
-{
-  char imageUrl[64] = "";
-};
+#include "download.h"
+#include "image_format.h"
+#include "log.h"
+#include "metrics.h"
+#include "tiles.h"
+#include "tls_client.h"
+#include "wake_arena.h"
 
 const uint64_t uS_TO_S_FACTOR = 1000000;
-const uint64_t S_TO_H_FACTOR = 3600;
-const uint64_t H_TO_SLEEP = 1;
 
 const char *ntpServer0 = "0.pool.ntp.org";
 const char *ntpServer1 = "1.pool.ntp.org";
@@ -48,231 +50,757 @@ AsyncWebServer *server;
 
 Config config;
 
-std::unique_ptr<uint8_t[]> fetchImage(const String &url)
+RetryPolicy retryPolicy;
+
+// seconds until the image server expects new content, -1 if it did not say
+long refreshHint = -1;
+
+RTC_DATA_ATTR EnergyLedger energyLedger;
+// the panel shows the tiles of the last wake, so a wake where none of them changed needs no refresh
+RTC_DATA_ATTR bool tilesOnPanel = false;
+
+void sleep();
+
+// Returns false if WiFi did not connect, after a wake from deep sleep within the WiFi budget.
+bool connectToWifi(bool attended)
 {
-  HTTPClient https;
+  PhaseTimer timer(PHASE_WIFI);
+  server = new AsyncWebServer(80);
+  DNSServer dns;
+  AsyncWiFiManager wifiManager(server, &dns);
+  // wifiManager.resetSettings();
+  uint32_t remainingMs = deadlineRemainingMs(PHASE_WIFI);
+  if (attended)
+  {
+    // somebody may be there to enter the credentials, but not for longer than the configuration window stays open
+    wifiManager.setConfigPortalTimeout(config.portalMaxS);
+  }
+  else if (remainingMs != DEADLINE_NONE)
+  {
+    // nobody enters credentials after a wake from deep sleep, the portal would only keep the radio on
+    wifiManager.setConnectTimeout(max<uint32_t>(remainingMs / 1000, 1));
+    wifiManager.setConfigPortalTimeout(1);
+  }
+  bool connected = wifiManager.autoConnect("E-Paper Pictureframe");
+  delete server;
+  if (!connected)
+  {
+    LOG_ERROR("WIFI", "Could not connect");
+    deadlineCut(PHASE_WIFI);
+  }
+  return connected;
+}
 
-  Serial.println(url);
+WS75bEPDScaleMode panelScale(ScaleMode mode)
+{
+  switch (mode)
+  {
+  case SCALE_FILL:
+    return WS75bEPD_SCALE_FILL;
+  case SCALE_CENTER:
+    return WS75bEPD_SCALE_CENTER;
+  default:
+    return WS75bEPD_SCALE_FIT;
+  }
+}
 
-  if (!https.begin(url))
+const char *scaleModeName(ScaleMode mode)
+{
+  switch (mode)
   {
-    Serial.println(F("[HTTP] Can not establish connection to Server."));
-    throw std::logic_error("Can not establish HTTP connection!");
+  case SCALE_FIT:
+    return "fit";
+  case SCALE_FILL:
+    return "fill";
+  case SCALE_CENTER:
+    return "center";
+  default:
+    return "none";
   }
+}
 
-  int httpCode = https.GET();
-  Serial.print(F("[HTTP] GET... code: "));
-  Serial.println(httpCode);
+bool showImage(GDisplay *display, const Download &download, coord_t startX, coord_t startY, ScaleMode scaleMode)
+{
+  PhaseTimer timer(PHASE_DECODE);
+  ImageFormat format = detectImageFormat(download.data, download.total, download.contentType);
+  if (format == IMAGE_UNKNOWN)
+  {
+    LOG_ERROR("DECODE", "Unsupported image format, Content-Type: %s", download.contentType);
+    return false;
+  }
 
-  if (httpCode != HTTP_CODE_OK)
+  // a PNG that would not fit the workspace is turned down before anything is drawn, scaled ones too: their rows are as
+  // wide as the source, which may be wider than the panel
+  bool bounded = config.boundedPng && format == IMAGE_PNG;
+  if (bounded)
   {
-    Serial.print(F("[HTTP] GET... failed, error: "));
-    Serial.println(https.errorToString(httpCode));
-    https.end();
-    throw std::logic_error("HTTP Code not OK");
+    WS75bEPDPngInfo png;
+    WS75bEPDPngFit fit = ws75bepdPngCheck(download.data, download.total, &png);
+    if (fit != WS75bEPD_PNG_FITS)
+    {
+      LOG_ERROR("DECODE", "PNG %ux%u, depth %u, color type %u does not fit the %u byte workspace: %s, \"boundedPng\": "
+                "false decodes it in the arena", png.width, png.height, png.bitDepth, png.colorType,
+                WS75bEPD_PNG_WORKSPACE_BYTES, ws75bepdPngFitName(fit));
+      return false;
+    }
+    ws75bepdPngReset();
   }
 
-  int total = https.getSize();
-  int remaining = total;
+  // the decoders allocate on top of everything else, so the growth of the arena is their working set
+  size_t arenaBefore = wakeArenaUsed();
+  wakeArenaResetPeak();
+  uint32_t start = millis();
 
-  uint8_t buffer[128] = {0};
-  std::unique_ptr<uint8_t[]> destination{new uint8_t[total]};
-  int position = 0;
+  gdispImage image;
+  GFILE *imageData = gfileOpenMemory(download.data, "rb");
+  if (bounded)
+  {
+    ws75bepdPngEnter();
+  }
+  gdispImageError err = gdispImageOpenGFile(&image, imageData);
+  if (bounded)
+  {
+    ws75bepdPngLeave();
+  }
 
-  WiFiClient *stream = https.getStreamPtr();
+  if (err)
+  {
+    LOG_ERROR("DECODE", "Error opening Image: %X", err);
+    gfileClose(imageData);
+    return false;
+  }
 
-  while (https.connected() && (remaining > 0 || remaining == -1))
+  // render image, the driver scales it on the way to the dithering, see ws75bepd_scale.h
+  coord_t imageStartX = startX;
+  coord_t imageStartY = startY;
+  if (scaleMode != SCALE_NONE)
   {
-    size_t size = stream->available();
+    WS75bEPDScale scale = {image.width, image.height, panelScale(scaleMode)};
+    gdispGControl(display, WS75bEPD_CONTROL_SCALE, &scale);
+    imageStartX = imageStartY = 0;
+  }
 
-    if (size)
+  // the JPEG decoder draws MCU by MCU, error diffusion would start over at every block and lose its error
+  bool ordered = config.errorDiffusion && format == IMAGE_JPEG;
+  if (ordered)
+  {
+    LOG_INFO("DECODE", "JPEG is dithered ordered, error diffusion needs the rows in order");
+    gdispGControl(display, WS75bEPD_CONTROL_DITHER, (void *)WS75bEPD_DITHER_ORDERED);
+  }
+  // the decoder (and the scaler) stay on this core, the dithering and packing move to the other one
+  if (config.pipeline)
+  {
+    gdispGControl(display, WS75bEPD_CONTROL_PIPELINE, (void *)1);
+  }
+  if (bounded)
+  {
+    ws75bepdPngEnter();
+  }
+  err = gdispGImageDraw(display, &image, imageStartX, imageStartY, image.width, image.height, 0, 0);
+  if (bounded)
+  {
+    ws75bepdPngLeave();
+  }
+  if (config.pipeline)
+  {
+    gdispGControl(display, WS75bEPD_CONTROL_PIPELINE, 0);
+  }
+  if (ordered)
+  {
+    gdispGControl(display, WS75bEPD_CONTROL_DITHER, (void *)WS75bEPD_DITHER_DIFFUSION);
+  }
+  if (scaleMode != SCALE_NONE)
+  {
+    gdispGControl(display, WS75bEPD_CONTROL_SCALE, 0);
+  }
+  gdispImageClose(&image);
+  gfileClose(imageData);
+
+  if (bounded)
+  {
+    LOG_INFO("DECODE", "%s %dx%d: %lu ms, peak %u of %u workspace bytes", imageFormatName(format), image.width,
+             image.height, millis() - start, ws75bepdPngPeak(), WS75bEPD_PNG_WORKSPACE_BYTES);
+  }
+  else
+  {
+    LOG_INFO("DECODE", "%s %dx%d: %lu ms, peak %zu bytes", imageFormatName(format), image.width, image.height,
+             millis() - start, wakeArenaPeak() + wakeArenaOverflowPeak() - arenaBefore);
+  }
+  if (scaleMode != SCALE_NONE)
+  {
+    LOG_INFO("SCALE", "%s, %u rows peak, %u bytes, %u evictions", scaleModeName(scaleMode), ws75bepdLastScale.peakRows,
+             ws75bepdLastScale.bufferBytes, ws75bepdLastScale.evictions);
+  }
+  if (config.pipeline && ws75bepdLastPipeline.pixels)
+  {
+    // drawing inline would have taken the decoder's own time plus the dithering
+    const WS75bEPDPipelineStats &pipeline = ws75bepdLastPipeline;
+    uint32_t inlineUs = pipeline.elapsedUs - pipeline.producerWaitUs + pipeline.consumerUs;
+    LOG_INFO("PIPELINE", "%u ms, %u ms inline, speedup %.2fx, dithering %u ms, %u runs, decoder waited %ux, "
+             "dithering waited %ux", pipeline.elapsedUs / 1000, inlineUs / 1000, (float)inlineUs / pipeline.elapsedUs,
+             pipeline.consumerUs / 1000, pipeline.runs, pipeline.producerWaits, pipeline.consumerWaits);
+  }
+
+  if (err)
+  {
+    LOG_ERROR("DECODE", "Error drawing Image: %X", err);
+    return false;
+  }
+  return true;
+}
+
+// Checks everything about a download that can be checked without drawing it, before the panel is opened for it.
+// Frames unpack once against their CRCs, PNGs have the CRCs of their chunks checked and images have to fit the area
+// of width x height unscaled or the scaler when scaled.
+bool verifyImage(const Download &download, coord_t width, coord_t height, ScaleMode scaleMode)
+{
+  PhaseTimer timer(PHASE_DECODE);
+  uint32_t start = millis();
+  ImageFormat format = detectImageFormat(download.data, download.total, download.contentType);
+  if (format == IMAGE_FRAME)
+  {
+    WS75bEPDFrameHeader header;
+    if (!ws75bepdCheckFrame(download.data, download.total, &header))
     {
-      int count = stream->readBytes(buffer, (size > sizeof(buffer)) ? sizeof(buffer) : size);
-      if (position + count <= total)
-      {
-        std::memcpy(destination.get() + position, &buffer, count);
-      }
-      else
-      {
-        Serial.print(F("[HTTP] Got too much data for destination!"));
-        Serial.print(String("got ") + String(position + count - total) + " bytes too much\n");
-        throw std::out_of_range("Got too much data!");
-      }
-      position += count;
-      if (remaining > 0)
-      {
-        remaining -= count;
-      }
+      LOG_ERROR("VERIFY", "Invalid frame");
+      return false;
     }
-    delay(1);
+    LOG_INFO("VERIFY", "frame, %s %d bytes for %d: checked in %lu ms",
+             header.encoding == WS75bEPD_ENCODING_PACKBITS ? "packbits" : "raw", download.total, WS75bEPD_FRAME_BYTES,
+             millis() - start);
+    return true;
+  }
+  if (!config.verifyImages)
+  {
+    return true;
+  }
+
+  uint32_t imageWidth, imageHeight;
+  if (!imageSize(download.data, download.total, format, imageWidth, imageHeight))
+  {
+    LOG_ERROR("VERIFY", "%s without a readable header, %d bytes", imageFormatName(format), download.total);
+    return false;
+  }
+  if (format == IMAGE_PNG && !checkPngChunks(download.data, download.total))
+  {
+    LOG_ERROR("VERIFY", "PNG %ux%u damaged or cut off, %d bytes", imageWidth, imageHeight, download.total);
+    return false;
+  }
+  uint32_t maxWidth = scaleMode == SCALE_NONE ? width : WS75bEPD_SCALER_MAX_SIZE;
+  uint32_t maxHeight = scaleMode == SCALE_NONE ? height : WS75bEPD_SCALER_MAX_SIZE;
+  if (imageWidth == 0 || imageHeight == 0 || imageWidth > maxWidth || imageHeight > maxHeight)
+  {
+    LOG_ERROR("VERIFY", "%s %ux%u does not fit %ux%u", imageFormatName(format), imageWidth, imageHeight, maxWidth,
+              maxHeight);
+    return false;
   }
 
-  Serial.println(F("[HTTP] Finished Download"));
-  https.end();
-  return std::move(destination);
+  LOG_INFO("VERIFY", "%s %ux%u, %d bytes: checked in %lu ms", imageFormatName(format), imageWidth, imageHeight,
+           download.total, millis() - start);
+  return true;
 }
 
-bool connectToWifi()
+// Native frames are dithered and packed by the server already and go to the panel without the frame buffer.
+// verifyImage() has checked the frame, only its header is read again.
+bool showFrame(GDisplay *display, const Download &download)
 {
-  server = new AsyncWebServer(80);
-  DNSServer dns;
-  AsyncWiFiManager wifiManager(server, &dns);
-  // wifiManager.resetSettings();
-  wifiManager.autoConnect("E-Paper Pictureframe");
-  delete server;
+  WS75bEPDFrameHeader header;
+  if (!ws75bepdReadFrameHeader(download.data, download.total, &header))
+  {
+    LOG_ERROR("DECODE", "Invalid frame");
+    return false;
+  }
+
+  PhaseTimer timer(PHASE_FLUSH);
+  ws75bepdFlushFrame(display, download.data + WS75bEPD_FRAME_HEADER_SIZE, &header);
   return true;
 }
 
-void showImage(void *data, coord_t startX, coord_t startY)
+void sampleBattery()
 {
-  gdispImage image;
-  GFILE *imageData = gfileOpenMemory(data, "rb");
-  gdispImageError err = gdispImageOpenGFile(&image, imageData);
-
-  if (err)
+  if (config.batteryPin < 0)
   {
-    Serial.println("Error opening Image");
-    Serial.println(err, HEX);
-    gfileClose(imageData);
-    ESP.restart();
     return;
   }
 
-  // render image
-  coord_t imageStartX = startX;
-  coord_t imageStartY = startY;
+  uint32_t milliVolts = 0;
+  for (int i = 0; i < 8; ++i)
+  {
+    milliVolts += analogReadMilliVolts(config.batteryPin);
+  }
+  energyLedger.batteryMv = milliVolts / 8 * config.batteryDividerRatio;
+}
 
-  gdispImageDraw(&image, imageStartX, imageStartY, image.width, image.height, 0, 0);
-  gdispImageClose(&image);
-  gfileClose(imageData);
+// Lets the image server track the battery state of the fleet.
+RequestHeaders energyHeaders()
+{
+  RequestHeaders headers;
+  if (energyLedger.batteryMv > 0)
+  {
+    headers.add("X-Battery-mV", String(energyLedger.batteryMv));
+  }
+  headers.add("X-Wake-Count", String(energyLedger.wakes));
+  headers.add("X-Energy-Wake-mAh", String(energyLedger.lastWakeMah, 3));
+  headers.add("X-Energy-Sleep-mAh", String(energyLedger.lastSleepMah, 3));
+  headers.add("X-Energy-Total-mAh", String(energyLedger.consumedMah, 1));
+  headers.add("X-Projected-Runtime-h", String(projectedRuntimeHours(energyLedger, config.energy), 0));
+  return headers;
 }
 
-void loadImage(const String &url, std::unique_ptr<uint8_t[]> &image)
+bool loadImage(const String &url, Download &image, const RequestHeaders &headers)
 {
-  Serial.println("fetch image");
-  try
+  PhaseTimer timer(PHASE_DOWNLOAD);
+  LOG_DEBUG("HTTP", "fetch image");
+  bool loaded = downloadWithRetry(url, image, retryPolicy, headers);
+
+  LOG_INFO("HTTP", "retries: %u, resumed bytes: %u (total retries: %u, total resumed bytes: %u)",
+           downloadStatsThisWake.retries, downloadStatsThisWake.resumedBytes, downloadStats.retries,
+           downloadStats.resumedBytes);
+  if (tlsStatsThisWake.handshakes > 0)
   {
-    image = fetchImage(url);
+    LOG_INFO("TLS", "handshakes: %u, resumed: %u, %u ms (total handshakes: %u, total resumed: %u, total %u ms)",
+             tlsStatsThisWake.handshakes, tlsStatsThisWake.resumed, tlsStatsThisWake.handshakeMs, tlsStats.handshakes,
+             tlsStats.resumed, tlsStats.handshakeMs);
   }
-  catch (const std::logic_error &e)
+  return loaded;
+}
+
+WS75bEPDRefresh panelRefresh(RefreshMode mode)
+{
+  switch (mode)
   {
-    Serial.println(F("Could not fetch image"));
-    Serial.println(e.what());
-    ESP.restart();
+  case REFRESH_FAST:
+    return WS75bEPD_REFRESH_FAST;
+  case REFRESH_AUTO:
+    return WS75bEPD_REFRESH_AUTO;
+  default:
+    return WS75bEPD_REFRESH_FULL;
   }
 }
 
-void draw()
+// panels whose refresh was started and not waited for yet, and with which waveform
+bool refreshing[MAX_PANELS];
+WS75bEPDRefresh refreshModes[MAX_PANELS];
+// the CPU waited this long for BUSY, the panels refreshed for longer
+uint32_t refreshWaitMs = 0;
+
+// Waits until the panels are done with the refreshes started so far, those started first are mostly done by now.
+void finishRefreshes()
+{
+  PhaseTimer timer(PHASE_FLUSH);
+  uint32_t start = millis();
+  for (int i = 0; i < config.panelCount; i++)
+  {
+    if (!refreshing[i])
+    {
+      continue;
+    }
+    ws75bepdFinishRefresh(gdispGetDisplay(i));
+    refreshing[i] = false;
+    LOG_INFO("REFRESH", "panel %d %s, busy %u ms", i, refreshModes[i] == WS75bEPD_REFRESH_FAST ? "fast" : "full",
+             ws75bepdRefreshBusyMs);
+  }
+  refreshWaitMs += millis() - start;
+}
+
+// Called once the data of a panel is sent, the refresh runs on while the next panel gets its data.
+void refreshStarted(int panel)
 {
-  std::unique_ptr<uint8_t[]> image;
-  loadImage(config.imageUrl, image);
+  refreshing[panel] = true;
+  refreshModes[panel] = ws75bepdLastRefresh;
+  if (!config.overlapRefresh)
+  {
+    finishRefreshes();
+  }
+}
 
-  Serial.println("start drawing");
+// Gives the panels beyond the first one their pins before gfxInit() starts the displays.
+void configurePanels()
+{
+  for (int i = 1; i < config.panelCount; i++)
+  {
+    const PanelConfig &panel = config.panels[i];
+    WS75bEPDPins pins = ws75bepdDefaultPins;
+    pins.cs = panel.cs;
+    pins.busy = panel.busy;
+    pins.rst = panel.rst;
+    ws75bepdSetPins(i, &pins);
+  }
+}
+
+// The display of a panel with the settings of the configuration.
+GDisplay *openPanel(int panel)
+{
   gfxInit();
-  GDisplay *display = gdispGetDisplay(0);
-  gdispSetOrientation(GDISP_ROTATE_180);
-  auto text = ":D";
-  font_t font = gdispOpenFont("DejaVuSans20");
-  gdispGDrawString(display, 100, 100, text, font, GFX_BLACK);
-  gdispCloseFont(font);
+  GDisplay *display = gdispGetDisplay(panel);
+  gdispGControl(display, WS75bEPD_CONTROL_REFRESH, (void *)panelRefresh(config.refresh));
+  // flushes only start the refresh, finishRefreshes() waits for it
+  gdispGControl(display, WS75bEPD_CONTROL_OVERLAP, (void *)1);
+  gdispGSetOrientation(display, GDISP_ROTATE_180);
+  if (config.errorDiffusion)
+  {
+    gdispGControl(display, WS75bEPD_CONTROL_DITHER, (void *)WS75bEPD_DITHER_DIFFUSION);
+  }
+  return display;
+}
 
-  showImage(static_cast<void *>(image.get()), 0, 0);
-  gdispGFlush(display);
+// Cancellation point between panels and tiles, a refresh that was started runs to its end anyway.
+bool outOfTime()
+{
+  return deadlineCutShort() || deadlinePassed(PHASE_DOWNLOAD) || deadlinePassed(PHASE_DECODE) ||
+         deadlinePassed(PHASE_FLUSH);
+}
 
-  Serial.println("end");
+// Fetches the tile unless the cached copy is current and draws it. Returns true if it was downloaded and decoded.
+bool drawTile(GDisplay *display, int index, const Tile &tile)
+{
+  char etag[sizeof(Download::etag)];
+  bool cached = cachedTileEtag(index, tile, etag, sizeof(etag));
+  RequestHeaders headers = energyHeaders();
+  if (cached)
+  {
+    headers.add("If-None-Match", etag);
+  }
+
+  Download download;
+  bool loaded = loadImage(tile.url, download, headers);
+  if (loaded && download.notModified)
+  {
+    if (drawCachedTile(display, index, tile))
+    {
+      LOG_INFO("TILE", "%d not modified, drawn from cache", index);
+      return false;
+    }
+    // the cache went bad, without its ETag the server sends the tile again
+    dropCachedTile(index);
+    loaded = loadImage(tile.url, download, energyHeaders());
+  }
+  if (download.refreshHint > 0 && (refreshHint < 0 || download.refreshHint < refreshHint))
+  {
+    refreshHint = download.refreshHint;
+  }
+
+  if (!loaded || !verifyImage(download, tile.width, tile.height, SCALE_NONE))
+  {
+    wakeArenaFree(download.data);
+    // an old tile is better than none
+    bool stale = cached && drawCachedTile(display, index, tile);
+    LOG_WARN("TILE", "%d %s%s", index, loaded ? "rejected" : "failed", stale ? ", drawn from cache" : "");
+    return false;
+  }
+
+  gdispGFillArea(display, tile.x, tile.y, tile.width, tile.height, GFX_WHITE);
+  gdispGSetClip(display, tile.x, tile.y, tile.width, tile.height);
+  bool drawn = showImage(display, download, tile.x, tile.y, SCALE_NONE);
+  gdispGSetClip(display, 0, 0, gdispGGetWidth(display), gdispGGetHeight(display));
+  wakeArenaFree(download.data);
+
+  if (!drawn)
+  {
+    // the old tile replaces what the decoder got to, without it the tile stays blank
+    bool stale = cached && drawCachedTile(display, index, tile);
+    if (!stale)
+    {
+      gdispGFillArea(display, tile.x, tile.y, tile.width, tile.height, GFX_WHITE);
+    }
+    dropCachedTile(index);
+    LOG_WARN("TILE", "%d could not be decoded%s", index, stale ? ", drawn from cache" : "");
+    return false;
+  }
+
+  bool stored = storeTile(display, index, tile, download.etag);
+  if (!stored)
+  {
+    dropCachedTile(index);
+  }
+  LOG_INFO("TILE", "%d decoded%s", index, stored ? ", cached" : "");
+  return true;
 }
 
-void updateTime()
+void drawTiles()
 {
+  LOG_DEBUG("DRAW", "start drawing tiles");
+  GDisplay *display = openPanel(0);
+  // the configuration window leaves its address in the frame buffer, outside the tiles it would stay on the panel
+  gdispGClear(display, GFX_WHITE);
+  // the frame buffer outlives the tiles, so it has to be there before the first mark
+  if (!ws75bepdFrame(display))
+  {
+    LOG_ERROR("TILES", "no memory for the frame buffer");
+    tilesOnPanel = false;
+    return;
+  }
+
+  int changed = 0;
+  for (int i = 0; i < config.layout.tileCount; i++)
+  {
+    if (outOfTime())
+    {
+      // the tiles that are not drawn would be blank, the panel keeps the last layout until the next slot
+      LOG_WARN("TILES", "%d of %d drawn, no refresh", i, config.layout.tileCount);
+      tilesOnPanel = false;
+      return;
+    }
+    // the arena only reclaims its last block, the download and the cache buffers of a tile sit below the decoder's
+    WakeArenaMark mark = wakeArenaMark();
+    if (drawTile(display, i, config.layout.tiles[i]))
+    {
+      changed++;
+    }
+    wakeArenaReset(mark);
+  }
+
+  LOG_INFO("TILES", "%d of %d changed", changed, config.layout.tileCount);
+  if (changed == 0 && tilesOnPanel)
+  {
+    LOG_INFO("TILES", "panel is up to date, no refresh");
+    return;
+  }
+
+  {
+    PhaseTimer timer(PHASE_FLUSH);
+    gdispGFlush(display);
+  }
+  if (ws75bepdFlushRefused)
+  {
+    LOG_ERROR("TILES", "frame buffer lost, no refresh");
+    tilesOnPanel = false;
+    return;
+  }
+  tilesOnPanel = true;
+  refreshStarted(0);
+  LOG_DEBUG("DRAW", "end");
+}
+
+// Fetches the image of a panel and starts its refresh. The panel keeps its image if that fails.
+bool drawPanel(int panel, const char *url)
+{
+  // the frame buffer goes to the start of the arena, before the download can take the room. Opening the panel does not
+  // power it, that waits for the flush.
+  GDisplay *display = openPanel(panel);
+  if (!ws75bepdFrame(display))
+  {
+    // every pixel drawn would be dropped and the refresh would show a blank panel
+    LOG_ERROR("DRAW", "no memory for the frame buffer of panel %d", panel);
+    return false;
+  }
+
+  Download image;
+  if (!loadImage(url, image, energyHeaders()))
+  {
+    return false;
+  }
+  if (image.refreshHint > 0 && (refreshHint < 0 || image.refreshHint < refreshHint))
+  {
+    refreshHint = image.refreshHint;
+  }
+  // a broken download leaves the panel unpowered and keeps its image
+  if (!verifyImage(image, GDISP_SCREEN_WIDTH, GDISP_SCREEN_HEIGHT, config.scale))
+  {
+    wakeArenaFree(image.data);
+    return false;
+  }
+
+  LOG_DEBUG("DRAW", "start drawing panel %d", panel);
+  bool shown;
+  if (detectImageFormat(image.data, image.total, image.contentType) == IMAGE_FRAME)
+  {
+    shown = showFrame(display, image);
+  }
+  else
+  {
+    // the configuration window leaves its address in the frame buffer
+    gdispGClear(display, GFX_WHITE);
+    auto text = ":D";
+    font_t font = gdispOpenFont("DejaVuSans20");
+    gdispGDrawString(display, 100, 100, text, font, GFX_BLACK);
+    gdispCloseFont(font);
+
+    shown = showImage(display, image, 0, 0, config.scale);
+    if (shown)
+    {
+      PhaseTimer timer(PHASE_FLUSH);
+      gdispGFlush(display);
+    }
+    if (shown && ws75bepdFlushRefused)
+    {
+      LOG_ERROR("DRAW", "frame buffer of panel %d lost, no refresh", panel);
+      shown = false;
+    }
+  }
+  wakeArenaFree(image.data);
+
+  if (shown)
+  {
+    refreshStarted(panel);
+  }
+  LOG_DEBUG("DRAW", "end");
+  return shown;
+}
+
+// Panel after panel, each one refreshes while the next is fetched, decoded and sent.
+void draw()
+{
+  recordHeapAtDraw();
+  // a panel that failed is tried again in the next slot instead of paying for a reboot, WiFi connection and NTP sync
+  if (config.layout.tileCount > 0)
+  {
+    drawTiles();
+  }
+  else if (!outOfTime())
+  {
+    tilesOnPanel = false;
+    drawPanel(0, config.imageUrl);
+  }
+  for (int i = 1; i < config.panelCount && !outOfTime(); i++)
+  {
+    drawPanel(i, config.panels[i].imageUrl);
+  }
+  finishRefreshes();
+}
+
+// Returns false if the clock is not set within the time budget.
+bool updateTime()
+{
+  PhaseTimer timer(PHASE_TIME);
   configTime(gmtOffset_sec, daylightOffset_sec, ntpServer0, ntpServer1, ntpServer2);
   sntp_sync_time(NULL);
+
+  // the RTC keeps the time through deep sleep, only the first wake after power on waits for the answer
+  uint32_t remainingMs = deadlineRemainingMs(PHASE_TIME);
+  struct tm timeinfo;
+  if (!getLocalTime(&timeinfo, remainingMs == DEADLINE_NONE ? 5000 : remainingMs))
+  {
+    LOG_ERROR("TIME", "Failed to obtain time");
+    deadlineCut(PHASE_TIME);
+    return false;
+  }
+  return true;
 }
 
 uint64_t getSleepTime()
 {
   struct tm timeinfo;
-  if (!getLocalTime(&timeinfo))
+  // a wake cut short does not wait for NTP any longer
+  if (!getLocalTime(&timeinfo, deadlineCutShort() ? 0 : 5000))
   {
-    Serial.println("Failed to obtain time");
-    ESP.restart();
+    // a restart would bring the radio up again right away, a short sleep costs far less
+    LOG_ERROR("TIME", "Failed to obtain time");
+    LOG_INFO("SLEEP", "no slot without the time, trying again in %u s", config.budget.retryS);
+    return static_cast<uint64_t>(config.budget.retryS) * uS_TO_S_FACTOR;
   }
-  Serial.println(&timeinfo, "%A, %B %d %Y %H:%M:%S");
-  uint64_t hours = timeinfo.tm_hour;
-  uint64_t minutes = timeinfo.tm_min;
-  uint64_t seconds = timeinfo.tm_sec;
-  Serial.println(hours);
-  Serial.println(minutes);
-  Serial.println(seconds);
+  char text[48];
+  strftime(text, sizeof(text), "%A, %B %d %Y %H:%M:%S", &timeinfo);
+  LOG_INFO("TIME", "%s", text);
 
-  auto time_us = ((/*hours * 60ull + */ minutes % 5ull) * 60ull + seconds) * 1000000ull;
-  auto sleepTime = (/*24ull * */ 5ull * 60ull * 1000000ull) - time_us;
+  time_t now = mktime(&timeinfo);
+  time_t notBefore = refreshHint > 0 ? now + refreshHint : now;
+  time_t wake = nextWake(config.schedule, now, notBefore);
+  if (wake == 0)
+  {
+    LOG_WARN("SCHEDULE", "No slot within the next days, checking again in a day");
+    wake = now + 24 * 60 * 60;
+  }
 
-  Serial.println(time_us);
-  Serial.println(sleepTime);
+  struct tm wakeinfo;
+  localtime_r(&wake, &wakeinfo);
+  strftime(text, sizeof(text), "%A, %B %d %Y %H:%M:%S", &wakeinfo);
+  LOG_INFO("SCHEDULE", "next wake: %s", text);
 
-  Serial.print("going to sleep for ");
-  Serial.println(sleepTime);
+  uint64_t sleepTime = static_cast<uint64_t>(wake - now) * uS_TO_S_FACTOR;
+  LOG_INFO("SLEEP", "going to sleep for %llu us", static_cast<unsigned long long>(sleepTime));
   return sleepTime;
 }
 
-void print_reset_reason(RESET_REASON reason)
+const char *resetReasonName(RESET_REASON reason)
 {
   switch (reason)
   {
   case 1:
-    Serial.println("POWERON_RESET");
-    break; /**<1,  Vbat power on reset*/
+    return "POWERON_RESET"; /**<1,  Vbat power on reset*/
   case 3:
-    Serial.println("SW_RESET");
-    break; /**<3,  Software reset digital core*/
+    return "SW_RESET"; /**<3,  Software reset digital core*/
   case 4:
-    Serial.println("OWDT_RESET");
-    break; /**<4,  Legacy watch dog reset digital core*/
+    return "OWDT_RESET"; /**<4,  Legacy watch dog reset digital core*/
   case 5:
-    Serial.println("DEEPSLEEP_RESET");
-    break; /**<5,  Deep Sleep reset digital core*/
+    return "DEEPSLEEP_RESET"; /**<5,  Deep Sleep reset digital core*/
   case 6:
-    Serial.println("SDIO_RESET");
-    break; /**<6,  Reset by SLC module, reset digital core*/
+    return "SDIO_RESET"; /**<6,  Reset by SLC module, reset digital core*/
   case 7:
-    Serial.println("TG0WDT_SYS_RESET");
-    break; /**<7,  Timer Group0 Watch dog reset digital core*/
+    return "TG0WDT_SYS_RESET"; /**<7,  Timer Group0 Watch dog reset digital core*/
   case 8:
-    Serial.println("TG1WDT_SYS_RESET");
-    break; /**<8,  Timer Group1 Watch dog reset digital core*/
+    return "TG1WDT_SYS_RESET"; /**<8,  Timer Group1 Watch dog reset digital core*/
   case 9:
-    Serial.println("RTCWDT_SYS_RESET");
-    break; /**<9,  RTC Watch dog Reset digital core*/
+    return "RTCWDT_SYS_RESET"; /**<9,  RTC Watch dog Reset digital core*/
   case 10:
-    Serial.println("INTRUSION_RESET");
-    break; /**<10, Instrusion tested to reset CPU*/
+    return "INTRUSION_RESET"; /**<10, Instrusion tested to reset CPU*/
   case 11:
-    Serial.println("TGWDT_CPU_RESET");
-    break; /**<11, Time Group reset CPU*/
+    return "TGWDT_CPU_RESET"; /**<11, Time Group reset CPU*/
   case 12:
-    Serial.println("SW_CPU_RESET");
-    break; /**<12, Software reset CPU*/
+    return "SW_CPU_RESET"; /**<12, Software reset CPU*/
   case 13:
-    Serial.println("RTCWDT_CPU_RESET");
-    break; /**<13, RTC Watch dog Reset CPU*/
+    return "RTCWDT_CPU_RESET"; /**<13, RTC Watch dog Reset CPU*/
   case 14:
-    Serial.println("EXT_CPU_RESET");
-    break; /**<14, for APP CPU, reseted by PRO CPU*/
+    return "EXT_CPU_RESET"; /**<14, for APP CPU, reseted by PRO CPU*/
   case 15:
-    Serial.println("RTCWDT_BROWN_OUT_RESET");
-    break; /**<15, Reset when the vdd voltage is not stable*/
+    return "RTCWDT_BROWN_OUT_RESET"; /**<15, Reset when the vdd voltage is not stable*/
   case 16:
-    Serial.println("RTCWDT_RTC_RESET");
-    break; /**<16, RTC Watch dog reset digital core and rtc module*/
+    return "RTCWDT_RTC_RESET"; /**<16, RTC Watch dog reset digital core and rtc module*/
   default:
-    Serial.println("NO_MEAN");
+    return "NO_MEAN";
   }
 }
 
+void releaseArena()
+{
+  LOG_INFO("ARENA", "peak %zu of %zu bytes in %s, peak overflow to heap %zu, %u overflows refused", wakeArenaPeak(),
+           wakeArenaCapacity(), wakeArenaInPsram() ? "PSRAM" : "internal RAM", wakeArenaOverflowPeak(),
+           wakeArenaOverflowRefused());
+  wakeArenaRelease();
+}
+
+PhaseTrace buildPhaseTrace()
+{
+  const uint32_t *phases = phaseMetrics.durationMs;
+  PhaseTrace trace;
+  trace.stateMs[POWER_RADIO] = phases[PHASE_WIFI] + phases[PHASE_TIME] + phases[PHASE_DOWNLOAD];
+  trace.stateMs[POWER_PANEL_BUSY] = min(refreshWaitMs, phases[PHASE_FLUSH]);
+  trace.stateMs[POWER_SPI] = phases[PHASE_FLUSH] - trace.stateMs[POWER_PANEL_BUSY];
+
+  // everything not covered by a phase counts as CPU time
+  uint32_t covered = 0;
+  for (int phase = 0; phase < PHASE_COUNT; ++phase)
+  {
+    covered += phases[phase];
+  }
+  uint32_t now = millis();
+  // the radio is in modem sleep for most of the configuration window
+  trace.stateMs[POWER_CPU] = phases[PHASE_CONFIG] + phases[PHASE_DECODE] + phases[PHASE_PORTAL] +
+                             (now > covered ? now - covered : 0);
+  return trace;
+}
+
+void recordEnergy(uint64_t sleepTime)
+{
+  PhaseTrace trace = buildPhaseTrace();
+  recordWake(energyLedger, config.energy, trace, sleepTime / uS_TO_S_FACTOR);
+
+  for (int state = 0; state < POWER_STATE_COUNT; ++state)
+  {
+    LOG_DEBUG("ENERGY", "%s: %u ms", powerStateName(static_cast<PowerState>(state)), trace.stateMs[state]);
+  }
+  LOG_INFO("ENERGY", "wake %.3f mAh, sleep %.3f mAh, total %.1f mAh, projected runtime %.0f h", energyLedger.lastWakeMah,
+           energyLedger.lastSleepMah, energyLedger.consumedMah, projectedRuntimeHours(energyLedger, config.energy));
+}
+
 void sleep()
 {
+  printPhaseMetrics();
+  releaseArena();
   auto sleepTime = getSleepTime();
+  recordEnergy(sleepTime);
   esp_sleep_enable_timer_wakeup(sleepTime);
+  logFlush();
   esp_deep_sleep_start();
 }
 
@@ -292,30 +820,247 @@ String readFile(const char *fileName)
 {
   if (!SPIFFS.begin(true))
   {
-    Serial.println("An Error has occurred while mounting SPIFFS");
+    LOG_ERROR("SPIFFS", "An Error has occurred while mounting SPIFFS");
     return "An Error has occurred while mounting SPIFFS";
   }
 
   File file = SPIFFS.open(fileName);
   if (!file)
   {
-    Serial.println("Failed to open file for reading");
+    LOG_ERROR("SPIFFS", "Failed to open %s for reading", fileName);
     return "Failed to open file for reading";
   }
 
-  Serial.println("File Content:");
   auto content = file.readString();
-  Serial.println(content);
+  LOG_DEBUG("SPIFFS", "%s: %u bytes", fileName, content.length());
   file.close();
   return content;
 }
 
+// Given by every request of the configuration window, the window waits on it.
+SemaphoreHandle_t portalActivity;
+volatile uint32_t lastPortalActivity;
+
+// Added before all other handlers, it sees every request and leaves the handling to them.
+class ActivityHandler : public AsyncWebHandler
+{
+public:
+  bool canHandle(AsyncWebServerRequest *request) override
+  {
+    lastPortalActivity = millis();
+    xSemaphoreGive(portalActivity);
+    return false;
+  }
+};
+
+// Serves the config page and OTA updates until nobody used them for config.portalIdleS.
+void runConfigWindow()
+{
+  PhaseTimer timer(PHASE_PORTAL);
+  // 80 MHz is the lowest clock WiFi works with, modem sleep turns the radio off between beacons
+  uint32_t cpuMhz = getCpuFrequencyMhz();
+  setCpuFrequencyMhz(80);
+  WiFi.setSleep(true);
+
+  portalActivity = xSemaphoreCreateBinary();
+  server = new AsyncWebServer(80);
+  server->addHandler(new ActivityHandler());
+  server->on("/", HTTP_GET, [](AsyncWebServerRequest *request) {
+    request->send(200, "text/html", readFile("/index.html"));
+  });
+  // the last lines of the wakes before, from RTC memory
+  server->on("/log", HTTP_GET, [](AsyncWebServerRequest *request) {
+    request->send(200, "text/plain", logRetained());
+  });
+
+  AsyncElegantOTA.begin(server); // Start ElegantOTA
+  server->begin();
+
+  showIp();
+
+  uint32_t start = millis();
+  uint32_t requests = 0;
+  lastPortalActivity = start;
+  while (true)
+  {
+    uint32_t lastActivity = lastPortalActivity;
+    uint32_t now = millis();
+    if (now - lastActivity >= config.portalIdleS * 1000UL || now - start >= config.portalMaxS * 1000UL)
+    {
+      break;
+    }
+    // blocked here the core idles until a request comes in, AsyncElegantOTA restarts after an update in loop()
+    if (xSemaphoreTake(portalActivity, pdMS_TO_TICKS(1000)) == pdTRUE)
+    {
+      requests++;
+    }
+    AsyncElegantOTA.loop();
+  }
+
+  server->end();
+  delete server;
+  server = nullptr;
+  vSemaphoreDelete(portalActivity);
+  setCpuFrequencyMhz(cpuMhz);
+
+  LOG_INFO("PORTAL", "closed after %lu s, %u requests", (millis() - start) / 1000, requests);
+}
+
+int loadSlots(JsonArrayConst slots, CronSlot *destination)
+{
+  int count = 0;
+  for (const char *expression : slots)
+  {
+    if (count == MAX_SCHEDULE_SLOTS)
+    {
+      LOG_WARN("CONFIG", "Too many schedule slots, ignoring the rest");
+      break;
+    }
+    if (!expression || !parseCronSlot(expression, destination[count]))
+    {
+      LOG_WARN("CONFIG", "Invalid schedule slot: %s", expression ? expression : "null");
+      continue;
+    }
+    count++;
+  }
+  return count;
+}
+
+void loadSchedule(JsonObjectConst json, Schedule &schedule)
+{
+  schedule.slotCount = loadSlots(json["slots"], schedule.slots);
+  schedule.weekendSlotCount = loadSlots(json["weekendSlots"], schedule.weekendSlots);
+
+  JsonObjectConst quietHours = json["quietHours"];
+  if (!quietHours.isNull())
+  {
+    schedule.quietFrom = parseTimeOfDay(quietHours["from"] | "");
+    schedule.quietTo = parseTimeOfDay(quietHours["to"] | "");
+    if (schedule.quietFrom < 0 || schedule.quietTo < 0)
+    {
+      LOG_WARN("CONFIG", "Invalid quiet hours, ignoring them");
+      schedule.quietFrom = schedule.quietTo = -1;
+    }
+  }
+}
+
+void loadEnergyProfile(JsonObjectConst json, Config &config)
+{
+  static const char *currentKeys[POWER_STATE_COUNT] = {"radioMa", "cpuMa", "spiMa", "panelBusyMa", "sleepMa"};
+
+  EnergyProfile &profile = config.energy;
+  for (int state = 0; state < POWER_STATE_COUNT; ++state)
+  {
+    profile.currentMa[state] = json[currentKeys[state]] | profile.currentMa[state];
+  }
+  profile.batteryCapacityMah = json["batteryMah"] | profile.batteryCapacityMah;
+  config.batteryPin = json["batteryPin"] | config.batteryPin;
+  config.batteryDividerRatio = json["batteryDivider"] | config.batteryDividerRatio;
+}
+
+// Seconds in config.json, the phases by the names of metrics.cpp.
+void loadBudget(JsonObjectConst json, WakeBudget &budget)
+{
+  budget.wakeMs = (json["wakeSeconds"] | budget.wakeMs / 1000) * 1000;
+  budget.retryS = json["retrySeconds"] | budget.retryS;
+  JsonObjectConst phases = json["phaseSeconds"];
+  for (int phase = 0; phase < PHASE_COUNT; ++phase)
+  {
+    const char *name = phaseName(static_cast<Phase>(phase));
+    budget.phaseMs[phase] = (phases[name] | budget.phaseMs[phase] / 1000) * 1000;
+  }
+}
+
+void loadLayout(JsonObjectConst json, Layout &layout)
+{
+  layout.tileCount = 0;
+  for (JsonObjectConst entry : json["tiles"].as<JsonArrayConst>())
+  {
+    if (layout.tileCount == MAX_TILES)
+    {
+      LOG_WARN("CONFIG", "Too many tiles, ignoring the rest");
+      break;
+    }
+    Tile &tile = layout.tiles[layout.tileCount];
+    strlcpy(tile.url, entry["url"] | "", sizeof(tile.url));
+    tile.x = entry["x"] | 0;
+    tile.y = entry["y"] | 0;
+    tile.width = entry["width"] | 0;
+    tile.height = entry["height"] | 0;
+    // the display is rotated by 180 degrees, so the panel is landscape
+    if (!tile.url[0] || tile.x < 0 || tile.y < 0 || tile.width <= 0 || tile.height <= 0 ||
+        tile.x + tile.width > GDISP_SCREEN_WIDTH || tile.y + tile.height > GDISP_SCREEN_HEIGHT)
+    {
+      LOG_WARN("CONFIG", "Invalid tile %s", tile.url);
+      continue;
+    }
+    layout.tileCount++;
+  }
+}
+
+// The panels beyond the first one, on the connectors of their own CS, BUSY and RST pins.
+void loadPanels(JsonArrayConst json, Config &config)
+{
+  config.panelCount = 1;
+  for (JsonObjectConst entry : json)
+  {
+    if (config.panelCount == MAX_PANELS)
+    {
+      LOG_WARN("CONFIG", "Too many panels for a build with WS75bEPD_PANELS=%d, ignoring the rest", MAX_PANELS);
+      break;
+    }
+    PanelConfig &panel = config.panels[config.panelCount];
+    strlcpy(panel.imageUrl, entry["imageUrl"] | "", sizeof(panel.imageUrl));
+    panel.cs = entry["cs"] | -1;
+    panel.busy = entry["busy"] | -1;
+    panel.rst = entry["rst"] | -1;
+    if (!panel.imageUrl[0] || panel.cs < 0 || panel.busy < 0 || panel.rst < 0)
+    {
+      LOG_WARN("CONFIG", "Invalid panel %s", panel.imageUrl);
+      continue;
+    }
+    config.panelCount++;
+  }
+}
+
+// the CA certificates have to outlive every connection of the wake
+String caCertificates;
+
+void loadTlsSettings(JsonObjectConst json, TlsSettings &settings)
+{
+  settings.resume = json["resume"] | true;
+
+  const char *fingerprint = json["fingerprint"] | "";
+  settings.pinned = strlen(fingerprint) == 2 * sizeof(settings.fingerprint);
+  for (size_t i = 0; settings.pinned && i < sizeof(settings.fingerprint); i++)
+  {
+    unsigned int byte;
+    settings.pinned = sscanf(fingerprint + 2 * i, "%2x", &byte) == 1;
+    settings.fingerprint[i] = byte;
+  }
+  if (fingerprint[0] && !settings.pinned)
+  {
+    LOG_WARN("CONFIG", "Invalid TLS fingerprint, expected the SHA-256 of the certificate in hex");
+  }
+
+  const char *caFile = json["caFile"] | "";
+  settings.caCert = nullptr;
+  if (caFile[0] && SPIFFS.exists(caFile))
+  {
+    File file = SPIFFS.open(caFile);
+    caCertificates = file.readString();
+    file.close();
+    settings.caCert = caCertificates.c_str();
+  }
+}
+
 void loadConfiguration(const char *fileName, Config &config)
 {
+  PhaseTimer timer(PHASE_CONFIG);
 
   if (!SPIFFS.begin(true))
   {
-    Serial.println("An Error has occurred while mounting SPIFFS");
+    LOG_ERROR("SPIFFS", "An Error has occurred while mounting SPIFFS");
     return;
   }
   // Open file for reading
@@ -324,18 +1069,42 @@ void loadConfiguration(const char *fileName, Config &config)
   // Allocate a temporary JsonDocument
   // Don't forget to change the capacity to match your requirements.
   // Use arduinojson.org/v6/assistant to compute the capacity.
-  StaticJsonDocument<512> doc;
+  StaticJsonDocument<3072> doc;
 
   // Deserialize the JSON document
   DeserializationError error = deserializeJson(doc, file);
   if (error)
-    Serial.println(F("Failed to read file, using default configuration"));
+    LOG_WARN("CONFIG", "Failed to read file, using default configuration");
 
   // Copy values from the JsonDocument to the Config
   strlcpy(config.imageUrl,                 // <- destination
           doc["imageUrl"] | "example.com", // <- source
           sizeof(config.imageUrl));        // <- destination's capacity
 
+  config.errorDiffusion = strcmp(doc["dither"] | "ordered", "diffusion") == 0;
+  const char *refresh = doc["refresh"] | "full";
+  config.refresh = strcmp(refresh, "fast") == 0 ? REFRESH_FAST : (strcmp(refresh, "auto") == 0 ? REFRESH_AUTO : REFRESH_FULL);
+  config.pipeline = doc["pipeline"] | config.pipeline;
+  config.boundedPng = doc["boundedPng"] | config.boundedPng;
+  config.verifyImages = doc["verifyImages"] | config.verifyImages;
+  const char *scale = doc["scale"] | "none";
+  config.scale = SCALE_NONE;
+  for (ScaleMode mode : {SCALE_FIT, SCALE_FILL, SCALE_CENTER})
+  {
+    if (strcmp(scale, scaleModeName(mode)) == 0)
+      config.scale = mode;
+  }
+  config.portalIdleS = doc["portal"]["idleSeconds"] | config.portalIdleS;
+  config.portalMaxS = doc["portal"]["maxSeconds"] | config.portalMaxS;
+  config.portalAfterReset = doc["portal"]["afterReset"] | config.portalAfterReset;
+  loadSchedule(doc["schedule"], config.schedule);
+  loadBudget(doc["budget"], config.budget);
+  loadEnergyProfile(doc["energy"], config);
+  loadLayout(doc["layout"], config.layout);
+  loadPanels(doc["panels"], config);
+  config.overlapRefresh = doc["overlapRefresh"] | config.overlapRefresh;
+  loadTlsSettings(doc["tls"], tlsSettings);
+
   // Close the file (Curiously, File's destructor doesn't close the file)
   file.close();
 }
@@ -345,38 +1114,48 @@ void setup()
   WRITE_PERI_REG(RTC_CNTL_BROWN_OUT_REG, 0); //disable brownout detector
   Serial.begin(115200);
   delay(10);
-  connectToWifi();
+  logInit();
 
-  loadConfiguration("/config.json", config);
-  Serial.print("imageUrl: ");
-  Serial.println(config.imageUrl);
+  RESET_REASON reason = rtc_get_reset_reason(0);
+  LOG_INFO("BOOT", "reset reason %s", resetReasonName(reason));
 
-  print_reset_reason(rtc_get_reset_reason(0));
-  if (rtc_get_reset_reason(0) == POWERON_RESET)
+  // before WiFi, which takes its budget from it
+  loadConfiguration("/config.json", config);
+  // power on clears the RTC memory, only a window after a restart or a crash still has the wakes before it at /log
+  bool attended = reason == POWERON_RESET || (config.portalAfterReset && reason != DEEPSLEEP_RESET);
+  configurePanels();
+  // somebody may be setting the frame up after power on, the budgets start once the configuration window closed
+  if (!attended)
   {
-    server = new AsyncWebServer(80);
-    server->on("/", HTTP_GET, [](AsyncWebServerRequest *request) {
-      request->send(200, "text/html", readFile("/index.html"));
-    });
+    deadlineBegin(config.budget);
+  }
+  if (!connectToWifi(attended))
+  {
+    sleep();
+  }
 
-    AsyncElegantOTA.begin(server); // Start ElegantOTA
-    server->begin();
+  sampleBattery();
 
-    showIp();
+  // after WiFi is up so the arena does not take the memory the WiFi stack needs
+  bool arena = wakeArenaInit(WAKE_ARENA_SIZE) > 0;
+  if (!arena)
+  {
+    // the frame buffer would come from the heap WiFi and TLS need, the panel keeps its image until the next slot
+    LOG_ERROR("ARENA", "less than %u bytes free beside the %u bytes kept for WiFi, nothing is drawn",
+              WAKE_ARENA_MIN_SIZE, WAKE_ARENA_HEAP_RESERVE);
+  }
+  LOG_INFO("CONFIG", "imageUrl: %s", config.imageUrl);
 
-    auto start = millis();
-    while (millis() < start + 2 * 60 * 1000)
-    {
-      AsyncElegantOTA.loop();
-    }
-    ESP.restart();
+  if (attended)
+  {
+    runConfigWindow();
+    deadlineBegin(config.budget);
   }
-  else
+  if (updateTime() && arena)
   {
-    updateTime();
     draw();
-    sleep();
   }
+  sleep();
 }
 
 void loop()
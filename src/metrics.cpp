@@ -0,0 +1,72 @@
+#include "metrics.h"
+
+#include <esp_heap_caps.h>
+
+#include "log.h"
+
+PhaseMetrics phaseMetrics;
+
+const char *phaseName(Phase phase)
+{
+  switch (phase)
+  {
+  case PHASE_WIFI:
+    return "wifi";
+  case PHASE_CONFIG:
+    return "config";
+  case PHASE_TIME:
+    return "time";
+  case PHASE_DOWNLOAD:
+    return "download";
+  case PHASE_DECODE:
+    return "decode";
+  case PHASE_FLUSH:
+    return "flush";
+  case PHASE_PORTAL:
+    return "portal";
+  default:
+    return "unknown";
+  }
+}
+
+uint32_t phaseElapsedMs(Phase phase)
+{
+  uint32_t elapsed = phaseMetrics.durationMs[phase];
+  if (phaseMetrics.running[phase])
+  {
+    elapsed += millis() - phaseMetrics.runningSinceMs[phase];
+  }
+  return elapsed;
+}
+
+const char *buildProfile()
+{
+#ifdef BUILD_PROFILE_LEAN
+  return "lean";
+#else
+  return "full";
+#endif
+}
+
+void recordHeapAtDraw()
+{
+  phaseMetrics.freeHeapAtDraw = heap_caps_get_free_size(MALLOC_CAP_8BIT);
+  phaseMetrics.largestBlockAtDraw = heap_caps_get_largest_free_block(MALLOC_CAP_8BIT);
+}
+
+void printPhaseMetrics()
+{
+  for (int phase = 0; phase < PHASE_COUNT; ++phase)
+  {
+    LOG_INFO("METRICS", "%s: %u ms", phaseName(static_cast<Phase>(phase)), phaseMetrics.durationMs[phase]);
+  }
+
+  // bytes per ms is kB/s
+  LOG_INFO("METRICS", "received %u bytes in %u ms (%u kB/s)", phaseMetrics.receivedBytes, phaseMetrics.receiveMs,
+           phaseMetrics.receiveMs ? phaseMetrics.receivedBytes / phaseMetrics.receiveMs : 0);
+  LOG_INFO("METRICS", "profile %s, firmware %u bytes, first image byte %u ms after boot, heap at draw %u bytes free, "
+           "largest block %u bytes", buildProfile(), ESP.getSketchSize(), phaseMetrics.firstByteMs,
+           phaseMetrics.freeHeapAtDraw, phaseMetrics.largestBlockAtDraw);
+  LOG_INFO("METRICS", "log %u lines, %u dropped, peak %u of %u bytes", logStats.lines, logStats.dropped,
+           logStats.peakBytes, LOG_BUFFER_SIZE);
+}
@@ -0,0 +1,70 @@
+#ifndef _METRICS_H_
+#define _METRICS_H_
+
+#include <Arduino.h>
+
+enum Phase : uint8_t
+{
+  PHASE_WIFI,
+  PHASE_CONFIG,
+  PHASE_TIME,
+  PHASE_DOWNLOAD,
+  PHASE_DECODE,
+  PHASE_FLUSH,
+  PHASE_PORTAL,
+  PHASE_COUNT
+};
+
+struct PhaseMetrics
+{
+  uint32_t durationMs[PHASE_COUNT] = {0};
+  // millis() when the PhaseTimer of a phase that is running now started
+  uint32_t runningSinceMs[PHASE_COUNT] = {0};
+  bool running[PHASE_COUNT] = {false};
+
+  // receive loop only, without connection setup, so this measures the sustained throughput
+  uint32_t receivedBytes = 0;
+  uint32_t receiveMs = 0;
+
+  // millis() when the first byte of the image arrived
+  uint32_t firstByteMs = 0;
+  // heap when draw() starts, what is left for the decoders and the frame buffer
+  uint32_t freeHeapAtDraw = 0;
+  uint32_t largestBlockAtDraw = 0;
+};
+
+extern PhaseMetrics phaseMetrics;
+
+// Adds the time between construction and destruction to the given phase.
+class PhaseTimer
+{
+public:
+  explicit PhaseTimer(Phase phase) : phase(phase), start(millis())
+  {
+    phaseMetrics.runningSinceMs[phase] = start;
+    phaseMetrics.running[phase] = true;
+  }
+  ~PhaseTimer()
+  {
+    phaseMetrics.durationMs[phase] += millis() - start;
+    phaseMetrics.running[phase] = false;
+  }
+
+private:
+  Phase phase;
+  uint32_t start;
+};
+
+const char *phaseName(Phase phase);
+
+// The time of phase so far, with the PhaseTimer that is running now.
+uint32_t phaseElapsedMs(Phase phase);
+
+// Name of the build profile, see gfxconf.h.
+const char *buildProfile();
+
+void recordHeapAtDraw();
+
+void printPhaseMetrics();
+
+#endif
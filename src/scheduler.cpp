@@ -0,0 +1,208 @@
+#include "scheduler.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// how far ahead nextWake() looks, a weekly rule always matches within this range
+static const int SEARCH_DAYS = 8;
+
+static bool isWeekend(const struct tm &time)
+{
+  return time.tm_wday == 0 || time.tm_wday == 6;
+}
+
+bool CronSlot::matches(const struct tm &time) const
+{
+  bool dayOfMonth = daysOfMonth >> time.tm_mday & 1;
+  bool dayOfWeek = daysOfWeek >> time.tm_wday & 1;
+  bool day = anyDayOfMonth || anyDayOfWeek ? dayOfMonth && dayOfWeek : dayOfMonth || dayOfWeek;
+  return (minutes >> time.tm_min & 1) && (hours >> time.tm_hour & 1) && day && (months >> (time.tm_mon + 1) & 1);
+}
+
+// Parses one field of a cron expression into a bitmask of the values between min and max.
+static bool parseField(const char *field, size_t length, int min, int max, uint64_t &mask)
+{
+  mask = 0;
+  const char *end = field + length;
+  while (field < end)
+  {
+    const char *itemEnd = static_cast<const char *>(memchr(field, ',', end - field));
+    if (!itemEnd)
+    {
+      itemEnd = end;
+    }
+
+    int from = min;
+    int to = max;
+    int step = 1;
+    const char *position = field;
+    char *parsed = nullptr;
+
+    if (*position == '*')
+    {
+      position++;
+    }
+    else
+    {
+      from = strtol(position, &parsed, 10);
+      if (parsed == position)
+      {
+        return false;
+      }
+      position = parsed;
+      to = from;
+      if (*position == '-')
+      {
+        to = strtol(++position, &parsed, 10);
+        if (parsed == position)
+        {
+          return false;
+        }
+        position = parsed;
+      }
+    }
+
+    if (*position == '/')
+    {
+      step = strtol(++position, &parsed, 10);
+      if (parsed == position || step <= 0)
+      {
+        return false;
+      }
+      position = parsed;
+      if (from == to)
+      {
+        // "a/n" means every n starting at a
+        to = max;
+      }
+    }
+
+    if (position != itemEnd || from < min || to > max || from > to)
+    {
+      return false;
+    }
+
+    for (int value = from; value <= to; value += step)
+    {
+      mask |= 1ull << value;
+    }
+    field = itemEnd + 1;
+  }
+  return mask != 0;
+}
+
+bool parseCronSlot(const char *expression, CronSlot &slot)
+{
+  static const int limits[5][2] = {{0, 59}, {0, 23}, {1, 31}, {1, 12}, {0, 6}};
+  uint64_t masks[5];
+  bool any[5];
+
+  const char *position = expression;
+  for (int field = 0; field < 5; ++field)
+  {
+    while (*position == ' ')
+    {
+      position++;
+    }
+    size_t length = strcspn(position, " ");
+    if (length == 0 || !parseField(position, length, limits[field][0], limits[field][1], masks[field]))
+    {
+      return false;
+    }
+    any[field] = *position == '*';
+    position += length;
+  }
+  while (*position == ' ')
+  {
+    position++;
+  }
+  if (*position != '\0')
+  {
+    return false;
+  }
+
+  slot.minutes = masks[0];
+  slot.hours = masks[1];
+  slot.daysOfMonth = masks[2];
+  slot.months = masks[3];
+  slot.daysOfWeek = masks[4];
+  slot.anyDayOfMonth = any[2];
+  slot.anyDayOfWeek = any[4];
+  return true;
+}
+
+int parseTimeOfDay(const char *text)
+{
+  char *end = nullptr;
+  long hours = strtol(text, &end, 10);
+  if (end == text || *end != ':' || hours < 0 || hours > 23)
+  {
+    return -1;
+  }
+  const char *minuteText = end + 1;
+  long minutes = strtol(minuteText, &end, 10);
+  if (end == minuteText || *end != '\0' || minutes < 0 || minutes > 59)
+  {
+    return -1;
+  }
+  return hours * 60 + minutes;
+}
+
+static bool isQuiet(const Schedule &schedule, const struct tm &time)
+{
+  if (schedule.quietFrom < 0 || schedule.quietTo < 0)
+  {
+    return false;
+  }
+  int minute = time.tm_hour * 60 + time.tm_min;
+  if (schedule.quietFrom <= schedule.quietTo)
+  {
+    return minute >= schedule.quietFrom && minute < schedule.quietTo;
+  }
+  return minute >= schedule.quietFrom || minute < schedule.quietTo;
+}
+
+static bool matches(const Schedule &schedule, const struct tm &time)
+{
+  const CronSlot *slots = schedule.slots;
+  int slotCount = schedule.slotCount;
+  if (schedule.weekendSlotCount > 0 && isWeekend(time))
+  {
+    slots = schedule.weekendSlots;
+    slotCount = schedule.weekendSlotCount;
+  }
+
+  if (slotCount == 0)
+  {
+    return time.tm_min % 5 == 0;
+  }
+  for (int i = 0; i < slotCount; ++i)
+  {
+    if (slots[i].matches(time))
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
+time_t nextWake(const Schedule &schedule, time_t now, time_t notBefore)
+{
+  time_t candidate = notBefore > now ? notBefore : now + 1;
+  // slots are whole minutes
+  candidate = (candidate + 59) / 60 * 60;
+
+  for (int minute = 0; minute < SEARCH_DAYS * 24 * 60; ++minute)
+  {
+    struct tm time;
+    localtime_r(&candidate, &time);
+
+    if (!matches(schedule, time) || isQuiet(schedule, time))
+    {
+      candidate += 60;
+      continue;
+    }
+    return candidate;
+  }
+  return 0;
+}
@@ -0,0 +1,48 @@
+#ifndef _SCHEDULER_H_
+#define _SCHEDULER_H_
+
+#include <stdint.h>
+#include <time.h>
+
+// One cron-like rule "<minute> <hour> <day of month> <month> <day of week>".
+// Every field accepts "*", numbers, ranges "a-b", steps "*/n" or "a-b/n" and comma separated lists of these.
+// As in cron, a day that matches either the day of month or the day of week matches if both are restricted, so
+// "0 6 1 * 1" wakes on the 1st and on every monday. A day field starting with "*" does not restrict.
+struct CronSlot
+{
+  uint64_t minutes = 0;
+  uint32_t hours = 0;
+  uint32_t daysOfMonth = 0; // bit 1 to 31
+  uint16_t months = 0;      // bit 1 to 12
+  uint8_t daysOfWeek = 0;   // bit 0 (sunday) to 6
+  bool anyDayOfMonth = true;
+  bool anyDayOfWeek = true;
+
+  bool matches(const struct tm &time) const;
+};
+
+const int MAX_SCHEDULE_SLOTS = 4;
+
+struct Schedule
+{
+  CronSlot slots[MAX_SCHEDULE_SLOTS];
+  int slotCount = 0;
+  // used on saturdays and sundays instead of slots if there are any
+  CronSlot weekendSlots[MAX_SCHEDULE_SLOTS];
+  int weekendSlotCount = 0;
+  // minutes since midnight, no wakes in [quietFrom, quietTo), may wrap around midnight
+  int quietFrom = -1;
+  int quietTo = -1;
+};
+
+// Parses a cron expression, returns false if it is malformed.
+bool parseCronSlot(const char *expression, CronSlot &slot);
+
+// Parses "HH:MM" into minutes since midnight, returns -1 if it is malformed.
+int parseTimeOfDay(const char *text);
+
+// Returns the first slot that is not in the quiet hours and at or after notBefore, but strictly after now.
+// A schedule without slots wakes every five minutes. Returns 0 if nothing matches within eight days.
+time_t nextWake(const Schedule &schedule, time_t now, time_t notBefore);
+
+#endif
@@ -0,0 +1,125 @@
+#include "tiles.h"
+#include "wake_arena.h"
+
+#include <cstring>
+#include "SPIFFS.h"
+
+extern "C"
+{
+#include "ws75bepd_driver.h"
+}
+
+struct TileCacheHeader
+{
+  char magic[4];
+  // CRC-32 of the URL and the rectangle, a tile that was moved or points somewhere else is not cached anymore
+  uint32_t key;
+  uint32_t length;
+  uint32_t crc;
+  char etag[64];
+};
+
+static const char TILE_CACHE_MAGIC[4] = {'T', 'I', 'L', '1'};
+
+static String tilePath(int index)
+{
+  return String("/tiles/") + String(index) + ".bin";
+}
+
+static File openCachedTile(int index)
+{
+  String path = tilePath(index);
+  // opening a missing file for reading logs an error
+  return SPIFFS.exists(path) ? SPIFFS.open(path) : File();
+}
+
+static uint32_t tileKey(const Tile &tile)
+{
+  int16_t rectangle[4] = {tile.x, tile.y, tile.width, tile.height};
+  uint32_t key = ws75bepdCrc32(0, reinterpret_cast<const gU8 *>(tile.url), strlen(tile.url));
+  return ws75bepdCrc32(key, reinterpret_cast<const gU8 *>(rectangle), sizeof(rectangle));
+}
+
+static bool readHeader(File &file, const Tile &tile, TileCacheHeader &header)
+{
+  if (!file || file.read(reinterpret_cast<uint8_t *>(&header), sizeof(header)) != sizeof(header))
+  {
+    return false;
+  }
+  return memcmp(header.magic, TILE_CACHE_MAGIC, sizeof(header.magic)) == 0 && header.key == tileKey(tile) &&
+         header.length == file.size() - sizeof(header);
+}
+
+bool cachedTileEtag(int index, const Tile &tile, char *etag, size_t size)
+{
+  File file = openCachedTile(index);
+  TileCacheHeader header;
+  bool cached = readHeader(file, tile, header) && header.etag[0];
+  if (cached)
+  {
+    header.etag[sizeof(header.etag) - 1] = '\0';
+    strlcpy(etag, header.etag, size);
+  }
+  file.close();
+  return cached;
+}
+
+bool drawCachedTile(GDisplay *display, int index, const Tile &tile)
+{
+  File file = openCachedTile(index);
+  TileCacheHeader header;
+  if (!readHeader(file, tile, header))
+  {
+    file.close();
+    return false;
+  }
+
+  uint8_t *packed = static_cast<uint8_t *>(wakeArenaAlloc(header.length));
+  bool drawn = packed && file.read(packed, header.length) == header.length &&
+               ws75bepdCrc32(0, packed, header.length) == header.crc &&
+               ws75bepdWriteRegion(display, tile.x, tile.y, tile.width, tile.height, packed, header.length);
+  wakeArenaFree(packed);
+  file.close();
+  return drawn;
+}
+
+bool storeTile(GDisplay *display, int index, const Tile &tile, const char *etag)
+{
+  uint32_t size = WS75bEPD_REGION_BYTES(tile.width, tile.height);
+  uint8_t *region = static_cast<uint8_t *>(wakeArenaAlloc(size));
+  uint8_t *packed = static_cast<uint8_t *>(wakeArenaAlloc(size + (size + 127) / 128));
+  if (!region || !packed)
+  {
+    wakeArenaFree(packed);
+    wakeArenaFree(region);
+    return false;
+  }
+
+  ws75bepdReadRegion(display, tile.x, tile.y, tile.width, tile.height, region);
+  TileCacheHeader header;
+  memcpy(header.magic, TILE_CACHE_MAGIC, sizeof(header.magic));
+  header.key = tileKey(tile);
+  header.length = ws75bepdPack(region, size, packed);
+  header.crc = ws75bepdCrc32(0, packed, header.length);
+  memset(header.etag, 0, sizeof(header.etag));
+  strlcpy(header.etag, etag, sizeof(header.etag));
+
+  File file = SPIFFS.open(tilePath(index), FILE_WRITE);
+  bool stored = file && file.write(reinterpret_cast<const uint8_t *>(&header), sizeof(header)) == sizeof(header) &&
+                file.write(packed, header.length) == header.length;
+  file.close();
+  wakeArenaFree(packed);
+  wakeArenaFree(region);
+
+  if (!stored)
+  {
+    // a half written tile must not be taken for current
+    dropCachedTile(index);
+  }
+  return stored;
+}
+
+void dropCachedTile(int index)
+{
+  SPIFFS.remove(tilePath(index));
+}
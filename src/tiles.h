@@ -0,0 +1,45 @@
+#ifndef _TILES_H_
+#define _TILES_H_
+
+#include <stdint.h>
+
+extern "C"
+{
+#include "gfx.h"
+}
+
+// A region of the frame with an image of its own, drawn at its position and clipped to its size.
+struct Tile
+{
+  char url[96] = "";
+  int16_t x = 0;
+  int16_t y = 0;
+  int16_t width = 0;
+  int16_t height = 0;
+};
+
+const int MAX_TILES = 6;
+
+// Without tiles the frame is the single image of imageUrl.
+struct Layout
+{
+  Tile tiles[MAX_TILES];
+  int tileCount = 0;
+};
+
+// Tiles are cached in SPIFFS in packed form (ws75bepdReadRegion, compressed with PackBits) together with their ETag,
+// so a tile that did not change is neither downloaded nor decoded again.
+
+// Copies the ETag of the cached tile to etag, false if the tile is not cached or the cache belongs to another tile.
+bool cachedTileEtag(int index, const Tile &tile, char *etag, size_t size);
+
+// Draws the cached tile into the frame buffer, false if it is missing or damaged.
+bool drawCachedTile(GDisplay *display, int index, const Tile &tile);
+
+// Packs the tile from the frame buffer and stores it with its ETag, replacing the previous one.
+bool storeTile(GDisplay *display, int index, const Tile &tile, const char *etag);
+
+// Removes the cache of a tile, for tiles that could not be drawn.
+void dropCachedTile(int index);
+
+#endif
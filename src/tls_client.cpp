@@ -0,0 +1,415 @@
+#include "tls_client.h"
+
+#include <cstring>
+#include <mbedtls/error.h>
+#include <mbedtls/sha256.h>
+
+#include "log.h"
+
+extern "C"
+{
+#include "ws75bepd_frame.h"
+}
+
+// The serialized session holds the ticket and, depending on MBEDTLS_SSL_KEEP_PEER_CERTIFICATE, the server certificate.
+static const size_t TLS_SESSION_CACHE_SIZE = 2048;
+
+struct TlsSessionCache
+{
+  // CRC-32 of host, port and verification settings of the session, 0 if there is none
+  uint32_t key;
+  uint16_t length;
+  uint8_t data[TLS_SESSION_CACHE_SIZE];
+};
+
+static RTC_DATA_ATTR TlsSessionCache sessionCache;
+
+TlsSettings tlsSettings;
+RTC_DATA_ATTR TlsStats tlsStats;
+TlsStats tlsStatsThisWake;
+
+enum HandshakeResult
+{
+  HANDSHAKE_OK,
+  HANDSHAKE_FAILED,
+  // full handshake without the CA certificates, which are only parsed when no session could be resumed
+  HANDSHAKE_UNVERIFIED,
+};
+
+ResumableTlsClient::ResumableTlsClient(const TlsSettings &settings) : settings(settings)
+{
+  mbedtls_net_init(&net);
+  mbedtls_ssl_init(&ssl);
+  mbedtls_ssl_config_init(&conf);
+  mbedtls_entropy_init(&entropy);
+  mbedtls_ctr_drbg_init(&drbg);
+  mbedtls_x509_crt_init(&ca);
+}
+
+ResumableTlsClient::~ResumableTlsClient()
+{
+  stop();
+}
+
+uint32_t ResumableTlsClient::sessionKey(const char *host, uint16_t port) const
+{
+  uint32_t key = ws75bepdCrc32(0, reinterpret_cast<const uint8_t *>(host), strlen(host));
+  key = ws75bepdCrc32(key, reinterpret_cast<const uint8_t *>(&port), sizeof(port));
+  if (settings.pinned)
+  {
+    key = ws75bepdCrc32(key, settings.fingerprint, sizeof(settings.fingerprint));
+  }
+  if (settings.caCert)
+  {
+    key = ws75bepdCrc32(key, reinterpret_cast<const uint8_t *>(settings.caCert), strlen(settings.caCert));
+  }
+  // 0 marks an empty cache
+  return key ? key : 1;
+}
+
+void ResumableTlsClient::loadSession(mbedtls_ssl_session &session)
+{
+  if (mbedtls_ssl_session_load(&session, sessionCache.data, sessionCache.length) != 0 ||
+      mbedtls_ssl_set_session(&ssl, &session) != 0)
+  {
+    sessionCache.key = 0;
+  }
+}
+
+void ResumableTlsClient::saveSession(uint32_t key)
+{
+  mbedtls_ssl_session session;
+  mbedtls_ssl_session_init(&session);
+  size_t length = 0;
+  sessionCache.key = 0;
+  if (mbedtls_ssl_get_session(&ssl, &session) == 0 &&
+      mbedtls_ssl_session_save(&session, sessionCache.data, sizeof(sessionCache.data), &length) == 0)
+  {
+    sessionCache.key = key;
+    sessionCache.length = length;
+  }
+  else
+  {
+    LOG_WARN("TLS", "session does not fit into RTC memory, the next wake does a full handshake");
+  }
+  mbedtls_ssl_session_free(&session);
+}
+
+// A resumed session keeps the master secret of the offered one, a full handshake agrees on a new one. The session ID
+// does not tell: with a ticket the client makes up a new ID for every handshake.
+bool ResumableTlsClient::sameSession(const mbedtls_ssl_session &offered)
+{
+  mbedtls_ssl_session current;
+  mbedtls_ssl_session_init(&current);
+  bool same = mbedtls_ssl_get_session(&ssl, &current) == 0 &&
+              memcmp(current.master, offered.master, sizeof(current.master)) == 0;
+  mbedtls_ssl_session_free(&current);
+  return same;
+}
+
+// Only the server certificate itself counts, it has to match the pinned fingerprint.
+int ResumableTlsClient::verifyPin(void *context, mbedtls_x509_crt *certificate, int depth, uint32_t *flags)
+{
+  const TlsSettings *settings = static_cast<const TlsSettings *>(context);
+  if (depth > 0)
+  {
+    *flags = 0;
+    return 0;
+  }
+
+  uint8_t digest[32];
+  mbedtls_sha256_ret(certificate->raw.p, certificate->raw.len, digest, 0);
+  *flags = memcmp(digest, settings->fingerprint, sizeof(digest)) == 0 ? 0 : MBEDTLS_X509_BADCERT_NOT_TRUSTED;
+  return 0;
+}
+
+bool ResumableTlsClient::setup(const char *host, int32_t timeout, bool offerSession)
+{
+  static const char personalization[] = "epaper";
+  if (mbedtls_ctr_drbg_seed(&drbg, mbedtls_entropy_func, &entropy, reinterpret_cast<const uint8_t *>(personalization),
+                            sizeof(personalization)) != 0 ||
+      mbedtls_ssl_config_defaults(&conf, MBEDTLS_SSL_IS_CLIENT, MBEDTLS_SSL_TRANSPORT_STREAM,
+                                  MBEDTLS_SSL_PRESET_DEFAULT) != 0)
+  {
+    return false;
+  }
+  mbedtls_ssl_conf_rng(&conf, mbedtls_ctr_drbg_random, &drbg);
+  mbedtls_ssl_conf_read_timeout(&conf, timeout);
+#if defined(MBEDTLS_SSL_SESSION_TICKETS)
+  mbedtls_ssl_conf_session_tickets(&conf, MBEDTLS_SSL_SESSION_TICKETS_ENABLED);
+#endif
+
+  if (settings.pinned)
+  {
+    // no CA chain, the callback decides and the result is checked after the handshake
+    mbedtls_ssl_conf_authmode(&conf, MBEDTLS_SSL_VERIFY_OPTIONAL);
+    mbedtls_ssl_conf_verify(&conf, verifyPin, const_cast<TlsSettings *>(&settings));
+  }
+  else if (settings.caCert && !offerSession)
+  {
+    if (mbedtls_x509_crt_parse(&ca, reinterpret_cast<const uint8_t *>(settings.caCert), strlen(settings.caCert) + 1) != 0)
+    {
+      LOG_ERROR("TLS", "can not parse the CA certificates");
+      return false;
+    }
+    mbedtls_ssl_conf_authmode(&conf, MBEDTLS_SSL_VERIFY_REQUIRED);
+    mbedtls_ssl_conf_ca_chain(&conf, &ca, nullptr);
+  }
+  else if (settings.caCert)
+  {
+    // a resumed session was verified when it was established, a full handshake is repeated with the CA certificates
+    mbedtls_ssl_conf_authmode(&conf, MBEDTLS_SSL_VERIFY_OPTIONAL);
+  }
+  else
+  {
+    mbedtls_ssl_conf_authmode(&conf, MBEDTLS_SSL_VERIFY_NONE);
+  }
+
+  if (mbedtls_ssl_setup(&ssl, &conf) != 0 || mbedtls_ssl_set_hostname(&ssl, host) != 0)
+  {
+    return false;
+  }
+  mbedtls_ssl_set_bio(&ssl, &net, mbedtls_net_send, mbedtls_net_recv, mbedtls_net_recv_timeout);
+  return true;
+}
+
+int ResumableTlsClient::handshake(const char *host, uint16_t port, int32_t timeout, bool offerSession)
+{
+  stop();
+  uint32_t start = millis();
+
+  char portText[6];
+  snprintf(portText, sizeof(portText), "%u", port);
+  if (mbedtls_net_connect(&net, host, portText, MBEDTLS_NET_PROTO_TCP) != 0)
+  {
+    LOG_WARN("TLS", "can not connect");
+    return HANDSHAKE_FAILED;
+  }
+  if (!setup(host, timeout, offerSession))
+  {
+    stop();
+    return HANDSHAKE_FAILED;
+  }
+
+  uint32_t key = sessionKey(host, port);
+  mbedtls_ssl_session session;
+  mbedtls_ssl_session_init(&session);
+  if (offerSession)
+  {
+    loadSession(session);
+  }
+
+  int ret;
+  do
+  {
+    ret = mbedtls_ssl_handshake(&ssl);
+  } while (ret == MBEDTLS_ERR_SSL_WANT_READ || ret == MBEDTLS_ERR_SSL_WANT_WRITE);
+  bool resumed = ret == 0 && offerSession && sameSession(session);
+  mbedtls_ssl_session_free(&session);
+
+  if (ret != 0)
+  {
+    char error[64];
+    mbedtls_strerror(ret, error, sizeof(error));
+    LOG_WARN("TLS", "handshake failed: %s", error);
+    sessionCache.key = 0;
+    stop();
+    return HANDSHAKE_FAILED;
+  }
+  if (!resumed && (settings.pinned || settings.caCert) && mbedtls_ssl_get_verify_result(&ssl) != 0)
+  {
+    stop();
+    if (offerSession && !settings.pinned)
+    {
+      return HANDSHAKE_UNVERIFIED;
+    }
+    LOG_ERROR("TLS", "server certificate not trusted");
+    sessionCache.key = 0;
+    return HANDSHAKE_FAILED;
+  }
+
+  uint32_t elapsed = millis() - start;
+  for (TlsStats *stats : {&tlsStats, &tlsStatsThisWake})
+  {
+    stats->handshakes++;
+    stats->resumed += resumed;
+    stats->handshakeMs += elapsed;
+  }
+  LOG_INFO("TLS", "%s handshake in %u ms", resumed ? "resumed" : "full", elapsed);
+
+  if (settings.resume)
+  {
+    saveSession(key);
+  }
+  // the handshake waits up to timeout for each record, afterwards available() and read() only poll the socket and the
+  // caller waits in waitForData() with what is left of its budget
+  mbedtls_ssl_conf_read_timeout(&conf, 0);
+  mbedtls_ssl_set_bio(&ssl, &net, mbedtls_net_send, mbedtls_net_recv, nullptr);
+  mbedtls_net_set_nonblock(&net);
+  open = true;
+  return HANDSHAKE_OK;
+}
+
+int ResumableTlsClient::connect(const char *host, uint16_t port, int32_t timeout)
+{
+  uint32_t key = sessionKey(host, port);
+  bool offerSession = settings.resume && sessionCache.key == key && sessionCache.length > 0;
+  int result = handshake(host, port, timeout, offerSession);
+  if (result == HANDSHAKE_UNVERIFIED)
+  {
+    // the server did not resume, so the certificate has to be checked after all
+    result = handshake(host, port, timeout, false);
+  }
+  return result == HANDSHAKE_OK;
+}
+
+int ResumableTlsClient::connect(const char *host, uint16_t port)
+{
+  return connect(host, port, getTimeout());
+}
+
+int ResumableTlsClient::connect(IPAddress ip, uint16_t port, int32_t timeout)
+{
+  return connect(ip.toString().c_str(), port, timeout);
+}
+
+int ResumableTlsClient::connect(IPAddress ip, uint16_t port)
+{
+  return connect(ip.toString().c_str(), port, getTimeout());
+}
+
+size_t ResumableTlsClient::write(const uint8_t *buf, size_t size)
+{
+  size_t written = 0;
+  uint32_t start = millis();
+  while (open && written < size)
+  {
+    int ret = mbedtls_ssl_write(&ssl, buf + written, size - written);
+    if (ret > 0)
+    {
+      written += ret;
+    }
+    else if ((ret != MBEDTLS_ERR_SSL_WANT_READ && ret != MBEDTLS_ERR_SSL_WANT_WRITE) || millis() - start > getTimeout())
+    {
+      peerClosed = true;
+      break;
+    }
+    else
+    {
+      delay(1);
+    }
+  }
+  return written;
+}
+
+size_t ResumableTlsClient::write(uint8_t data)
+{
+  return write(&data, 1);
+}
+
+int ResumableTlsClient::available()
+{
+  if (!open)
+  {
+    return 0;
+  }
+  int pending = mbedtls_ssl_get_bytes_avail(&ssl);
+  if (pending == 0 && !peerClosed)
+  {
+    // processes a record if one arrived, the socket does not block
+    int ret = mbedtls_ssl_read(&ssl, nullptr, 0);
+    if (ret < 0 && ret != MBEDTLS_ERR_SSL_WANT_READ && ret != MBEDTLS_ERR_SSL_WANT_WRITE)
+    {
+      peerClosed = true;
+    }
+    pending = mbedtls_ssl_get_bytes_avail(&ssl);
+  }
+  return pending + (peeked >= 0 ? 1 : 0);
+}
+
+int ResumableTlsClient::read(uint8_t *buf, size_t size)
+{
+  if (!open || size == 0)
+  {
+    return -1;
+  }
+
+  int count = 0;
+  if (peeked >= 0)
+  {
+    buf[count++] = peeked;
+    peeked = -1;
+    if (--size == 0)
+    {
+      return count;
+    }
+  }
+
+  int ret = mbedtls_ssl_read(&ssl, buf + count, size);
+  if (ret > 0)
+  {
+    return count + ret;
+  }
+  if (ret != MBEDTLS_ERR_SSL_WANT_READ && ret != MBEDTLS_ERR_SSL_WANT_WRITE)
+  {
+    peerClosed = true;
+  }
+  return count ? count : -1;
+}
+
+int ResumableTlsClient::read()
+{
+  uint8_t data;
+  return read(&data, 1) == 1 ? data : -1;
+}
+
+int ResumableTlsClient::peek()
+{
+  if (peeked < 0)
+  {
+    uint8_t data;
+    if (read(&data, 1) == 1)
+    {
+      peeked = data;
+    }
+  }
+  return peeked;
+}
+
+void ResumableTlsClient::flush()
+{
+}
+
+uint8_t ResumableTlsClient::connected()
+{
+  if (open && !peerClosed)
+  {
+    available();
+  }
+  return open && !peerClosed;
+}
+
+void ResumableTlsClient::stop()
+{
+  if (open && !peerClosed)
+  {
+    mbedtls_ssl_close_notify(&ssl);
+  }
+  open = false;
+  peerClosed = false;
+  peeked = -1;
+
+  mbedtls_net_free(&net);
+  mbedtls_ssl_free(&ssl);
+  mbedtls_ssl_config_free(&conf);
+  mbedtls_ctr_drbg_free(&drbg);
+  mbedtls_entropy_free(&entropy);
+  mbedtls_x509_crt_free(&ca);
+
+  mbedtls_net_init(&net);
+  mbedtls_ssl_init(&ssl);
+  mbedtls_ssl_config_init(&conf);
+  mbedtls_entropy_init(&entropy);
+  mbedtls_ctr_drbg_init(&drbg);
+  mbedtls_x509_crt_init(&ca);
+}
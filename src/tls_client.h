@@ -0,0 +1,87 @@
+#ifndef _TLS_CLIENT_H_
+#define _TLS_CLIENT_H_
+
+#include <Arduino.h>
+#include <WiFiClient.h>
+
+#include <mbedtls/ctr_drbg.h>
+#include <mbedtls/entropy.h>
+#include <mbedtls/net_sockets.h>
+#include <mbedtls/ssl.h>
+#include <mbedtls/x509_crt.h>
+
+// How HTTPS servers are verified, filled from the "tls" section of config.json.
+struct TlsSettings
+{
+  // SHA-256 of the server certificate, only that certificate is accepted
+  uint8_t fingerprint[32] = {0};
+  bool pinned = false;
+  // PEM with the CA certificates, verified against these if not pinned. Without either nothing is verified.
+  const char *caCert = nullptr;
+  // resume the session of the previous wake
+  bool resume = true;
+};
+
+// Counters survive deep sleep like DownloadStats.
+struct TlsStats
+{
+  uint32_t handshakes = 0;
+  uint32_t resumed = 0;
+  uint32_t handshakeMs = 0;
+};
+
+extern TlsSettings tlsSettings;
+extern TlsStats tlsStats;
+extern TlsStats tlsStatsThisWake;
+
+// TLS client for HTTPClient that resumes the session of the previous wake, by session ticket or session ID.
+//
+// The session is kept in RTC memory together with the host and the verification settings it was established with.
+// A resumed handshake skips the key exchange and the server sends no certificate, so the result of the pinning or
+// CA check of the full handshake is reused as well. Changing the settings in config.json starts a new session.
+// Needs mbedtls 2.19 to 2.28: sessions are saved with mbedtls_ssl_session_save(), 3.x makes the session fields private.
+class ResumableTlsClient : public WiFiClient
+{
+public:
+  explicit ResumableTlsClient(const TlsSettings &settings);
+  ~ResumableTlsClient();
+
+  int connect(IPAddress ip, uint16_t port);
+  int connect(IPAddress ip, uint16_t port, int32_t timeout);
+  int connect(const char *host, uint16_t port);
+  int connect(const char *host, uint16_t port, int32_t timeout);
+  size_t write(uint8_t data);
+  size_t write(const uint8_t *buf, size_t size);
+  int available();
+  int read();
+  int read(uint8_t *buf, size_t size);
+  int peek();
+  void flush();
+  void stop();
+  uint8_t connected();
+  operator bool() { return connected(); }
+  // hides WiFiClient::fd(), which is not virtual, so callers that wait in select() have to ask the TLS client itself
+  int fd() const { return net.fd; }
+
+private:
+  int handshake(const char *host, uint16_t port, int32_t timeout, bool offerSession);
+  bool setup(const char *host, int32_t timeout, bool offerSession);
+  uint32_t sessionKey(const char *host, uint16_t port) const;
+  void loadSession(mbedtls_ssl_session &session);
+  void saveSession(uint32_t key);
+  bool sameSession(const mbedtls_ssl_session &offered);
+  static int verifyPin(void *context, mbedtls_x509_crt *certificate, int depth, uint32_t *flags);
+
+  const TlsSettings &settings;
+  mbedtls_net_context net;
+  mbedtls_ssl_context ssl;
+  mbedtls_ssl_config conf;
+  mbedtls_entropy_context entropy;
+  mbedtls_ctr_drbg_context drbg;
+  mbedtls_x509_crt ca;
+  bool open = false;
+  bool peerClosed = false;
+  int peeked = -1;
+};
+
+#endif
@@ -0,0 +1,83 @@
+// Charge of synthetic phase traces against figures worked out by hand, with the default EnergyProfile:
+// radio 120 mA, CPU 40 mA, SPI 45 mA, panel busy 30 mA, deep sleep 0.15 mA.
+//
+// pio test -e native
+
+#include <unity.h>
+
+#include "energy.h"
+
+static const float TOLERANCE_MAH = 1e-5f;
+
+void setUp()
+{
+}
+
+void tearDown()
+{
+}
+
+static void testEmptyTrace()
+{
+  EnergyProfile profile;
+  PhaseTrace trace;
+  TEST_ASSERT_EQUAL_FLOAT(0.0f, traceChargeMah(profile, trace));
+}
+
+// one hour of deep sleep: 0.15 mA * 1 h = 0.15 mAh
+static void testAllSleep()
+{
+  EnergyProfile profile;
+  PhaseTrace trace;
+  trace.stateMs[POWER_SLEEP] = 3600 * 1000;
+  TEST_ASSERT_FLOAT_WITHIN(TOLERANCE_MAH, 0.15f, traceChargeMah(profile, trace));
+}
+
+// 6 s with the radio on: 120 mA * 6 s / 3600 s/h = 0.2 mAh
+static void testRadioOnly()
+{
+  EnergyProfile profile;
+  PhaseTrace trace;
+  trace.stateMs[POWER_RADIO] = 6000;
+  TEST_ASSERT_FLOAT_WITHIN(TOLERANCE_MAH, 0.2f, traceChargeMah(profile, trace));
+}
+
+// a wake followed by half an hour of sleep:
+//   radio      4.5 s * 120 mA  = 540 mAs   = 0.15 mAh
+//   CPU        1.8 s * 40 mA   = 72 mAs    = 0.02 mAh
+//   SPI        0.8 s * 45 mA   = 36 mAs    = 0.01 mAh
+//   panel     24   s * 30 mA   = 720 mAs   = 0.2 mAh
+//   sleep   1800   s * 0.15 mA = 270 mAs   = 0.075 mAh
+//                                            0.455 mAh
+static void testMixed()
+{
+  EnergyProfile profile;
+  PhaseTrace trace;
+  trace.stateMs[POWER_RADIO] = 4500;
+  trace.stateMs[POWER_CPU] = 1800;
+  trace.stateMs[POWER_SPI] = 800;
+  trace.stateMs[POWER_PANEL_BUSY] = 24000;
+  trace.stateMs[POWER_SLEEP] = 1800 * 1000;
+  TEST_ASSERT_FLOAT_WITHIN(TOLERANCE_MAH, 0.455f, traceChargeMah(profile, trace));
+}
+
+// the measured currents of the config replace the defaults: 2 s at 80 mA = 160 mAs = 0.0444 mAh
+static void testProfileCurrents()
+{
+  EnergyProfile profile;
+  profile.currentMa[POWER_CPU] = 80.0f;
+  PhaseTrace trace;
+  trace.stateMs[POWER_CPU] = 2000;
+  TEST_ASSERT_FLOAT_WITHIN(TOLERANCE_MAH, 160.0f / 3600.0f, traceChargeMah(profile, trace));
+}
+
+int main()
+{
+  UNITY_BEGIN();
+  RUN_TEST(testEmptyTrace);
+  RUN_TEST(testAllSleep);
+  RUN_TEST(testRadioOnly);
+  RUN_TEST(testMixed);
+  RUN_TEST(testProfileCurrents);
+  return UNITY_END();
+}
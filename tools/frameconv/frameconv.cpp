@@ -0,0 +1,469 @@
+// Converts PNG, JPEG and BMP images into native WS75bEPD frames (EPF1) on the host.
+//
+// The images are decoded by the uGFX decoders and drawn through the WS75bEPD driver itself, running on
+// the mock board of board_WS75bEPD_host.h, so the frames are bit exact with what the device would draw.
+// Every worker thread has a display of its own.
+//
+// usage: frameconv [-o DIR] [-r 0|90|180|270] [-d ordered|diffusion] [-s none|fit|fill|center] [-e raw|packbits]
+//                  [-j THREADS] [--bench] [--capture FILE] [--trace FILE] [--refresh full|fast|auto] [--verify FILE] IMAGE...
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+extern "C" {
+  #include "gfx.h"
+  #include "ws75bepd_driver.h"
+  #include "ws75bepd_frame.h"
+  #include "ws75bepd_pack.h"
+}
+
+struct Options
+{
+  std::string outputDir = ".";
+  gOrientation orientation = gOrientation180;
+  WS75bEPDDither dither = WS75bEPD_DITHER_ORDERED;
+  // like the "scale" of config.json, images are drawn as they are at the top left without it
+  bool scale = false;
+  WS75bEPDScaleMode scaleMode = WS75bEPD_SCALE_FIT;
+  gU8 encoding = WS75bEPD_ENCODING_PACKBITS;
+  // measures how fast the payload unpacks, the device does the same while it sends the frame
+  bool bench = false;
+  unsigned threads = 1;
+  // writes the bytes the driver sends to the panel during a flush, only with a single input
+  std::string capture;
+  // writes the commands, delays and busy waits of the simulated panel, only with a single input
+  std::string trace;
+  // waveform of the simulated flush
+  WS75bEPDRefresh refresh = WS75bEPD_REFRESH_FULL;
+  // compares the frame with the bytes captured from a device or by --capture, only with a single input
+  std::string verify;
+  std::vector<std::string> inputs;
+};
+
+// the GFILE table of uGFX is shared by all displays
+static std::mutex gfileMutex;
+static std::mutex outputMutex;
+
+static std::vector<uint8_t> readFile(const std::string &path)
+{
+  std::ifstream file(path, std::ios::binary);
+  if (!file)
+  {
+    throw std::runtime_error("can not read " + path);
+  }
+  return std::vector<uint8_t>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+static void writeFile(const std::string &path, const std::vector<uint8_t> &data)
+{
+  std::ofstream file(path, std::ios::binary);
+  file.write(reinterpret_cast<const char *>(data.data()), data.size());
+  if (!file)
+  {
+    throw std::runtime_error("can not write " + path);
+  }
+}
+
+static std::string framePath(const std::string &outputDir, const std::string &input)
+{
+  size_t slash = input.find_last_of("/\\");
+  std::string name = slash == std::string::npos ? input : input.substr(slash + 1);
+  size_t dot = name.find_last_of('.');
+  if (dot != std::string::npos)
+  {
+    name.resize(dot);
+  }
+  return outputDir + "/" + name + ".epf";
+}
+
+// Draws the image into the frame buffer of the display the same way showImage() does on the device.
+static void render(GDisplay *display, std::vector<uint8_t> &image, const Options &options)
+{
+  gdispGSetOrientation(display, options.orientation);
+  gdispGControl(display, WS75bEPD_CONTROL_DITHER, (void *)(size_t)options.dither);
+  gdispGClear(display, GFX_WHITE);
+
+  // opening and closing a decoder claims and releases a GFILE, drawing only reads from it
+  gdispImage decoder;
+  gdispImageError error;
+  {
+    std::lock_guard<std::mutex> lock(gfileMutex);
+    error = gdispImageOpenGFile(&decoder, gfileOpenMemory(image.data(), "rb"));
+  }
+  if (error == GDISP_IMAGE_ERR_OK)
+  {
+    if (options.scale)
+    {
+      WS75bEPDScale scale = {decoder.width, decoder.height, options.scaleMode};
+      gdispGControl(display, WS75bEPD_CONTROL_SCALE, &scale);
+    }
+    error = gdispGImageDraw(display, &decoder, 0, 0, decoder.width, decoder.height, 0, 0);
+    if (options.scale)
+    {
+      gdispGControl(display, WS75bEPD_CONTROL_SCALE, 0);
+    }
+    std::lock_guard<std::mutex> lock(gfileMutex);
+    gdispImageClose(&decoder);
+  }
+  if (error & GDISP_IMAGE_ERR_UNRECOVERABLE)
+  {
+    throw std::runtime_error("decoding failed with error " + std::to_string(error));
+  }
+}
+
+// The raw payload, the frame buffer in the order it is sent to the panel.
+static std::vector<uint8_t> streamFrame(const gU8 *frame)
+{
+  std::vector<uint8_t> payload(WS75bEPD_FRAME_BYTES);
+  for (gU32 i = 0; i < WS75bEPD_FRAME_BYTES; i++)
+  {
+    payload[i] = ws75bepdStreamByte(frame, i);
+  }
+  return payload;
+}
+
+static std::vector<uint8_t> encodeFrame(const std::vector<uint8_t> &payload, gU8 encoding)
+{
+  std::vector<uint8_t> encoded = payload;
+  if (encoding == WS75bEPD_ENCODING_PACKBITS)
+  {
+    encoded.resize(payload.size() + (payload.size() + 127) / 128);
+    encoded.resize(ws75bepdPack(payload.data(), payload.size(), encoded.data()));
+  }
+
+  WS75bEPDFrameHeader header;
+  header.width = GDISP_SCREEN_WIDTH;
+  header.height = GDISP_SCREEN_HEIGHT;
+  header.encoding = encoding;
+  header.payloadLength = encoded.size();
+  header.payloadCrc = ws75bepdCrc32(0, encoded.data(), encoded.size());
+
+  std::vector<uint8_t> file(WS75bEPD_FRAME_HEADER_SIZE);
+  ws75bepdWriteFrameHeader(&header, file.data());
+  file.insert(file.end(), encoded.begin(), encoded.end());
+  return file;
+}
+
+// Checks and unpacks the frame like the device does and returns the unpacked megabytes per second.
+static double benchUnpack(const std::vector<uint8_t> &file)
+{
+  const int rounds = 200;
+  WS75bEPDFrameHeader header;
+  gU32 checksum = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (int round = 0; round < rounds; round++)
+  {
+    if (!ws75bepdCheckFrame(file.data(), file.size(), &header))
+    {
+      throw std::runtime_error("the frame does not pass its own check");
+    }
+    WS75bEPDUnpacker unpacker;
+    gU8 byte;
+    ws75bepdUnpackBegin(&unpacker, file.data() + WS75bEPD_FRAME_HEADER_SIZE, header.payloadLength);
+    while (ws75bepdUnpackByte(&unpacker, &byte))
+    {
+      checksum += byte;
+    }
+  }
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  // keeps the loop from being optimised away
+  if (checksum == 1)
+  {
+    printf(" ");
+  }
+  return rounds * (double)WS75bEPD_FRAME_BYTES / seconds / 1e6;
+}
+
+// Returns the offset of the first byte that differs from the captured panel stream, -1 if they are equal.
+static long compareStream(const std::vector<uint8_t> &payload, const std::vector<uint8_t> &captured)
+{
+  for (gU32 i = 0; i < payload.size(); i++)
+  {
+    gU8 expected[2];
+    ws75bepdExpandByte(payload[i], expected);
+    for (int k = 0; k < 2; k++)
+    {
+      size_t offset = i * 2 + k;
+      if (offset >= captured.size() || captured[offset] != expected[k])
+      {
+        return offset;
+      }
+    }
+  }
+  return captured.size() == payload.size() * 2 ? -1 : payload.size() * 2;
+}
+
+// Flushes on the mock board as the device would, prints what the panel saw.
+static void flushAndTrace(GDisplay *display, const Options &options)
+{
+  FILE *trace = nullptr;
+  if (!options.trace.empty())
+  {
+    trace = fopen(options.trace.c_str(), "w");
+    if (!trace)
+    {
+      throw std::runtime_error("can not write " + options.trace);
+    }
+    ws75bepdHostTrace(display, trace);
+  }
+  gdispGControl(display, WS75bEPD_CONTROL_REFRESH, (void *)(size_t)options.refresh);
+  gdispGFlush(display);
+  if (trace)
+  {
+    ws75bepdHostTrace(display, nullptr);
+    fclose(trace);
+  }
+
+  WS75bEPDHostStats stats;
+  ws75bepdHostStats(display, &stats);
+  printf("panel: %s refresh, %u commands, %u data bytes, %u resets, %u ms delays, %u ms busy, %u ms in total\n",
+         ws75bepdLastRefresh == WS75bEPD_REFRESH_FAST ? "fast" : "full", (unsigned)stats.commands, (unsigned)stats.dataBytes, (unsigned)stats.resets, (unsigned)stats.delayMs,
+         (unsigned)stats.busyMs, (unsigned)stats.elapsedMs);
+}
+
+static void convert(GDisplay *display, const std::string &input, const Options &options)
+{
+  auto start = std::chrono::steady_clock::now();
+
+  std::vector<uint8_t> image = readFile(input);
+  render(display, image, options);
+  std::vector<uint8_t> payload = streamFrame(ws75bepdFrame(display));
+  std::string output = framePath(options.outputDir, input);
+  std::vector<uint8_t> frame = encodeFrame(payload, options.encoding);
+  writeFile(output, frame);
+
+  if (!options.capture.empty() || !options.trace.empty())
+  {
+    flushAndTrace(display, options);
+  }
+  if (!options.capture.empty())
+  {
+    const gU8 *captured;
+    gU32 length = ws75bepdHostCapture(display, &captured);
+    writeFile(options.capture, std::vector<uint8_t>(captured, captured + length));
+  }
+  if (!options.verify.empty())
+  {
+    long mismatch = compareStream(payload, readFile(options.verify));
+    if (mismatch >= 0)
+    {
+      long pixel = mismatch / 2 * WS75bEPD_PPB;
+      throw std::runtime_error("differs from " + options.verify + " at byte " + std::to_string(mismatch) + ", row " +
+                               std::to_string(pixel / GDISP_SCREEN_WIDTH) + " column " + std::to_string(pixel % GDISP_SCREEN_WIDTH));
+    }
+  }
+
+  long ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+  double unpackRate = options.bench ? benchUnpack(frame) : 0;
+  std::lock_guard<std::mutex> lock(outputMutex);
+  printf("%s (%zu bytes) -> %s (%zu bytes, %.1fx smaller than raw), %ld ms", input.c_str(), image.size(), output.c_str(),
+         frame.size(), (double)(payload.size() + WS75bEPD_FRAME_HEADER_SIZE) / frame.size(), ms);
+  if (options.bench)
+  {
+    printf(", unpacks at %.1f MB/s", unpackRate);
+  }
+  printf("\n");
+}
+
+static void usage()
+{
+  fprintf(stderr, "usage: frameconv [-o DIR] [-r 0|90|180|270] [-d ordered|diffusion] [-s none|fit|fill|center] [-e raw|packbits]\n"
+                  "                 [-j THREADS] [--bench] [--capture FILE] [--trace FILE] [--refresh full|fast|auto] [--verify FILE] IMAGE...\n");
+  exit(2);
+}
+
+static Options parseOptions(int argc, char **argv)
+{
+  Options options;
+  options.threads = std::thread::hardware_concurrency();
+
+  for (int i = 1; i < argc; i++)
+  {
+    std::string arg = argv[i];
+    bool hasValue = i + 1 < argc;
+    if (arg == "-o" && hasValue)
+    {
+      options.outputDir = argv[++i];
+    }
+    else if (arg == "-r" && hasValue)
+    {
+      int degrees = atoi(argv[++i]);
+      switch (degrees)
+      {
+      case 0: options.orientation = gOrientation0; break;
+      case 90: options.orientation = gOrientation90; break;
+      case 180: options.orientation = gOrientation180; break;
+      case 270: options.orientation = gOrientation270; break;
+      default: usage();
+      }
+    }
+    else if (arg == "-d" && hasValue)
+    {
+      std::string mode = argv[++i];
+      if (mode == "ordered")
+      {
+        options.dither = WS75bEPD_DITHER_ORDERED;
+      }
+      else if (mode == "diffusion")
+      {
+        options.dither = WS75bEPD_DITHER_DIFFUSION;
+      }
+      else
+      {
+        usage();
+      }
+    }
+    else if (arg == "-s" && hasValue)
+    {
+      std::string mode = argv[++i];
+      options.scale = mode != "none";
+      if (mode == "fit")
+      {
+        options.scaleMode = WS75bEPD_SCALE_FIT;
+      }
+      else if (mode == "fill")
+      {
+        options.scaleMode = WS75bEPD_SCALE_FILL;
+      }
+      else if (mode == "center")
+      {
+        options.scaleMode = WS75bEPD_SCALE_CENTER;
+      }
+      else if (options.scale)
+      {
+        usage();
+      }
+    }
+    else if (arg == "-e" && hasValue)
+    {
+      std::string encoding = argv[++i];
+      if (encoding == "raw")
+      {
+        options.encoding = WS75bEPD_ENCODING_RAW;
+      }
+      else if (encoding == "packbits")
+      {
+        options.encoding = WS75bEPD_ENCODING_PACKBITS;
+      }
+      else
+      {
+        usage();
+      }
+    }
+    else if (arg == "--bench")
+    {
+      options.bench = true;
+    }
+    else if (arg == "-j" && hasValue)
+    {
+      options.threads = atoi(argv[++i]);
+    }
+    else if (arg == "--capture" && hasValue)
+    {
+      options.capture = argv[++i];
+    }
+    else if (arg == "--trace" && hasValue)
+    {
+      options.trace = argv[++i];
+    }
+    else if (arg == "--refresh" && hasValue)
+    {
+      std::string refresh = argv[++i];
+      if (refresh == "full")
+      {
+        options.refresh = WS75bEPD_REFRESH_FULL;
+      }
+      else if (refresh == "fast")
+      {
+        options.refresh = WS75bEPD_REFRESH_FAST;
+      }
+      else if (refresh == "auto")
+      {
+        options.refresh = WS75bEPD_REFRESH_AUTO;
+      }
+      else
+      {
+        usage();
+      }
+    }
+    else if (arg == "--verify" && hasValue)
+    {
+      options.verify = argv[++i];
+    }
+    else if (arg[0] == '-')
+    {
+      usage();
+    }
+    else
+    {
+      options.inputs.push_back(arg);
+    }
+  }
+
+  bool singleInput = !options.capture.empty() || !options.trace.empty() || !options.verify.empty();
+  if (options.inputs.empty() || (singleInput && options.inputs.size() > 1))
+  {
+    usage();
+  }
+  if (options.threads < 1)
+  {
+    options.threads = 1;
+  }
+  if (options.threads > GDISP_TOTAL_DISPLAYS)
+  {
+    options.threads = GDISP_TOTAL_DISPLAYS;
+  }
+  if (options.threads > options.inputs.size())
+  {
+    options.threads = options.inputs.size();
+  }
+  return options;
+}
+
+int main(int argc, char **argv)
+{
+  Options options = parseOptions(argc, argv);
+  gfxInit();
+
+  std::atomic<size_t> next(0);
+  std::atomic<int> failures(0);
+  std::vector<std::thread> workers;
+  auto start = std::chrono::steady_clock::now();
+
+  for (unsigned t = 0; t < options.threads; t++)
+  {
+    workers.emplace_back([&, t]() {
+      GDisplay *display = gdispGetDisplay(t);
+      for (size_t i = next++; i < options.inputs.size(); i = next++)
+      {
+        try
+        {
+          convert(display, options.inputs[i], options);
+        }
+        catch (const std::exception &e)
+        {
+          failures++;
+          std::lock_guard<std::mutex> lock(outputMutex);
+          fprintf(stderr, "%s: %s\n", options.inputs[i].c_str(), e.what());
+        }
+      }
+    });
+  }
+  for (std::thread &worker : workers)
+  {
+    worker.join();
+  }
+
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  printf("%zu frames in %.2f s on %u threads, %d failed\n", options.inputs.size(), seconds, options.threads, failures.load());
+  return failures ? 1 : 0;
+}
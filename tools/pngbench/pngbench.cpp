@@ -0,0 +1,253 @@
+// Compares the bounded PNG decoding of ws75bepd_png.h with decoding in the wake arena on the host, and measures the
+// JPEG and BMP decoders next to it.
+//
+// Every image is decoded and drawn through the WS75bEPD driver on the mock board of board_WS75bEPD_host.h a number of
+// times. A PNG is checked against the workspace the way showImage() does it and runs in both modes, JPEG and BMP only
+// decode in the arena. Fails if the decoder state of a bounded decode outgrows WS75bEPD_PNG_STATE_BYTES. Prints the time per decode, the throughput in source megapixels per second and the peak working
+// set of the decoder. Like showImage(), JPEG is dithered ordered even with -d diffusion.
+//
+// usage: pngbench [-n ROUNDS] [-d ordered|diffusion] IMAGE...
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "../../src/image_format.h"
+
+extern "C" {
+  #include "gfx.h"
+  #include "wake_arena.h"
+  #include "ws75bepd_driver.h"
+  #include "ws75bepd_png.h"
+}
+
+// the arena only reclaims the last block, so every decode in arena mode leaves its working set behind
+static const size_t ARENA_BYTES = 64 * 1024 * 1024;
+
+struct Options
+{
+  int rounds = 20;
+  WS75bEPDDither dither = WS75bEPD_DITHER_ORDERED;
+  std::vector<std::string> inputs;
+};
+
+struct Result
+{
+  double ms = 0;
+  size_t peakBytes = 0;
+  gdispImageError error = GDISP_IMAGE_ERR_OK;
+};
+
+static std::vector<uint8_t> readFile(const std::string &path)
+{
+  std::ifstream file(path, std::ios::binary);
+  if (!file)
+  {
+    throw std::runtime_error("can not read " + path);
+  }
+  return std::vector<uint8_t>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+// Decodes the image rounds times like showImage() does, returns the mean time and the largest working set.
+static Result decode(GDisplay *display, std::vector<uint8_t> &image, int rounds, bool bounded)
+{
+  Result result;
+  auto start = std::chrono::steady_clock::now();
+  for (int round = 0; round < rounds && !(result.error & GDISP_IMAGE_ERR_UNRECOVERABLE); round++)
+  {
+    size_t arenaBefore = wakeArenaUsed();
+    wakeArenaResetPeak();
+    if (bounded)
+    {
+      ws75bepdPngReset();
+      ws75bepdPngEnter();
+    }
+
+    gdispImage decoder;
+    result.error = gdispImageOpenGFile(&decoder, gfileOpenMemory(image.data(), "rb"));
+    if (result.error == GDISP_IMAGE_ERR_OK)
+    {
+      result.error = gdispGImageDraw(display, &decoder, 0, 0, decoder.width, decoder.height, 0, 0);
+      gdispImageClose(&decoder);
+    }
+
+    if (bounded)
+    {
+      ws75bepdPngLeave();
+    }
+    size_t peak = bounded ? ws75bepdPngPeak() : wakeArenaPeak() + wakeArenaOverflowPeak() - arenaBefore;
+    result.peakBytes = std::max(result.peakBytes, peak);
+  }
+  result.ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / rounds;
+  return result;
+}
+
+static void printResult(const char *mode, const Result &result, uint32_t width, uint32_t height)
+{
+  if (result.error & GDISP_IMAGE_ERR_UNRECOVERABLE)
+  {
+    printf("  %-7s failed with error %d\n", mode, (int)result.error);
+    return;
+  }
+  printf("  %-7s %8.2f ms, %6.2f Mpx/s, peak %zu bytes\n", mode, result.ms,
+         (double)width * height / result.ms / 1000, result.peakBytes);
+}
+
+// JPEG and BMP have no bounded mode, they decode in the arena only.
+static void benchImage(GDisplay *display, std::vector<uint8_t> &image, ImageFormat format, const Options &options)
+{
+  uint32_t width, height;
+  if (!imageSize(image.data(), image.size(), format, width, height))
+  {
+    throw std::runtime_error("no readable header");
+  }
+  printf("%ux%u %s\n", width, height, imageFormatName(format));
+
+  // the JPEG decoder draws MCU by MCU, error diffusion needs the rows in order
+  bool ordered = format == IMAGE_JPEG && options.dither == WS75bEPD_DITHER_DIFFUSION;
+  if (ordered)
+  {
+    gdispGControl(display, WS75bEPD_CONTROL_DITHER, (void *)WS75bEPD_DITHER_ORDERED);
+  }
+  printResult("arena", decode(display, image, options.rounds, false), width, height);
+  if (ordered)
+  {
+    gdispGControl(display, WS75bEPD_CONTROL_DITHER, (void *)WS75bEPD_DITHER_DIFFUSION);
+  }
+}
+
+static void bench(GDisplay *display, const std::string &input, const Options &options)
+{
+  std::vector<uint8_t> image = readFile(input);
+  ImageFormat format = detectImageFormat(image.data(), image.size(), nullptr);
+  if (format != IMAGE_PNG)
+  {
+    if (format != IMAGE_JPEG && format != IMAGE_BMP)
+    {
+      throw std::runtime_error("not a PNG, JPEG or BMP");
+    }
+    printf("%s: ", input.c_str());
+    benchImage(display, image, format, options);
+    return;
+  }
+
+  WS75bEPDPngInfo png;
+  WS75bEPDPngFit fit = ws75bepdPngCheck(image.data(), image.size(), &png);
+  if (fit == WS75bEPD_PNG_INVALID)
+  {
+    throw std::runtime_error("not a PNG");
+  }
+  printf("%s: %ux%u, depth %u, color type %u, %u byte rows\n", input.c_str(), png.width, png.height, png.bitDepth,
+         png.colorType, png.rowBytes);
+
+  printResult("arena", decode(display, image, options.rounds, false), png.width, png.height);
+  if (fit != WS75bEPD_PNG_FITS)
+  {
+    printf("  bounded turned down: %s\n", ws75bepdPngFitName(fit));
+    return;
+  }
+  Result bounded = decode(display, image, options.rounds, true);
+  printResult("bounded", bounded, png.width, png.height);
+  if (bounded.error & GDISP_IMAGE_ERR_UNRECOVERABLE)
+  {
+    return;
+  }
+
+  // the private state of the uGFX decoder is not visible here, so WS75bEPD_PNG_STATE_BYTES is checked against what it
+  // took: the workspace holds everything but the two rows, a bigger state would take room the rows of wider images need
+  size_t state = bounded.peakBytes - 2 * png.rowBytes;
+  size_t stateBytes = GDISP_IMAGE_PNG_Z_BUFFER_SIZE + WS75bEPD_PNG_STATE_BYTES;
+  printf("  state   %zu of %zu bytes\n", state, stateBytes);
+  if (state > stateBytes)
+  {
+    throw std::runtime_error("decoder state exceeds WS75bEPD_PNG_STATE_BYTES");
+  }
+}
+
+static void usage()
+{
+  fprintf(stderr, "usage: pngbench [-n ROUNDS] [-d ordered|diffusion] IMAGE...\n");
+  exit(2);
+}
+
+static Options parseOptions(int argc, char **argv)
+{
+  Options options;
+  for (int i = 1; i < argc; i++)
+  {
+    std::string arg = argv[i];
+    bool hasValue = i + 1 < argc;
+    if (arg == "-n" && hasValue)
+    {
+      options.rounds = atoi(argv[++i]);
+    }
+    else if (arg == "-d" && hasValue)
+    {
+      std::string mode = argv[++i];
+      if (mode == "ordered")
+      {
+        options.dither = WS75bEPD_DITHER_ORDERED;
+      }
+      else if (mode == "diffusion")
+      {
+        options.dither = WS75bEPD_DITHER_DIFFUSION;
+      }
+      else
+      {
+        usage();
+      }
+    }
+    else if (arg[0] == '-')
+    {
+      usage();
+    }
+    else
+    {
+      options.inputs.push_back(arg);
+    }
+  }
+  if (options.inputs.empty() || options.rounds < 1)
+  {
+    usage();
+  }
+  return options;
+}
+
+int main(int argc, char **argv)
+{
+  Options options = parseOptions(argc, argv);
+  if (!wakeArenaInit(ARENA_BYTES))
+  {
+    fprintf(stderr, "can not reserve the arena\n");
+    return 1;
+  }
+  gfxInit();
+
+  // the frame buffer and the diffusion rows are there before the first decode, as on the device
+  GDisplay *display = gdispGetDisplay(0);
+  gdispGControl(display, WS75bEPD_CONTROL_DITHER, (void *)(size_t)options.dither);
+  gdispGClear(display, GFX_WHITE);
+  printf("workspace %u bytes: %u byte window, %u bytes of state, 2 rows of %u bytes\n", WS75bEPD_PNG_WORKSPACE_BYTES,
+         GDISP_IMAGE_PNG_Z_BUFFER_SIZE, WS75bEPD_PNG_STATE_BYTES, WS75bEPD_PNG_ROW_BYTES);
+
+  int failures = 0;
+  for (const std::string &input : options.inputs)
+  {
+    try
+    {
+      bench(display, input, options);
+    }
+    catch (const std::exception &e)
+    {
+      failures++;
+      fprintf(stderr, "%s: %s\n", input.c_str(), e.what());
+    }
+  }
+  return failures ? 1 : 0;
+}
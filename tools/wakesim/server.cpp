@@ -0,0 +1,215 @@
+#include "server.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+static ServerOptions options;
+static ServerStats stats;
+static std::mutex statsMutex;
+static std::mt19937 generator;
+
+static bool sendAll(int socket, const void *data, size_t length)
+{
+  const char *bytes = static_cast<const char *>(data);
+  while (length > 0)
+  {
+    ssize_t sent = send(socket, bytes, length, MSG_NOSIGNAL);
+    if (sent <= 0)
+    {
+      return false;
+    }
+    bytes += sent;
+    length -= sent;
+  }
+  return true;
+}
+
+// The value of a request header, empty if it is missing.
+static std::string requestHeader(const std::string &request, const char *name)
+{
+  size_t start = 0;
+  while ((start = request.find("\r\n", start)) != std::string::npos)
+  {
+    start += 2;
+    size_t length = strlen(name);
+    if (strncasecmp(request.c_str() + start, name, length) == 0 && request[start + length] == ':')
+    {
+      size_t value = request.find_first_not_of(' ', start + length + 1);
+      return request.substr(value, request.find("\r\n", value) - value);
+    }
+  }
+  return "";
+}
+
+static const char *contentType(const std::string &path)
+{
+  static const struct
+  {
+    const char *extension;
+    const char *type;
+  } types[] = {
+      {".png", "image/png"},
+      {".jpg", "image/jpeg"},
+      {".jpeg", "image/jpeg"},
+      {".bmp", "image/bmp"},
+      {".gif", "image/gif"},
+      {".epf", "application/x-epaper-frame"},
+  };
+  for (const auto &type : types)
+  {
+    size_t length = strlen(type.extension);
+    if (path.size() >= length && strcasecmp(path.c_str() + path.size() - length, type.extension) == 0)
+    {
+      return type.type;
+    }
+  }
+  return "application/octet-stream";
+}
+
+static void respond(int socket, int code, const char *reason, const std::string &headers)
+{
+  std::string response = "HTTP/1.1 " + std::to_string(code) + " " + reason + "\r\nConnection: close\r\n" + headers;
+  if (code != 200 && code != 206)
+  {
+    response += "Content-Length: 0\r\n";
+  }
+  response += "\r\n";
+  sendAll(socket, response.data(), response.size());
+}
+
+static void serve(int socket)
+{
+  std::string request;
+  char buffer[1024];
+  while (request.find("\r\n\r\n") == std::string::npos)
+  {
+    ssize_t count = recv(socket, buffer, sizeof(buffer), 0);
+    if (count <= 0)
+    {
+      return;
+    }
+    request.append(buffer, count);
+  }
+
+  std::string path = request.substr(request.find(' ') + 1);
+  path = path.substr(0, path.find_first_of(" ?"));
+
+  std::lock_guard<std::mutex> lock(statsMutex);
+  stats.requests++;
+
+  std::uniform_real_distribution<double> chance(0, 1);
+  if (chance(generator) < options.failHttp)
+  {
+    stats.failed++;
+    respond(socket, 503, "Service Unavailable", "Retry-After: 1\r\n");
+    return;
+  }
+
+  struct stat status;
+  std::string file = options.root + path;
+  if (path.find("..") != std::string::npos || stat(file.c_str(), &status) != 0 || !S_ISREG(status.st_mode))
+  {
+    stats.notFound++;
+    respond(socket, 404, "Not Found", "");
+    return;
+  }
+
+  std::string etag = "\"" + std::to_string(status.st_size) + "-" + std::to_string(status.st_mtime) + "\"";
+  std::string headers = "Content-Type: " + std::string(contentType(path)) + "\r\nETag: " + etag + "\r\n";
+  if (options.refreshHint >= 0)
+  {
+    headers += "X-Next-Refresh: " + std::to_string(options.refreshHint) + "\r\n";
+  }
+
+  if (requestHeader(request, "If-None-Match") == etag)
+  {
+    stats.notModified++;
+    respond(socket, 304, "Not Modified", headers);
+    return;
+  }
+
+  std::ifstream input(file, std::ios::binary);
+  std::vector<char> body((std::istreambuf_iterator<char>(input)), std::istreambuf_iterator<char>());
+
+  size_t start = 0;
+  std::string range = requestHeader(request, "Range");
+  long rangeStart = 0;
+  if (sscanf(range.c_str(), "bytes=%ld-", &rangeStart) == 1 && rangeStart > 0 &&
+      static_cast<size_t>(rangeStart) < body.size())
+  {
+    stats.ranges++;
+    start = rangeStart;
+    headers += "Content-Range: bytes " + std::to_string(start) + "-" + std::to_string(body.size() - 1) + "/" +
+               std::to_string(body.size()) + "\r\n";
+  }
+  headers += "Content-Length: " + std::to_string(body.size() - start) + "\r\n";
+  respond(socket, start ? 206 : 200, start ? "Partial Content" : "OK", headers);
+
+  size_t end = body.size();
+  if (chance(generator) < options.drop)
+  {
+    stats.dropped++;
+    end = start + static_cast<size_t>(chance(generator) * (end - start));
+  }
+  if (sendAll(socket, body.data() + start, end - start))
+  {
+    stats.bodyBytes += end - start;
+  }
+}
+
+static void run(int listener)
+{
+  while (true)
+  {
+    int socket = accept(listener, nullptr, nullptr);
+    if (socket < 0)
+    {
+      continue;
+    }
+    serve(socket);
+    // Connection: close, the client reads until the end of the stream
+    shutdown(socket, SHUT_WR);
+    close(socket);
+  }
+}
+
+uint16_t startServer(const ServerOptions &serverOptions)
+{
+  options = serverOptions;
+  generator.seed(options.seed);
+
+  int listener = socket(AF_INET, SOCK_STREAM, 0);
+  int reuse = 1;
+  setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+  sockaddr_in address = {};
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  socklen_t length = sizeof(address);
+  if (bind(listener, reinterpret_cast<sockaddr *>(&address), length) != 0 || listen(listener, 4) != 0 ||
+      getsockname(listener, reinterpret_cast<sockaddr *>(&address), &length) != 0)
+  {
+    close(listener);
+    return 0;
+  }
+
+  std::thread(run, listener).detach();
+  return ntohs(address.sin_port);
+}
+
+ServerStats serverStats()
+{
+  std::lock_guard<std::mutex> lock(statsMutex);
+  return stats;
+}
@@ -0,0 +1,42 @@
+#ifndef _WAKESIM_SERVER_H_
+#define _WAKESIM_SERVER_H_
+
+// Stand-in for the image server, a thread of the runner that every wake connects to instead of imageUrl.
+//
+// Serves the files of a directory over plain HTTP/1.1 with what download.cpp relies on: ranges, ETags, Content-Type
+// and X-Next-Refresh. Faults are injected at random so the retry and resume paths of the firmware get exercised.
+
+#include <stdint.h>
+
+#include <string>
+
+struct ServerOptions
+{
+  std::string root;
+  // probability that a request is answered with 503
+  double failHttp = 0;
+  // probability that the connection is closed somewhere in the body
+  double drop = 0;
+  // X-Next-Refresh in seconds, not sent if negative
+  long refreshHint = -1;
+  uint32_t seed = 1;
+};
+
+struct ServerStats
+{
+  uint32_t requests = 0;
+  uint32_t notFound = 0;
+  uint32_t notModified = 0;
+  uint32_t ranges = 0;
+  uint32_t failed = 0;
+  uint32_t dropped = 0;
+  uint64_t bodyBytes = 0;
+};
+
+// Starts the server on a free port of the loopback interface and returns the port, 0 if that fails.
+uint16_t startServer(const ServerOptions &options);
+
+// Counters since startServer(), only consistent while no wake is running.
+ServerStats serverStats();
+
+#endif
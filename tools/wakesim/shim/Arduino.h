@@ -0,0 +1,259 @@
+#ifndef _WAKESIM_ARDUINO_H_
+#define _WAKESIM_ARDUINO_H_
+
+// The parts of the ESP32 Arduino core the firmware uses, on the virtual clock of the wake simulator.
+//
+// Only what src/ needs is here, with the behaviour of the ESP32 core where the firmware depends on it: the
+// configTime() time zone, getLocalTime() waiting for the first NTP answer and Serial costing the time of the
+// characters at its baud rate.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <algorithm>
+#include <string>
+
+using std::max;
+using std::min;
+
+#if defined(__GLIBC__) && !__GLIBC_PREREQ(2, 38)
+// newlib of the ESP32 has it, glibc only since 2.38
+extern "C" size_t strlcpy(char *destination, const char *source, size_t size);
+#endif
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define DEC 10
+#define HEX 16
+#define OCT 8
+#define BIN 2
+
+#define PROGMEM
+#define IRAM_ATTR
+// runner and wake copy this section in and out, see wakesim.cpp
+#define RTC_DATA_ATTR __attribute__((section("wakesim_rtc")))
+// kept through every reset but a power on
+#define RTC_NOINIT_ATTR __attribute__((section("wakesim_rtc_noinit")))
+
+class __FlashStringHelper;
+#define F(string_literal) (reinterpret_cast<const __FlashStringHelper *>(string_literal))
+
+unsigned long millis();
+unsigned long micros();
+void delay(uint32_t ms);
+void delayMicroseconds(uint32_t us);
+void yield();
+
+class String
+{
+public:
+  String(const char *value = "") : value(value ? value : "") {}
+  String(const std::string &value) : value(value) {}
+  String(const __FlashStringHelper *value) : value(reinterpret_cast<const char *>(value)) {}
+  explicit String(char c) : value(1, c) {}
+  String(int value, unsigned char base = DEC);
+  String(unsigned int value, unsigned char base = DEC);
+  String(long value, unsigned char base = DEC);
+  String(unsigned long value, unsigned char base = DEC);
+  String(float value, unsigned int decimals = 2);
+  String(double value, unsigned int decimals = 2);
+
+  const char *c_str() const { return value.c_str(); }
+  unsigned int length() const { return value.length(); }
+  char operator[](unsigned int index) const { return index < value.length() ? value[index] : 0; }
+
+  bool equals(const String &other) const { return value == other.value; }
+  bool equalsIgnoreCase(const String &other) const;
+  bool startsWith(const String &prefix) const { return value.compare(0, prefix.value.length(), prefix.value) == 0; }
+  bool endsWith(const String &suffix) const;
+  int indexOf(char c, unsigned int from = 0) const;
+  int indexOf(const String &string, unsigned int from = 0) const;
+  String substring(unsigned int from) const { return substring(from, length()); }
+  String substring(unsigned int from, unsigned int to) const;
+  long toInt() const { return atol(value.c_str()); }
+  float toFloat() const { return atof(value.c_str()); }
+  void trim();
+  void toLowerCase();
+
+  String &operator+=(const String &other)
+  {
+    value += other.value;
+    return *this;
+  }
+  String &operator+=(const char *other)
+  {
+    value += other;
+    return *this;
+  }
+  String &operator+=(char c)
+  {
+    value += c;
+    return *this;
+  }
+  bool operator==(const String &other) const { return value == other.value; }
+  bool operator==(const char *other) const { return value == other; }
+  bool operator!=(const String &other) const { return value != other.value; }
+  bool operator!=(const char *other) const { return value != other; }
+
+  friend String operator+(const String &a, const String &b) { return String(a.value + b.value); }
+  friend String operator+(const String &a, const char *b) { return String(a.value + b); }
+  friend String operator+(const char *a, const String &b) { return String(a + b.value); }
+
+private:
+  std::string value;
+};
+
+class IPAddress
+{
+public:
+  IPAddress(uint8_t a = 0, uint8_t b = 0, uint8_t c = 0, uint8_t d = 0) : bytes{a, b, c, d} {}
+  String toString() const;
+  uint8_t operator[](int index) const { return bytes[index]; }
+
+private:
+  uint8_t bytes[4];
+};
+
+class Print
+{
+public:
+  virtual ~Print() {}
+  virtual size_t write(uint8_t c) = 0;
+  virtual size_t write(const uint8_t *buffer, size_t size);
+  size_t write(const char *string) { return write(reinterpret_cast<const uint8_t *>(string), strlen(string)); }
+
+  size_t print(const __FlashStringHelper *string) { return write(reinterpret_cast<const char *>(string)); }
+  size_t print(const String &string) { return write(string.c_str()); }
+  size_t print(const char *string) { return write(string); }
+  size_t print(char c) { return write(static_cast<uint8_t>(c)); }
+  size_t print(int value, int base = DEC) { return print(static_cast<long>(value), base); }
+  size_t print(unsigned int value, int base = DEC) { return print(static_cast<unsigned long>(value), base); }
+  size_t print(long value, int base = DEC);
+  size_t print(unsigned long value, int base = DEC);
+  size_t print(long long value, int base = DEC);
+  size_t print(unsigned long long value, int base = DEC);
+  size_t print(double value, int digits = 2);
+  size_t print(const struct tm *timeinfo, const char *format = nullptr);
+
+  template <typename T>
+  size_t println(const T &value)
+  {
+    size_t n = print(value);
+    return n + println();
+  }
+  template <typename T>
+  size_t println(const T &value, int format)
+  {
+    size_t n = print(value, format);
+    return n + println();
+  }
+  size_t println(const struct tm *timeinfo, const char *format = nullptr)
+  {
+    size_t n = print(timeinfo, format);
+    return n + println();
+  }
+  size_t println() { return write("\r\n"); }
+  size_t printf(const char *format, ...) __attribute__((format(printf, 2, 3)));
+};
+
+class Stream : public Print
+{
+public:
+  virtual int available() = 0;
+  virtual int read() = 0;
+  virtual int peek() = 0;
+  virtual void flush() {}
+
+  void setTimeout(unsigned long timeout) { _timeout = timeout; }
+  unsigned long getTimeout() const { return _timeout; }
+  size_t readBytes(char *buffer, size_t length);
+  size_t readBytes(uint8_t *buffer, size_t length) { return readBytes(reinterpret_cast<char *>(buffer), length); }
+  String readString();
+  String readStringUntil(char terminator);
+
+protected:
+  // waits up to _timeout for the next byte, -1 if none came
+  int timedRead();
+
+  unsigned long _timeout = 1000;
+};
+
+// Writes to stdout, every character costs its time on the wire like the blocking UART driver.
+class HardwareSerial : public Stream
+{
+public:
+  void begin(unsigned long baud) { this->baud = baud; }
+  void end() {}
+  int available() override { return 0; }
+  int read() override { return -1; }
+  int peek() override { return -1; }
+  void flush() override { fflush(stdout); }
+  size_t write(uint8_t c) override { return write(&c, 1); }
+  size_t write(const uint8_t *buffer, size_t size) override;
+  using Print::write;
+
+private:
+  unsigned long baud = 0;
+};
+
+extern HardwareSerial Serial;
+
+class EspClass
+{
+public:
+  [[noreturn]] void restart();
+  uint32_t getSketchSize() { return 1024 * 1024; }
+  uint32_t getFreeHeap();
+};
+
+extern EspClass ESP;
+
+uint32_t getCpuFrequencyMhz();
+bool setCpuFrequencyMhz(uint32_t mhz);
+uint32_t analogReadMilliVolts(uint8_t pin);
+
+// starts SNTP, the first answer arrives after WakePlan::ntpMs
+void configTime(long gmtOffset_sec, int daylightOffset_sec, const char *server1, const char *server2 = nullptr,
+                const char *server3 = nullptr);
+bool getLocalTime(struct tm *info, uint32_t ms = 5000);
+// esp_sntp.h, sets the time if tv is given, the firmware calls it with NULL
+void sntp_sync_time(struct timeval *tv);
+
+typedef int esp_err_t;
+esp_err_t esp_sleep_enable_timer_wakeup(uint64_t time_in_us);
+[[noreturn]] void esp_deep_sleep_start();
+
+// FreeRTOS with a tick of 1 ms, waiting on a semaphore nobody gives lets the virtual time pass
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef struct WakesimSemaphore *SemaphoreHandle_t;
+#define pdTRUE 1
+#define pdFALSE 0
+#define pdPASS pdTRUE
+#define pdFAIL pdFALSE
+#define portMAX_DELAY 0xffffffffUL
+#define pdMS_TO_TICKS(ms) ((TickType_t)(ms))
+
+// there is no second core, xTaskCreatePinnedToCore() fails and the firmware does the work inline
+typedef void (*TaskFunction_t)(void *);
+typedef struct WakesimTask *TaskHandle_t;
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t function, const char *name, uint32_t stackDepth, void *parameter,
+                                   unsigned int priority, TaskHandle_t *task, BaseType_t core);
+inline BaseType_t xTaskNotifyGive(TaskHandle_t task) { return pdPASS; }
+inline uint32_t ulTaskNotifyTake(BaseType_t clearOnExit, TickType_t ticks) { return 0; }
+
+typedef int portMUX_TYPE;
+#define portMUX_INITIALIZER_UNLOCKED 0
+#define portENTER_CRITICAL(mux) ((void)(mux))
+#define portEXIT_CRITICAL(mux) ((void)(mux))
+
+SemaphoreHandle_t xSemaphoreCreateBinary();
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore);
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticks);
+void vSemaphoreDelete(SemaphoreHandle_t semaphore);
+
+#endif
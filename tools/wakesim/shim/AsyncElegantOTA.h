@@ -0,0 +1,15 @@
+#ifndef _WAKESIM_ASYNCELEGANTOTA_H_
+#define _WAKESIM_ASYNCELEGANTOTA_H_
+
+#include <ESPAsyncWebServer.h>
+
+class AsyncElegantOtaClass
+{
+public:
+  void begin(AsyncWebServer *server, const char *username = "", const char *password = "") {}
+  void loop() {}
+};
+
+extern AsyncElegantOtaClass AsyncElegantOTA;
+
+#endif
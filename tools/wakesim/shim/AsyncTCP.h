@@ -0,0 +1,6 @@
+#ifndef _WAKESIM_ASYNCTCP_H_
+#define _WAKESIM_ASYNCTCP_H_
+
+// ESPAsyncWebServer.h has all there is.
+
+#endif
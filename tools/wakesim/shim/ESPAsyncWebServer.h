@@ -0,0 +1,59 @@
+#ifndef _WAKESIM_ESPASYNCWEBSERVER_H_
+#define _WAKESIM_ESPASYNCWEBSERVER_H_
+
+#include <Arduino.h>
+
+#include <functional>
+#include <vector>
+
+// Nobody browses the simulated board, the handlers are registered and never called.
+
+typedef enum
+{
+  HTTP_GET = 0b00000001,
+  HTTP_POST = 0b00000010,
+  HTTP_ANY = 0b01111111,
+} WebRequestMethod;
+typedef uint8_t WebRequestMethodComposite;
+
+class AsyncWebServerRequest
+{
+public:
+  void send(int code, const String &contentType = String(), const String &content = String()) {}
+};
+
+typedef std::function<void(AsyncWebServerRequest *request)> ArRequestHandlerFunction;
+
+class AsyncWebHandler
+{
+public:
+  virtual ~AsyncWebHandler() {}
+  virtual bool canHandle(AsyncWebServerRequest *request) { return false; }
+};
+
+class AsyncWebServer
+{
+public:
+  explicit AsyncWebServer(uint16_t port) {}
+  ~AsyncWebServer()
+  {
+    for (AsyncWebHandler *handler : handlers)
+    {
+      delete handler;
+    }
+  }
+
+  void begin() {}
+  void end() {}
+  AsyncWebHandler &addHandler(AsyncWebHandler *handler)
+  {
+    handlers.push_back(handler);
+    return *handler;
+  }
+  void on(const char *uri, WebRequestMethodComposite method, ArRequestHandlerFunction onRequest) {}
+
+private:
+  std::vector<AsyncWebHandler *> handlers;
+};
+
+#endif
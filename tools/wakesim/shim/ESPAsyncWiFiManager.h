@@ -0,0 +1,28 @@
+#ifndef _WAKESIM_ESPASYNCWIFIMANAGER_H_
+#define _WAKESIM_ESPASYNCWIFIMANAGER_H_
+
+#include <ESPAsyncWebServer.h>
+#include <WiFi.h>
+
+class DNSServer
+{
+};
+
+// Connects after WakePlan::wifiMs. If the plan fails WiFi, the configuration portal opens and stays open until its
+// timeout, without one the wake hangs there like the real board.
+class AsyncWiFiManager
+{
+public:
+  AsyncWiFiManager(AsyncWebServer *server, DNSServer *dns) {}
+
+  void resetSettings() {}
+  void setConnectTimeout(unsigned long seconds) { connectTimeoutS = seconds; }
+  void setConfigPortalTimeout(unsigned long seconds) { portalTimeoutS = seconds; }
+  bool autoConnect(const char *apName = nullptr, const char *apPassword = nullptr);
+
+private:
+  unsigned long connectTimeoutS = 0;
+  unsigned long portalTimeoutS = 0;
+};
+
+#endif
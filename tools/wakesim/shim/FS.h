@@ -0,0 +1,47 @@
+#ifndef _WAKESIM_FS_H_
+#define _WAKESIM_FS_H_
+
+#include <Arduino.h>
+
+#include <memory>
+
+#define FILE_READ "r"
+#define FILE_WRITE "w"
+#define FILE_APPEND "a"
+
+// A file below WakeContext::fsRoot, copies share the open file like the ones of the ESP32 core.
+class File : public Stream
+{
+public:
+  File() {}
+  explicit File(FILE *file) : file(file, fclose) {}
+
+  size_t write(uint8_t c) override { return write(&c, 1); }
+  size_t write(const uint8_t *buf, size_t size) override;
+  int available() override;
+  int read() override;
+  size_t read(uint8_t *buf, size_t size);
+  int peek() override;
+  void flush() override;
+  bool seek(uint32_t position);
+  size_t position() const;
+  size_t size() const;
+  void close() { file.reset(); }
+  operator bool() const { return file != nullptr; }
+
+private:
+  std::shared_ptr<FILE> file;
+};
+
+class FS
+{
+public:
+  File open(const char *path, const char *mode = FILE_READ);
+  File open(const String &path, const char *mode = FILE_READ) { return open(path.c_str(), mode); }
+  bool exists(const char *path);
+  bool exists(const String &path) { return exists(path.c_str()); }
+  bool remove(const char *path);
+  bool remove(const String &path) { return remove(path.c_str()); }
+};
+
+#endif
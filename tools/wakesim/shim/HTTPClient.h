@@ -0,0 +1,55 @@
+#ifndef _WAKESIM_HTTPCLIENT_H_
+#define _WAKESIM_HTTPCLIENT_H_
+
+#include <Arduino.h>
+#include <WiFiClient.h>
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#define HTTPC_ERROR_CONNECTION_REFUSED (-1)
+#define HTTPC_ERROR_SEND_HEADER_FAILED (-2)
+#define HTTPC_ERROR_NOT_CONNECTED (-4)
+#define HTTPC_ERROR_CONNECTION_LOST (-5)
+#define HTTPC_ERROR_READ_TIMEOUT (-11)
+
+#define HTTP_CODE_OK 200
+#define HTTP_CODE_PARTIAL_CONTENT 206
+#define HTTP_CODE_NOT_MODIFIED 304
+#define HTTP_CODE_NOT_FOUND 404
+#define HTTP_CODE_SERVICE_UNAVAILABLE 503
+
+// The subset of the HTTPClient of the ESP32 core that download.cpp uses, over WiFiClient.
+//
+// Like the original the response body is left in the stream as it came, chunked or not.
+class HTTPClient
+{
+public:
+  ~HTTPClient() { end(); }
+
+  bool begin(String url);
+  bool begin(WiFiClient &client, String url);
+  void end();
+  void addHeader(const String &name, const String &value);
+  void collectHeaders(const char *headerKeys[], size_t headerKeysCount);
+  String header(const char *name);
+  int GET();
+  int getSize() { return size; }
+  WiFiClient *getStreamPtr() { return client; }
+  static String errorToString(int error);
+
+private:
+  bool parseUrl(const String &url);
+
+  WiFiClient ownClient;
+  WiFiClient *client = nullptr;
+  std::string host;
+  uint16_t port = 80;
+  std::string path;
+  std::string requestHeaders;
+  std::vector<std::pair<std::string, std::string>> collected;
+  int size = -1;
+};
+
+#endif
@@ -0,0 +1,14 @@
+#ifndef _WAKESIM_SPIFFS_H_
+#define _WAKESIM_SPIFFS_H_
+
+#include "FS.h"
+
+class SPIFFSFS : public FS
+{
+public:
+  bool begin(bool formatOnFail = false) { return true; }
+};
+
+extern SPIFFSFS SPIFFS;
+
+#endif
@@ -0,0 +1,7 @@
+#ifndef _WAKESIM_STREAM_H_
+#define _WAKESIM_STREAM_H_
+
+// where ArduinoJson looks for Stream with ARDUINOJSON_ENABLE_ARDUINO_STREAM
+#include <Arduino.h>
+
+#endif
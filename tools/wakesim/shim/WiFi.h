@@ -0,0 +1,20 @@
+#ifndef _WAKESIM_WIFI_H_
+#define _WAKESIM_WIFI_H_
+
+#include <Arduino.h>
+#include "WiFiClient.h"
+
+class WiFiClass
+{
+public:
+  bool isConnected() { return connected; }
+  IPAddress localIP() { return connected ? IPAddress(192, 168, 1, 42) : IPAddress(); }
+  bool setSleep(bool enable) { return true; }
+
+  // set by AsyncWiFiManager::autoConnect()
+  bool connected = false;
+};
+
+extern WiFiClass WiFi;
+
+#endif
@@ -0,0 +1,43 @@
+#ifndef _WAKESIM_WIFICLIENT_H_
+#define _WAKESIM_WIFICLIENT_H_
+
+#include <Arduino.h>
+
+// TCP client that connects to the stand-in server of the runner whatever host it is given.
+//
+// Connecting and the first response to a request cost a round trip of WakePlan::rttMs, every byte read costs its time
+// at WakePlan::throughputKBps, or at WakePlan::trickleBps a few bytes at a time. Nothing connects while WiFi is down.
+class WiFiClient : public Stream
+{
+public:
+  WiFiClient() {}
+  virtual ~WiFiClient();
+
+  virtual int connect(IPAddress ip, uint16_t port);
+  virtual int connect(IPAddress ip, uint16_t port, int32_t timeout);
+  virtual int connect(const char *host, uint16_t port);
+  virtual int connect(const char *host, uint16_t port, int32_t timeout);
+  size_t write(uint8_t data) override;
+  size_t write(const uint8_t *buf, size_t size) override;
+  int available() override;
+  int read() override;
+  virtual int read(uint8_t *buf, size_t size);
+  int peek() override;
+  void flush() override {}
+  virtual void stop();
+  virtual uint8_t connected();
+  virtual operator bool() { return connected(); }
+
+  // like the ESP32 core, in seconds
+  int setTimeout(uint32_t seconds);
+  int fd() const { return socket; }
+
+private:
+  // waits a little in real time for the server thread, without costing virtual time
+  bool poll();
+
+  int socket = -1;
+  bool awaitingResponse = false;
+};
+
+#endif
@@ -0,0 +1,496 @@
+#include <Arduino.h>
+#include <esp_heap_caps.h>
+#include <rom/rtc.h>
+
+#include <ctype.h>
+#include <math.h>
+#include <stdarg.h>
+#include <sys/time.h>
+
+#include "../wakesim.h"
+
+HardwareSerial Serial;
+EspClass ESP;
+
+// The clock
+
+static const uint32_t DEFAULT_CPU_MHZ = 240;
+
+// simulated waits of this wake
+static uint64_t waitedUs = 0;
+// scaled CPU time up to cpuMarkNs, the CPU frequency changed then
+static double cpuUs = 0;
+static uint64_t cpuMarkNs = 0;
+static uint32_t cpuMhz = DEFAULT_CPU_MHZ;
+
+static uint64_t hostCpuNs()
+{
+  timespec now;
+  clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &now);
+  return static_cast<uint64_t>(now.tv_sec) * 1000000000ull + now.tv_nsec;
+}
+
+static double scaledCpuUs()
+{
+  return cpuUs + (hostCpuNs() - cpuMarkNs) / 1000.0 * wakesim.cpuScale * DEFAULT_CPU_MHZ / cpuMhz;
+}
+
+void wakesimBeginWake()
+{
+  waitedUs = 0;
+  cpuUs = 0;
+  cpuMarkNs = hostCpuNs();
+  cpuMhz = DEFAULT_CPU_MHZ;
+}
+
+uint64_t wakesimNowUs()
+{
+  return static_cast<uint64_t>(scaledCpuUs()) + waitedUs;
+}
+
+static void checkHangLimit(const char *reason)
+{
+  if (wakesim.hangLimitUs && wakesimNowUs() >= wakesim.hangLimitUs)
+  {
+    wakesimEnd(WAKE_HUNG, 0, reason);
+  }
+}
+
+void wakesimAdvanceUs(uint64_t us)
+{
+  waitedUs += us;
+  checkHangLimit("still awake at the hang limit");
+}
+
+unsigned long millis()
+{
+  checkHangLimit("busy past the hang limit");
+  return wakesimNowUs() / 1000;
+}
+
+unsigned long micros()
+{
+  return wakesimNowUs();
+}
+
+void delay(uint32_t ms)
+{
+  wakesimAdvanceUs(ms * 1000ull);
+}
+
+void delayMicroseconds(uint32_t us)
+{
+  wakesimAdvanceUs(us);
+}
+
+void yield()
+{
+}
+
+uint32_t getCpuFrequencyMhz()
+{
+  return cpuMhz;
+}
+
+bool setCpuFrequencyMhz(uint32_t mhz)
+{
+  cpuUs = scaledCpuUs();
+  cpuMarkNs = hostCpuNs();
+  cpuMhz = mhz;
+  return true;
+}
+
+#if defined(__GLIBC__) && !__GLIBC_PREREQ(2, 38)
+size_t strlcpy(char *destination, const char *source, size_t size)
+{
+  size_t length = strlen(source);
+  if (size)
+  {
+    size_t count = std::min(length, size - 1);
+    memcpy(destination, source, count);
+    destination[count] = '\0';
+  }
+  return length;
+}
+#endif
+
+// String
+
+String::String(int value, unsigned char base) : String(static_cast<long>(value), base)
+{
+}
+
+String::String(unsigned int value, unsigned char base) : String(static_cast<unsigned long>(value), base)
+{
+}
+
+String::String(long value, unsigned char base)
+{
+  if (value < 0 && base == DEC)
+  {
+    this->value = "-" + String(static_cast<unsigned long>(-value), base).value;
+    return;
+  }
+  *this = String(static_cast<unsigned long>(value), base);
+}
+
+String::String(unsigned long value, unsigned char base)
+{
+  static const char digits[] = "0123456789abcdef";
+  do
+  {
+    this->value.insert(this->value.begin(), digits[value % base]);
+    value /= base;
+  } while (value);
+}
+
+String::String(float value, unsigned int decimals) : String(static_cast<double>(value), decimals)
+{
+}
+
+String::String(double value, unsigned int decimals)
+{
+  char buffer[64];
+  snprintf(buffer, sizeof(buffer), "%.*f", decimals, value);
+  this->value = buffer;
+}
+
+bool String::equalsIgnoreCase(const String &other) const
+{
+  return value.length() == other.value.length() && strcasecmp(value.c_str(), other.value.c_str()) == 0;
+}
+
+bool String::endsWith(const String &suffix) const
+{
+  return value.length() >= suffix.value.length() &&
+         value.compare(value.length() - suffix.value.length(), suffix.value.length(), suffix.value) == 0;
+}
+
+int String::indexOf(char c, unsigned int from) const
+{
+  size_t index = value.find(c, from);
+  return index == std::string::npos ? -1 : index;
+}
+
+int String::indexOf(const String &string, unsigned int from) const
+{
+  size_t index = value.find(string.value, from);
+  return index == std::string::npos ? -1 : index;
+}
+
+String String::substring(unsigned int from, unsigned int to) const
+{
+  if (from > to)
+  {
+    std::swap(from, to);
+  }
+  if (from >= value.length())
+  {
+    return String();
+  }
+  return String(value.substr(from, to - from));
+}
+
+void String::trim()
+{
+  size_t start = value.find_first_not_of(" \t\r\n");
+  size_t end = value.find_last_not_of(" \t\r\n");
+  value = start == std::string::npos ? "" : value.substr(start, end - start + 1);
+}
+
+void String::toLowerCase()
+{
+  for (char &c : value)
+  {
+    c = tolower(c);
+  }
+}
+
+String IPAddress::toString() const
+{
+  char buffer[16];
+  snprintf(buffer, sizeof(buffer), "%u.%u.%u.%u", bytes[0], bytes[1], bytes[2], bytes[3]);
+  return String(buffer);
+}
+
+// Print and Stream
+
+size_t Print::write(const uint8_t *buffer, size_t size)
+{
+  size_t n = 0;
+  while (size--)
+  {
+    n += write(*buffer++);
+  }
+  return n;
+}
+
+size_t Print::print(long value, int base)
+{
+  return print(String(value, base));
+}
+
+size_t Print::print(unsigned long value, int base)
+{
+  return print(String(value, base));
+}
+
+size_t Print::print(long long value, int base)
+{
+  return print(static_cast<long>(value), base);
+}
+
+size_t Print::print(unsigned long long value, int base)
+{
+  return print(static_cast<unsigned long>(value), base);
+}
+
+size_t Print::print(double value, int digits)
+{
+  return print(String(value, digits));
+}
+
+size_t Print::print(const struct tm *timeinfo, const char *format)
+{
+  char buffer[64];
+  size_t length = strftime(buffer, sizeof(buffer), format ? format : "%c", timeinfo);
+  return write(reinterpret_cast<const uint8_t *>(buffer), length);
+}
+
+size_t Print::printf(const char *format, ...)
+{
+  char buffer[256];
+  va_list args;
+  va_start(args, format);
+  int length = vsnprintf(buffer, sizeof(buffer), format, args);
+  va_end(args);
+  return write(reinterpret_cast<const uint8_t *>(buffer), std::min<size_t>(std::max(length, 0), sizeof(buffer) - 1));
+}
+
+int Stream::timedRead()
+{
+  unsigned long start = millis();
+  do
+  {
+    int c = read();
+    if (c >= 0)
+    {
+      return c;
+    }
+    delay(1);
+  } while (millis() - start < _timeout);
+  return -1;
+}
+
+size_t Stream::readBytes(char *buffer, size_t length)
+{
+  size_t count = 0;
+  while (count < length)
+  {
+    int c = timedRead();
+    if (c < 0)
+    {
+      break;
+    }
+    buffer[count++] = c;
+  }
+  return count;
+}
+
+String Stream::readString()
+{
+  String string;
+  for (int c = timedRead(); c >= 0; c = timedRead())
+  {
+    string += static_cast<char>(c);
+  }
+  return string;
+}
+
+String Stream::readStringUntil(char terminator)
+{
+  String string;
+  for (int c = timedRead(); c >= 0 && c != terminator; c = timedRead())
+  {
+    string += static_cast<char>(c);
+  }
+  return string;
+}
+
+size_t HardwareSerial::write(const uint8_t *buffer, size_t size)
+{
+  // start bit, 8 data bits and stop bit
+  if (baud)
+  {
+    wakesimAdvanceUs(size * 10 * 1000000ull / baud);
+  }
+  return fwrite(buffer, 1, size, stdout);
+}
+
+// ESP
+
+void EspClass::restart()
+{
+  wakesimEnd(WAKE_RESTARTED, 0, "ESP.restart()");
+}
+
+uint32_t EspClass::getFreeHeap()
+{
+  return heap_caps_get_free_size(MALLOC_CAP_8BIT);
+}
+
+size_t heap_caps_get_free_size(unsigned int caps)
+{
+  return caps & MALLOC_CAP_SPIRAM ? 0 : 180 * 1024;
+}
+
+size_t heap_caps_get_largest_free_block(unsigned int caps)
+{
+  return caps & MALLOC_CAP_SPIRAM ? 0 : 110 * 1024;
+}
+
+RESET_REASON rtc_get_reset_reason(int cpu_no)
+{
+  return static_cast<RESET_REASON>(wakesim.resetReason);
+}
+
+uint32_t analogReadMilliVolts(uint8_t pin)
+{
+  // behind the default divider of 2 in config.json
+  return wakesim.plan.batteryMv / 2;
+}
+
+// Time
+
+// virtual time when the first NTP answer arrives, 0 while SNTP is not running
+static uint64_t ntpAnswerUs = 0;
+
+static bool timeSet()
+{
+  if (!wakesim.timeSet && ntpAnswerUs && wakesimNowUs() >= ntpAnswerUs)
+  {
+    wakesim.timeSet = true;
+  }
+  return wakesim.timeSet;
+}
+
+void configTime(long gmtOffset_sec, int daylightOffset_sec, const char *server1, const char *server2,
+                const char *server3)
+{
+  // the time zone string of the ESP32 core, sign and all
+  char cst[17] = {0};
+  char cdt[17] = "DST";
+  char tz[33] = {0};
+  if (gmtOffset_sec % 3600)
+  {
+    snprintf(cst, sizeof(cst), "UTC%ld:%02ld:%02ld", gmtOffset_sec / 3600, labs((gmtOffset_sec % 3600) / 60),
+             labs(gmtOffset_sec % 60));
+  }
+  else
+  {
+    snprintf(cst, sizeof(cst), "UTC%ld", gmtOffset_sec / 3600);
+  }
+  if (daylightOffset_sec != 3600)
+  {
+    long offset = gmtOffset_sec + daylightOffset_sec;
+    if (offset % 3600)
+    {
+      snprintf(cdt, sizeof(cdt), "DST%ld:%02ld:%02ld", offset / 3600, labs((offset % 3600) / 60), labs(offset % 60));
+    }
+    else
+    {
+      snprintf(cdt, sizeof(cdt), "DST%ld", offset / 3600);
+    }
+  }
+  snprintf(tz, sizeof(tz), "%s%s", cst, cdt);
+  setenv("TZ", tz, 1);
+  tzset();
+
+  if (!wakesim.plan.ntpFails)
+  {
+    ntpAnswerUs = wakesimNowUs() + wakesim.plan.ntpMs * 1000ull;
+  }
+}
+
+bool getLocalTime(struct tm *info, uint32_t ms)
+{
+  uint64_t start = wakesimNowUs();
+  while (!timeSet())
+  {
+    uint64_t waited = wakesimNowUs() - start;
+    if (waited >= ms * 1000ull)
+    {
+      return false;
+    }
+    // the core polls every 10 ms
+    wakesimAdvanceUs(std::min<uint64_t>(10000, ms * 1000ull - waited));
+  }
+  time_t now = wakesim.bootTime + wakesimNowUs() / 1000000;
+  localtime_r(&now, info);
+  return true;
+}
+
+void sntp_sync_time(struct timeval *tv)
+{
+}
+
+// Deep sleep
+
+static uint64_t sleepUs = 0;
+
+esp_err_t esp_sleep_enable_timer_wakeup(uint64_t time_in_us)
+{
+  sleepUs = time_in_us;
+  return 0;
+}
+
+void esp_deep_sleep_start()
+{
+  // no wake up source, only a reset ends this sleep
+  wakesimEnd(WAKE_SLEPT, sleepUs ? sleepUs : UINT64_MAX, "");
+}
+
+// FreeRTOS
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t function, const char *name, uint32_t stackDepth, void *parameter,
+                                   unsigned int priority, TaskHandle_t *task, BaseType_t core)
+{
+  return pdFAIL;
+}
+
+struct WakesimSemaphore
+{
+  bool given = false;
+};
+
+SemaphoreHandle_t xSemaphoreCreateBinary()
+{
+  return new WakesimSemaphore();
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore)
+{
+  if (semaphore->given)
+  {
+    return pdFALSE;
+  }
+  semaphore->given = true;
+  return pdTRUE;
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticks)
+{
+  if (!semaphore->given)
+  {
+    // there is no other task to give it, the whole timeout passes
+    wakesimAdvanceUs(ticks == portMAX_DELAY ? UINT64_MAX / 2 : ticks * 1000ull);
+    return pdFALSE;
+  }
+  semaphore->given = false;
+  return pdTRUE;
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t semaphore)
+{
+  delete semaphore;
+}
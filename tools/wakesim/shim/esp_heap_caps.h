@@ -0,0 +1,21 @@
+#ifndef _WAKESIM_ESP_HEAP_CAPS_H_
+#define _WAKESIM_ESP_HEAP_CAPS_H_
+
+#include <stddef.h>
+
+#define MALLOC_CAP_8BIT (1 << 2)
+#define MALLOC_CAP_SPIRAM (1 << 10)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// what an ESP32 without PSRAM typically has left with WiFi up
+size_t heap_caps_get_free_size(unsigned int caps);
+size_t heap_caps_get_largest_free_block(unsigned int caps);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
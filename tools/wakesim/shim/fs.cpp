@@ -0,0 +1,108 @@
+#include <FS.h>
+#include <SPIFFS.h>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "../wakesim.h"
+
+SPIFFSFS SPIFFS;
+
+static std::string hostPath(const char *path)
+{
+  return std::string(wakesim.fsRoot) + (path[0] == '/' ? "" : "/") + path;
+}
+
+// SPIFFS has no directories, every path below the root can be written
+static void createParents(const std::string &path)
+{
+  for (size_t slash = path.find('/', 1); slash != std::string::npos; slash = path.find('/', slash + 1))
+  {
+    mkdir(path.substr(0, slash).c_str(), 0755);
+  }
+}
+
+size_t File::write(const uint8_t *buf, size_t size)
+{
+  return file ? fwrite(buf, 1, size, file.get()) : 0;
+}
+
+int File::available()
+{
+  return file ? size() - position() : 0;
+}
+
+int File::read()
+{
+  return file ? fgetc(file.get()) : -1;
+}
+
+size_t File::read(uint8_t *buf, size_t size)
+{
+  return file ? fread(buf, 1, size, file.get()) : 0;
+}
+
+int File::peek()
+{
+  if (!file)
+  {
+    return -1;
+  }
+  int c = fgetc(file.get());
+  if (c >= 0)
+  {
+    ungetc(c, file.get());
+  }
+  return c;
+}
+
+void File::flush()
+{
+  if (file)
+  {
+    fflush(file.get());
+  }
+}
+
+bool File::seek(uint32_t position)
+{
+  return file && fseek(file.get(), position, SEEK_SET) == 0;
+}
+
+size_t File::position() const
+{
+  return file ? ftell(file.get()) : 0;
+}
+
+size_t File::size() const
+{
+  struct stat status;
+  // the stat of the host only knows what left the buffer
+  if (!file || fflush(file.get()) != 0 || fstat(fileno(file.get()), &status) != 0)
+  {
+    return 0;
+  }
+  return status.st_size;
+}
+
+File FS::open(const char *path, const char *mode)
+{
+  std::string name = hostPath(path);
+  if (mode[0] != 'r')
+  {
+    createParents(name);
+  }
+  std::string binary = std::string(mode) + "b";
+  FILE *file = fopen(name.c_str(), binary.c_str());
+  return file ? File(file) : File();
+}
+
+bool FS::exists(const char *path)
+{
+  return access(hostPath(path).c_str(), F_OK) == 0;
+}
+
+bool FS::remove(const char *path)
+{
+  return unlink(hostPath(path).c_str()) == 0;
+}
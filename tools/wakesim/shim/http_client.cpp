@@ -0,0 +1,162 @@
+#include <HTTPClient.h>
+
+#include <strings.h>
+
+// how long the status line and the headers may take, like HTTPClient::setTimeout() of the ESP32 core
+static const unsigned long HEADER_TIMEOUT_MS = 5000;
+
+bool HTTPClient::parseUrl(const String &url)
+{
+  std::string text = url.c_str();
+  size_t scheme = text.find("://");
+  if (scheme == std::string::npos)
+  {
+    return false;
+  }
+  port = text.compare(0, scheme, "https") == 0 ? 443 : 80;
+  text = text.substr(scheme + 3);
+
+  size_t slash = text.find('/');
+  path = slash == std::string::npos ? "/" : text.substr(slash);
+  host = text.substr(0, slash);
+  size_t colon = host.find(':');
+  if (colon != std::string::npos)
+  {
+    port = atoi(host.c_str() + colon + 1);
+    host = host.substr(0, colon);
+  }
+  return !host.empty();
+}
+
+bool HTTPClient::begin(String url)
+{
+  client = &ownClient;
+  return parseUrl(url);
+}
+
+bool HTTPClient::begin(WiFiClient &client, String url)
+{
+  this->client = &client;
+  return parseUrl(url);
+}
+
+void HTTPClient::end()
+{
+  if (client)
+  {
+    client->stop();
+  }
+  requestHeaders.clear();
+  size = -1;
+}
+
+void HTTPClient::addHeader(const String &name, const String &value)
+{
+  requestHeaders += std::string(name.c_str()) + ": " + value.c_str() + "\r\n";
+}
+
+void HTTPClient::collectHeaders(const char *headerKeys[], size_t headerKeysCount)
+{
+  collected.clear();
+  for (size_t i = 0; i < headerKeysCount; ++i)
+  {
+    collected.emplace_back(headerKeys[i], "");
+  }
+}
+
+String HTTPClient::header(const char *name)
+{
+  for (const auto &header : collected)
+  {
+    if (strcasecmp(header.first.c_str(), name) == 0)
+    {
+      return String(header.second);
+    }
+  }
+  return String();
+}
+
+int HTTPClient::GET()
+{
+  if (!client)
+  {
+    return HTTPC_ERROR_NOT_CONNECTED;
+  }
+  if (!client->connected() && !client->connect(host.c_str(), port))
+  {
+    return HTTPC_ERROR_CONNECTION_REFUSED;
+  }
+
+  std::string request = "GET " + path + " HTTP/1.1\r\nHost: " + host +
+                        "\r\nUser-Agent: ESP32HTTPClient\r\nConnection: close\r\n" + requestHeaders + "\r\n";
+  if (client->write(reinterpret_cast<const uint8_t *>(request.data()), request.size()) != request.size())
+  {
+    return HTTPC_ERROR_SEND_HEADER_FAILED;
+  }
+
+  for (auto &header : collected)
+  {
+    header.second.clear();
+  }
+  size = -1;
+
+  unsigned long timeout = client->getTimeout();
+  client->Stream::setTimeout(HEADER_TIMEOUT_MS);
+  String status = client->readStringUntil('\n');
+  int code = 0;
+  if (sscanf(status.c_str(), "HTTP/%*d.%*d %d", &code) != 1)
+  {
+    client->Stream::setTimeout(timeout);
+    return client->connected() ? HTTPC_ERROR_READ_TIMEOUT : HTTPC_ERROR_CONNECTION_LOST;
+  }
+
+  while (true)
+  {
+    String line = client->readStringUntil('\n');
+    line.trim();
+    if (line.length() == 0)
+    {
+      break;
+    }
+    int colon = line.indexOf(':');
+    if (colon < 0)
+    {
+      continue;
+    }
+    String name = line.substring(0, colon);
+    String value = line.substring(colon + 1);
+    value.trim();
+    if (name.equalsIgnoreCase("Content-Length"))
+    {
+      size = value.toInt();
+    }
+    for (auto &header : collected)
+    {
+      if (name.equalsIgnoreCase(header.first.c_str()))
+      {
+        header.second = value.c_str();
+      }
+    }
+  }
+  client->Stream::setTimeout(timeout);
+  return code;
+}
+
+String HTTPClient::errorToString(int error)
+{
+  switch (error)
+  {
+  case HTTPC_ERROR_CONNECTION_REFUSED:
+    return F("connection refused");
+  case HTTPC_ERROR_SEND_HEADER_FAILED:
+    return F("send header failed");
+  case HTTPC_ERROR_NOT_CONNECTED:
+    return F("not connected");
+  case HTTPC_ERROR_CONNECTION_LOST:
+    return F("connection lost");
+  case HTTPC_ERROR_READ_TIMEOUT:
+    return F("read Timeout");
+  default:
+    return String();
+  }
+}
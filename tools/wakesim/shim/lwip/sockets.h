@@ -0,0 +1,8 @@
+#ifndef _WAKESIM_LWIP_SOCKETS_H_
+#define _WAKESIM_LWIP_SOCKETS_H_
+
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+
+#endif
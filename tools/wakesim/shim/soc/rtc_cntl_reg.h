@@ -0,0 +1,6 @@
+#ifndef _WAKESIM_RTC_CNTL_REG_H_
+#define _WAKESIM_RTC_CNTL_REG_H_
+
+#define RTC_CNTL_BROWN_OUT_REG 0x3ff480d4
+
+#endif
@@ -0,0 +1,7 @@
+#ifndef _WAKESIM_SOC_H_
+#define _WAKESIM_SOC_H_
+
+#define WRITE_PERI_REG(addr, val) ((void)(addr), (void)(val))
+#define READ_PERI_REG(addr) ((void)(addr), 0)
+
+#endif
@@ -0,0 +1,209 @@
+#include <AsyncElegantOTA.h>
+#include <ESPAsyncWiFiManager.h>
+#include <WiFi.h>
+#include <WiFiClient.h>
+
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "../wakesim.h"
+
+WiFiClass WiFi;
+AsyncElegantOtaClass AsyncElegantOTA;
+
+// real time the server thread gets to answer before a read counts as empty
+static const int SERVER_POLL_MS = 20;
+// WiFi.waitForConnectResult() without a connect timeout
+static const uint32_t DEFAULT_CONNECT_TIMEOUT_MS = 10000;
+// what a trickling server sends at once
+static const size_t TRICKLE_BYTES = 16;
+
+WiFiClient::~WiFiClient()
+{
+  stop();
+}
+
+int WiFiClient::connect(IPAddress ip, uint16_t port)
+{
+  return connect(ip, port, _timeout);
+}
+
+int WiFiClient::connect(IPAddress ip, uint16_t port, int32_t timeout)
+{
+  return connect(ip.toString().c_str(), port, timeout);
+}
+
+int WiFiClient::connect(const char *host, uint16_t port)
+{
+  return connect(host, port, _timeout);
+}
+
+int WiFiClient::connect(const char *host, uint16_t port, int32_t timeout)
+{
+  stop();
+  if (!WiFi.connected)
+  {
+    return 0;
+  }
+
+  wakesimAdvanceUs(wakesim.plan.rttMs * 1000ull);
+
+  // whatever the host, the stand-in server of the runner answers
+  socket = ::socket(AF_INET, SOCK_STREAM, 0);
+  sockaddr_in address = {};
+  address.sin_family = AF_INET;
+  address.sin_port = htons(wakesim.serverPort);
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if (::connect(socket, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0)
+  {
+    stop();
+    return 0;
+  }
+  int noDelay = 1;
+  setsockopt(socket, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+  return 1;
+}
+
+size_t WiFiClient::write(uint8_t data)
+{
+  return write(&data, 1);
+}
+
+size_t WiFiClient::write(const uint8_t *buf, size_t size)
+{
+  if (socket < 0)
+  {
+    return 0;
+  }
+  ssize_t sent = send(socket, buf, size, MSG_NOSIGNAL);
+  if (sent <= 0)
+  {
+    stop();
+    return 0;
+  }
+  awaitingResponse = true;
+  return sent;
+}
+
+bool WiFiClient::poll()
+{
+  if (socket < 0)
+  {
+    return false;
+  }
+  pollfd readable = {socket, POLLIN, 0};
+  return ::poll(&readable, 1, SERVER_POLL_MS) > 0;
+}
+
+int WiFiClient::available()
+{
+  if (!poll())
+  {
+    return 0;
+  }
+  int count = 0;
+  ioctl(socket, FIONREAD, &count);
+  return count;
+}
+
+int WiFiClient::read(uint8_t *buf, size_t size)
+{
+  if (!poll())
+  {
+    return -1;
+  }
+  if (wakesim.plan.trickleBps)
+  {
+    // a few bytes at a time, so the read timeout of the firmware never fires
+    size = std::min<size_t>(size, TRICKLE_BYTES);
+  }
+  ssize_t count = recv(socket, buf, size, MSG_DONTWAIT);
+  if (count <= 0)
+  {
+    return -1;
+  }
+
+  if (awaitingResponse)
+  {
+    // the request went out and the answer came back
+    wakesimAdvanceUs(wakesim.plan.rttMs * 1000ull);
+    awaitingResponse = false;
+  }
+  if (wakesim.plan.trickleBps)
+  {
+    wakesimAdvanceUs(count * 1000000ull / wakesim.plan.trickleBps);
+  }
+  else if (wakesim.plan.throughputKBps)
+  {
+    wakesimAdvanceUs(count * 1000ull / wakesim.plan.throughputKBps);
+  }
+  return count;
+}
+
+int WiFiClient::read()
+{
+  uint8_t data;
+  return read(&data, 1) == 1 ? data : -1;
+}
+
+int WiFiClient::peek()
+{
+  uint8_t data;
+  if (!poll() || recv(socket, &data, 1, MSG_PEEK | MSG_DONTWAIT) != 1)
+  {
+    return -1;
+  }
+  return data;
+}
+
+void WiFiClient::stop()
+{
+  if (socket >= 0)
+  {
+    close(socket);
+    socket = -1;
+  }
+  awaitingResponse = false;
+}
+
+uint8_t WiFiClient::connected()
+{
+  if (socket < 0)
+  {
+    return false;
+  }
+  uint8_t data;
+  ssize_t count = recv(socket, &data, 1, MSG_PEEK | MSG_DONTWAIT);
+  // closed by the server only once everything it sent is read
+  return count > 0 || (count < 0 && (errno == EAGAIN || errno == EWOULDBLOCK));
+}
+
+int WiFiClient::setTimeout(uint32_t seconds)
+{
+  Stream::setTimeout(seconds * 1000);
+  return 0;
+}
+
+bool AsyncWiFiManager::autoConnect(const char *apName, const char *apPassword)
+{
+  if (!wakesim.plan.wifiFails)
+  {
+    wakesimAdvanceUs(wakesim.plan.wifiMs * 1000ull);
+    WiFi.connected = true;
+    return true;
+  }
+
+  wakesimAdvanceUs(connectTimeoutS ? connectTimeoutS * 1000000ull : DEFAULT_CONNECT_TIMEOUT_MS * 1000ull);
+  if (!portalTimeoutS)
+  {
+    // nobody configures the simulated board, the portal waits for ever
+    wakesimEnd(WAKE_HUNG, 0, "configuration portal without timeout");
+  }
+  wakesimAdvanceUs(portalTimeoutS * 1000000ull);
+  return false;
+}
@@ -0,0 +1,644 @@
+// Runs the whole firmware through many wake cycles on the host, against a stand-in image server.
+//
+// Every wake is a fork of the runner that calls setup() on the Arduino shims of tools/wakesim/shim. The wake plays out
+// on a virtual clock: the CPU time of the host scaled to the ESP32, plus the waits a WakePlan drawn for the wake asks
+// for (WiFi, NTP, round trips, throughput), plus the SPI transfers and BUSY waits of the mock panels, up to
+// WS75bEPD_PANELS of them sharing the clock like panels on one board. The RTC_DATA_ATTR variables are carried from one
+// wake to the next like the RTC slow memory: kept through deep sleep, reinitialized after any other reset.
+// RTC_NOINIT_ATTR variables are kept through every reset but a power on. Hangs, restarts, crashes, wakes cut short by
+// the budgets of deadline.h, the BUSY time of every panel and the energy of the whole run are reported at the end.
+//
+// usage: wakesim [-n WAKES] [--fs DIR] [--www DIR] [--seed N] [--cpu-scale X] [--hang-limit S] [--wifi-ms MS]
+//                [--ntp-ms MS] [--rtt-ms MS] [--throughput KBPS] [--fail-wifi P] [--fail-ntp P] [--fail-http P]
+//                [--drop P] [--trickle P] [--refresh-hint S] [--log FILE] [--csv FILE] [-v]
+
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <filesystem>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "config.h"
+#include "deadline.h"
+#include "download.h"
+#include "energy.h"
+#include "metrics.h"
+#include "server.h"
+#include "wakesim.h"
+
+#include <rom/rtc.h>
+
+extern "C" {
+  #include "ws75bepd_driver.h"
+}
+
+// the firmware
+void setup();
+extern Config config;
+extern EnergyLedger energyLedger;
+
+// the RTC_DATA_ATTR and RTC_NOINIT_ATTR variables of the firmware, placed together by the linker
+extern uint8_t __start_wakesim_rtc[] __attribute__((weak));
+extern uint8_t __stop_wakesim_rtc[] __attribute__((weak));
+extern uint8_t __start_wakesim_rtc_noinit[] __attribute__((weak));
+extern uint8_t __stop_wakesim_rtc_noinit[] __attribute__((weak));
+
+WakeContext wakesim;
+
+// 2024-03-04 05:30 UTC, a Monday morning
+static const time_t START_TIME = 1709530200;
+// from the reset until setup() runs
+static const uint64_t BOOT_US = 300 * 1000;
+// a server that stalls without closing the connection
+static const uint32_t TRICKLE_BPS = 64;
+
+struct Options
+{
+  int wakes = 100;
+  std::string fs = "data_template";
+  std::string www = "data";
+  uint32_t seed = 1;
+  double cpuScale = 25.0;
+  uint32_t hangLimitS = 1200;
+  // medians, every wake draws its own around them
+  uint32_t wifiMs = 2500;
+  uint32_t ntpMs = 300;
+  uint32_t rttMs = 40;
+  uint32_t throughputKBps = 150;
+  double failWifi = 0;
+  double failNtp = 0;
+  // probability that the server of a wake trickles its responses at TRICKLE_BPS
+  double trickle = 0;
+  ServerOptions server;
+  std::string log;
+  std::string csv;
+  bool verbose = false;
+};
+
+static const char *outcomeName(WakeOutcome outcome)
+{
+  switch (outcome)
+  {
+  case WAKE_SLEPT:
+    return "slept";
+  case WAKE_RESTARTED:
+    return "restarted";
+  case WAKE_HUNG:
+    return "hung";
+  case WAKE_CRASHED:
+    return "crashed";
+  case WAKE_RETURNED:
+    return "returned";
+  default:
+    return "unknown";
+  }
+}
+
+void wakesimEnd(WakeOutcome outcome, uint64_t sleepUs, const char *reason)
+{
+  WakeResult *result = wakesim.result;
+  result->outcome = outcome;
+  result->wakeUs = wakesimNowUs();
+  result->sleepUs = sleepUs;
+  result->timeSet = wakesim.timeSet;
+  snprintf(result->reason, sizeof(result->reason), "%s", reason);
+  result->phases = phaseMetrics;
+  result->downloads = downloadStatsThisWake;
+  result->deadlines = deadlineStatsThisWake;
+  result->energy = config.energy;
+  if (outcome == WAKE_SLEPT)
+  {
+    result->wakeMah = energyLedger.lastWakeMah;
+    result->sleepMah = energyLedger.lastSleepMah;
+  }
+  for (int i = 0; i < MAX_PANELS; ++i)
+  {
+    // not started before gfxInit()
+    GDisplay *display = gdispGetDisplay(i);
+    if (display)
+    {
+      WS75bEPDHostStats stats;
+      ws75bepdHostStats(display, &stats);
+      result->panelBusyMs[i] = stats.busyMs;
+    }
+  }
+  // checked by the runner to fit
+  size_t dataLength = __stop_wakesim_rtc - __start_wakesim_rtc;
+  size_t noinitLength = __stop_wakesim_rtc_noinit - __start_wakesim_rtc_noinit;
+  memcpy(result->rtc, __start_wakesim_rtc, dataLength);
+  memcpy(result->rtc + dataLength, __start_wakesim_rtc_noinit, noinitLength);
+  result->rtcLength = dataLength + noinitLength;
+  fflush(stdout);
+  _exit(0);
+}
+
+static void terminated()
+{
+  std::exception_ptr exception = std::current_exception();
+  if (exception)
+  {
+    try
+    {
+      std::rethrow_exception(exception);
+    }
+    catch (const std::exception &e)
+    {
+      wakesimEnd(WAKE_CRASHED, 0, e.what());
+    }
+    catch (...)
+    {
+    }
+  }
+  wakesimEnd(WAKE_CRASHED, 0, "std::terminate()");
+}
+
+static void advancePanelClock(gU32 us)
+{
+  wakesimAdvanceUs(us);
+}
+
+// The child side of a wake, never returns.
+[[noreturn]] static void runWake(const Options &options)
+{
+  // the serial output, shown as it is with -v
+  if (!options.verbose)
+  {
+    freopen(options.log.empty() ? "/dev/null" : options.log.c_str(), "a", stdout);
+  }
+
+  std::set_terminate(terminated);
+  // a wake that burns host CPU without ever asking for the time would not notice the hang limit
+  alarm(std::max<uint32_t>(60, options.hangLimitS / 10));
+  ws75bepdHostClock = advancePanelClock;
+  // the panels take turns on one MCU, one refreshes while the next gets its data
+  ws75bepdHostShareClock = gTrue;
+
+  wakesimBeginWake();
+  setup();
+  wakesimEnd(WAKE_RETURNED, 0, "setup() returned");
+}
+
+static uint32_t jitter(std::mt19937 &random, uint32_t median)
+{
+  std::lognormal_distribution<double> distribution(std::log(std::max<uint32_t>(median, 1)), 0.5);
+  return static_cast<uint32_t>(distribution(random));
+}
+
+static WakePlan drawPlan(std::mt19937 &random, const Options &options, uint16_t batteryMv)
+{
+  std::bernoulli_distribution wifiFails(options.failWifi);
+  std::bernoulli_distribution ntpFails(options.failNtp);
+  std::bernoulli_distribution trickles(options.trickle);
+  WakePlan plan;
+  plan.wifiMs = jitter(random, options.wifiMs);
+  plan.wifiFails = wifiFails(random);
+  plan.ntpMs = jitter(random, options.ntpMs);
+  plan.ntpFails = ntpFails(random);
+  plan.rttMs = jitter(random, options.rttMs);
+  plan.throughputKBps = std::max<uint32_t>(jitter(random, options.throughputKBps), 1);
+  plan.trickleBps = trickles(random) ? TRICKLE_BPS : 0;
+  plan.batteryMv = batteryMv;
+  return plan;
+}
+
+struct Summary
+{
+  uint32_t outcomes[WAKE_OUTCOME_COUNT] = {0};
+  std::vector<uint32_t> phaseMs[PHASE_COUNT];
+  std::vector<uint32_t> wakeMs;
+  std::vector<uint32_t> panelBusyMs[MAX_PANELS];
+  std::vector<std::string> reasons;
+  DownloadStats downloads;
+  DeadlineStats deadlines;
+  std::vector<uint32_t> shortfallMs;
+  double mah = 0;
+  double awakeMah = 0;
+  double batteryMah = 0;
+  uint64_t simulatedUs = 0;
+};
+
+static uint32_t percentile(const std::vector<uint32_t> &sorted, double p)
+{
+  return sorted[std::min<size_t>(sorted.size() - 1, static_cast<size_t>(p * sorted.size()))];
+}
+
+static void printDistribution(const char *name, std::vector<uint32_t> values)
+{
+  if (values.empty())
+  {
+    return;
+  }
+  std::sort(values.begin(), values.end());
+  double sum = 0;
+  for (uint32_t value : values)
+  {
+    sum += value;
+  }
+  printf("  %-10s %6zu %9.0f %9u %9u %9u %9u\n", name, values.size(), sum / values.size(), percentile(values, 0.5),
+         percentile(values, 0.9), percentile(values, 0.99), values.back());
+}
+
+static void printSummary(const Summary &summary, int wakes)
+{
+  printf("%d wakes:", wakes);
+  for (int outcome = 0; outcome < WAKE_OUTCOME_COUNT; ++outcome)
+  {
+    if (summary.outcomes[outcome])
+    {
+      printf(" %u %s", summary.outcomes[outcome], outcomeName(static_cast<WakeOutcome>(outcome)));
+    }
+  }
+  printf("\n\n  phase ms    wakes      mean       p50       p90       p99       max\n");
+  for (int phase = 0; phase < PHASE_COUNT; ++phase)
+  {
+    printDistribution(phaseName(static_cast<Phase>(phase)), summary.phaseMs[phase]);
+  }
+  printDistribution("wake", summary.wakeMs);
+  // how far the wakes that were cut short were past their budget
+  printDistribution("shortfall", summary.shortfallMs);
+  for (int i = 0; i < MAX_PANELS; ++i)
+  {
+    char name[16];
+    snprintf(name, sizeof(name), "busy %d", i);
+    printDistribution(name, summary.panelBusyMs[i]);
+  }
+
+  double days = summary.simulatedUs / 1e6 / 86400;
+  printf("\n%.1f days simulated, %.2f mAh (%.2f mAh outside of recorded wakes), %.2f mAh/day", days, summary.mah,
+         summary.awakeMah, days > 0 ? summary.mah / days : 0);
+  if (summary.mah > 0)
+  {
+    printf(", %.0f days on %.0f mAh", summary.batteryMah / (summary.mah / days), summary.batteryMah);
+  }
+  printf("\n");
+
+  const DeadlineStats &deadlines = summary.deadlines;
+  printf("deadlines: %u wakes cut short", deadlines.cutShort);
+  for (int phase = 0; phase < PHASE_COUNT; ++phase)
+  {
+    if (deadlines.cutShortIn[phase])
+    {
+      printf(", %u in %s", deadlines.cutShortIn[phase], phaseName(static_cast<Phase>(phase)));
+    }
+  }
+  printf("\n");
+
+  ServerStats server = serverStats();
+  printf("downloads: %u attempts, %u retries, %u bytes resumed, %u deadline misses\n", summary.downloads.attempts,
+         summary.downloads.retries, summary.downloads.resumedBytes, summary.downloads.deadlineMisses);
+  printf("server: %u requests, %u not modified, %u ranges, %u not found, %u failed, %u dropped, %llu body bytes\n",
+         server.requests, server.notModified, server.ranges, server.notFound, server.failed, server.dropped,
+         static_cast<unsigned long long>(server.bodyBytes));
+
+  if (!summary.reasons.empty())
+  {
+    printf("\nwakes that did not sleep:\n");
+    for (const std::string &reason : summary.reasons)
+    {
+      printf("  %s\n", reason.c_str());
+    }
+  }
+}
+
+static void usage()
+{
+  fprintf(stderr, "usage: wakesim [-n WAKES] [--fs DIR] [--www DIR] [--seed N] [--cpu-scale X] [--hang-limit S] [--wifi-ms MS]\n"
+                  "               [--ntp-ms MS] [--rtt-ms MS] [--throughput KBPS] [--fail-wifi P] [--fail-ntp P] [--fail-http P]\n"
+                  "               [--drop P] [--trickle P] [--refresh-hint S] [--log FILE] [--csv FILE] [-v]\n");
+  exit(2);
+}
+
+static Options parseOptions(int argc, char **argv)
+{
+  Options options;
+
+  for (int i = 1; i < argc; i++)
+  {
+    std::string arg = argv[i];
+    bool hasValue = i + 1 < argc;
+    if (arg == "-n" && hasValue)
+    {
+      options.wakes = atoi(argv[++i]);
+    }
+    else if (arg == "--fs" && hasValue)
+    {
+      options.fs = argv[++i];
+    }
+    else if (arg == "--www" && hasValue)
+    {
+      options.www = argv[++i];
+    }
+    else if (arg == "--seed" && hasValue)
+    {
+      options.seed = strtoul(argv[++i], nullptr, 10);
+    }
+    else if (arg == "--cpu-scale" && hasValue)
+    {
+      options.cpuScale = atof(argv[++i]);
+    }
+    else if (arg == "--hang-limit" && hasValue)
+    {
+      options.hangLimitS = atoi(argv[++i]);
+    }
+    else if (arg == "--wifi-ms" && hasValue)
+    {
+      options.wifiMs = atoi(argv[++i]);
+    }
+    else if (arg == "--ntp-ms" && hasValue)
+    {
+      options.ntpMs = atoi(argv[++i]);
+    }
+    else if (arg == "--rtt-ms" && hasValue)
+    {
+      options.rttMs = atoi(argv[++i]);
+    }
+    else if (arg == "--throughput" && hasValue)
+    {
+      options.throughputKBps = atoi(argv[++i]);
+    }
+    else if (arg == "--fail-wifi" && hasValue)
+    {
+      options.failWifi = atof(argv[++i]);
+    }
+    else if (arg == "--fail-ntp" && hasValue)
+    {
+      options.failNtp = atof(argv[++i]);
+    }
+    else if (arg == "--fail-http" && hasValue)
+    {
+      options.server.failHttp = atof(argv[++i]);
+    }
+    else if (arg == "--drop" && hasValue)
+    {
+      options.server.drop = atof(argv[++i]);
+    }
+    else if (arg == "--trickle" && hasValue)
+    {
+      options.trickle = atof(argv[++i]);
+    }
+    else if (arg == "--refresh-hint" && hasValue)
+    {
+      options.server.refreshHint = atol(argv[++i]);
+    }
+    else if (arg == "--log" && hasValue)
+    {
+      options.log = argv[++i];
+    }
+    else if (arg == "--csv" && hasValue)
+    {
+      options.csv = argv[++i];
+    }
+    else if (arg == "-v")
+    {
+      options.verbose = true;
+    }
+    else
+    {
+      usage();
+    }
+  }
+
+  if (options.wakes < 1 || options.cpuScale <= 0 || options.hangLimitS < 1)
+  {
+    usage();
+  }
+  return options;
+}
+
+int main(int argc, char **argv)
+{
+  Options options = parseOptions(argc, argv);
+
+  // SPIFFS of the simulated board, the wakes write their tile cache into it
+  char fsRoot[] = "/tmp/wakesim-XXXXXX";
+  if (!mkdtemp(fsRoot))
+  {
+    perror("mkdtemp");
+    return 1;
+  }
+  std::error_code error;
+  std::filesystem::copy(options.fs, fsRoot, std::filesystem::copy_options::recursive, error);
+  if (error)
+  {
+    fprintf(stderr, "%s: %s\n", options.fs.c_str(), error.message().c_str());
+    return 1;
+  }
+
+  options.server.root = options.www;
+  options.server.seed = options.seed;
+  uint16_t port = startServer(options.server);
+  if (!port)
+  {
+    perror("server");
+    return 1;
+  }
+
+  size_t rtcLength = __stop_wakesim_rtc - __start_wakesim_rtc;
+  size_t noinitLength = __stop_wakesim_rtc_noinit - __start_wakesim_rtc_noinit;
+  if (rtcLength + noinitLength > WAKESIM_RTC_SIZE)
+  {
+    fprintf(stderr, "%zu bytes of RTC_DATA_ATTR and RTC_NOINIT_ATTR variables do not fit into %u bytes of RTC memory\n",
+            rtcLength + noinitLength, WAKESIM_RTC_SIZE);
+    return 1;
+  }
+  // what RTC memory holds after a power on
+  memset(__start_wakesim_rtc_noinit, 0xa5, noinitLength);
+  // what the bootloader loads into RTC memory on any reset other than a deep sleep wake
+  std::vector<uint8_t> rtcInitial(__start_wakesim_rtc, __stop_wakesim_rtc);
+
+  WakeResult *result = static_cast<WakeResult *>(
+      mmap(nullptr, sizeof(WakeResult), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0));
+  if (result == MAP_FAILED)
+  {
+    perror("mmap");
+    return 1;
+  }
+
+  FILE *csv = options.csv.empty() ? nullptr : fopen(options.csv.c_str(), "w");
+  if (csv)
+  {
+    fprintf(csv, "wake,time,outcome,wake_ms,sleep_s");
+    for (int phase = 0; phase < PHASE_COUNT; ++phase)
+    {
+      fprintf(csv, ",%s_ms", phaseName(static_cast<Phase>(phase)));
+    }
+    fprintf(csv, ",attempts,retries,cut_short_in,shortfall_ms,wake_mah,sleep_mah,reason\n");
+  }
+
+  std::mt19937 random(options.seed);
+  Summary summary;
+  // of config.json, known once a wake has loaded it
+  EnergyProfile profile;
+  time_t now = START_TIME;
+  uint64_t clockUs = 0;
+
+  wakesim.cpuScale = options.cpuScale;
+  wakesim.hangLimitUs = options.hangLimitS * 1000000ull;
+  wakesim.serverPort = port;
+  snprintf(wakesim.fsRoot, sizeof(wakesim.fsRoot), "%s", fsRoot);
+  wakesim.result = result;
+
+  int wake = 0;
+  for (; wake < options.wakes; ++wake)
+  {
+    summary.batteryMah = profile.batteryCapacityMah;
+    double charge = 1 - summary.mah / summary.batteryMah;
+    wakesim.plan = drawPlan(random, options, static_cast<uint16_t>(3300 + 900 * std::max(charge, 0.0)));
+    wakesim.bootTime = now + BOOT_US / 1000000;
+
+    *result = WakeResult();
+    result->outcome = WAKE_OUTCOME_COUNT;
+    fflush(stdout);
+    pid_t child = fork();
+    if (child < 0)
+    {
+      perror("fork");
+      return 1;
+    }
+    if (child == 0)
+    {
+      runWake(options);
+    }
+
+    int status = 0;
+    waitpid(child, &status, 0);
+    bool reported = result->outcome != WAKE_OUTCOME_COUNT;
+    if (!reported)
+    {
+      // killed before it could report, nothing but the outcome is known
+      bool alarmed = WIFSIGNALED(status) && WTERMSIG(status) == SIGALRM;
+      result->outcome = alarmed ? WAKE_HUNG : WAKE_CRASHED;
+      result->wakeUs = alarmed ? wakesim.hangLimitUs : 0;
+      snprintf(result->reason, sizeof(result->reason), "%s",
+               WIFSIGNALED(status) ? strsignal(WTERMSIG(status)) : "exited without reporting");
+      result->timeSet = wakesim.timeSet;
+    }
+    else
+    {
+      profile = result->energy;
+    }
+
+    WakeOutcome outcome = result->outcome;
+    summary.outcomes[outcome]++;
+    summary.wakeMs.push_back(result->wakeUs / 1000);
+    for (int i = 0; i < MAX_PANELS; ++i)
+    {
+      if (result->panelBusyMs[i])
+      {
+        summary.panelBusyMs[i].push_back(result->panelBusyMs[i]);
+      }
+    }
+    for (int phase = 0; phase < PHASE_COUNT; ++phase)
+    {
+      if (result->phases.durationMs[phase])
+      {
+        summary.phaseMs[phase].push_back(result->phases.durationMs[phase]);
+      }
+    }
+    summary.downloads.attempts += result->downloads.attempts;
+    summary.downloads.retries += result->downloads.retries;
+    summary.downloads.resumedBytes += result->downloads.resumedBytes;
+    summary.downloads.deadlineMisses += result->downloads.deadlineMisses;
+    const DeadlineStats &deadlines = result->deadlines;
+    const char *cutShortIn = "";
+    summary.deadlines.cutShort += deadlines.cutShort;
+    summary.deadlines.shortfallMs += deadlines.shortfallMs;
+    for (int phase = 0; phase < PHASE_COUNT; ++phase)
+    {
+      summary.deadlines.cutShortIn[phase] += deadlines.cutShortIn[phase];
+      if (deadlines.cutShortIn[phase])
+      {
+        cutShortIn = phaseName(static_cast<Phase>(phase));
+      }
+    }
+    if (deadlines.cutShort)
+    {
+      summary.shortfallMs.push_back(deadlines.shortfallMs);
+    }
+
+    uint64_t sleepUs = outcome == WAKE_SLEPT ? result->sleepUs : 0;
+    if (outcome == WAKE_SLEPT)
+    {
+      summary.mah += result->wakeMah + result->sleepMah;
+    }
+    else
+    {
+      // nothing was booked, the radio is the worst case of what the board was doing
+      PhaseTrace trace;
+      trace.stateMs[POWER_RADIO] = result->wakeUs / 1000;
+      double mah = traceChargeMah(profile, trace);
+      summary.mah += mah;
+      summary.awakeMah += mah;
+      char reason[128];
+      snprintf(reason, sizeof(reason), "wake %d %s after %.1f s: %s", wake, outcomeName(outcome),
+               result->wakeUs / 1e6, result->reason);
+      summary.reasons.push_back(reason);
+    }
+
+    if (csv)
+    {
+      fprintf(csv, "%d,%lld,%s,%llu,%llu", wake, static_cast<long long>(now), outcomeName(outcome),
+              static_cast<unsigned long long>(result->wakeUs / 1000), static_cast<unsigned long long>(sleepUs / 1000000));
+      for (int phase = 0; phase < PHASE_COUNT; ++phase)
+      {
+        fprintf(csv, ",%u", result->phases.durationMs[phase]);
+      }
+      fprintf(csv, ",%u,%u,%s,%u,%.4f,%.4f,\"%s\"\n", result->downloads.attempts, result->downloads.retries, cutShortIn,
+              deadlines.shortfallMs, result->wakeMah, result->sleepMah, result->reason);
+    }
+
+    // the RTC timer keeps counting through resets, the time from NTP is only lost with the power
+    clockUs += BOOT_US + result->wakeUs + sleepUs;
+    now = START_TIME + clockUs / 1000000;
+    wakesim.timeSet = result->timeSet;
+
+    if (outcome == WAKE_SLEPT)
+    {
+      if (result->sleepUs == UINT64_MAX)
+      {
+        printf("wake %d went to sleep without a wake up source\n", wake + 1);
+        ++wake;
+        break;
+      }
+      memcpy(__start_wakesim_rtc, result->rtc, rtcLength);
+      memcpy(__start_wakesim_rtc_noinit, result->rtc + rtcLength, noinitLength);
+      wakesim.resetReason = DEEPSLEEP_RESET;
+    }
+    else if (outcome == WAKE_HUNG || outcome == WAKE_RETURNED)
+    {
+      // somebody notices the frame is stuck and cycles the power
+      memcpy(__start_wakesim_rtc, rtcInitial.data(), rtcLength);
+      memset(__start_wakesim_rtc_noinit, 0xa5, noinitLength);
+      wakesim.resetReason = POWERON_RESET;
+      wakesim.timeSet = false;
+    }
+    else
+    {
+      // ESP.restart() and panics reset the CPU, a wake killed before it reported leaves the RTC memory as it was
+      memcpy(__start_wakesim_rtc, rtcInitial.data(), rtcLength);
+      if (reported)
+      {
+        memcpy(__start_wakesim_rtc_noinit, result->rtc + rtcLength, noinitLength);
+      }
+      wakesim.resetReason = SW_CPU_RESET;
+    }
+  }
+  summary.simulatedUs = clockUs;
+
+  if (csv)
+  {
+    fclose(csv);
+  }
+  printSummary(summary, wake);
+  std::filesystem::remove_all(fsRoot, error);
+  return summary.outcomes[WAKE_HUNG] || summary.outcomes[WAKE_CRASHED] || summary.outcomes[WAKE_RETURNED] ? 1 : 0;
+}
@@ -0,0 +1,102 @@
+#ifndef _WAKESIM_H_
+#define _WAKESIM_H_
+
+// Interface between the wake simulator (wakesim.cpp) and the Arduino shims the firmware runs on.
+//
+// Every wake runs in a process forked off the runner. The runner draws a WakePlan for it, the shims act it out on a
+// virtual clock and the wake reports back through a WakeResult in memory shared with the runner.
+
+#include <stdint.h>
+#include <time.h>
+
+#include "config.h"
+#include "deadline.h"
+#include "download.h"
+#include "energy.h"
+#include "metrics.h"
+
+// RTC slow memory of the ESP32, RTC_DATA_ATTR and RTC_NOINIT_ATTR variables beyond it would not link on the device
+const uint32_t WAKESIM_RTC_SIZE = 8 * 1024;
+
+// What one wake runs into, drawn by the runner before the wake starts.
+struct WakePlan
+{
+  uint32_t wifiMs = 0;
+  // autoConnect() opens the configuration portal and never returns
+  bool wifiFails = false;
+  uint32_t ntpMs = 0;
+  bool ntpFails = false;
+  // every TCP connect and every request costs a round trip
+  uint32_t rttMs = 0;
+  // 1 kB/s is 1 byte per ms
+  uint32_t throughputKBps = 0;
+  // the server trickles the body at this many bytes per second instead, 0 if it does not
+  uint32_t trickleBps = 0;
+  uint16_t batteryMv = 0;
+};
+
+enum WakeOutcome : uint8_t
+{
+  WAKE_SLEPT,     // esp_deep_sleep_start()
+  WAKE_RESTARTED, // ESP.restart()
+  WAKE_HUNG,      // still awake at the hang limit, the board would drain its battery
+  WAKE_CRASHED,   // killed by a signal or an uncaught exception
+  WAKE_RETURNED,  // setup() returned, the board would stay awake in loop()
+  WAKE_OUTCOME_COUNT
+};
+
+// Written by the wake right before it ends, in memory shared with the runner.
+struct WakeResult
+{
+  WakeOutcome outcome;
+  uint64_t wakeUs;
+  uint64_t sleepUs;
+  // the RTC timer has the time from NTP, it keeps running through deep sleep and software resets
+  bool timeSet;
+  char reason[64];
+  PhaseMetrics phases;
+  DownloadStats downloads;
+  DeadlineStats deadlines;
+  EnergyProfile energy;
+  // charge booked by recordEnergy(), only if the wake slept
+  float wakeMah;
+  float sleepMah;
+  // BUSY of the mock panels, 0 for a panel that did not refresh
+  uint32_t panelBusyMs[MAX_PANELS];
+  // the RTC_DATA_ATTR variables followed by the RTC_NOINIT_ATTR ones
+  uint32_t rtcLength;
+  uint8_t rtc[WAKESIM_RTC_SIZE];
+};
+
+// Set up by the runner before every fork, the wake only reads it.
+struct WakeContext
+{
+  WakePlan plan;
+  // the RESET_REASON of rom/rtc.h
+  int resetReason = 1;
+  bool timeSet = false;
+  // wall clock when the wake started
+  time_t bootTime = 0;
+  // CPU time of the host is multiplied by this, the ESP32 is that much slower
+  double cpuScale = 25.0;
+  uint64_t hangLimitUs = 0;
+  uint16_t serverPort = 0;
+  char fsRoot[256] = "";
+  WakeResult *result = nullptr;
+};
+
+extern WakeContext wakesim;
+
+// Virtual time since the wake started: the CPU time of the wake scaled by cpuScale plus every simulated wait.
+uint64_t wakesimNowUs();
+
+// Lets simulated time pass, ends the wake as hung at the hang limit.
+void wakesimAdvanceUs(uint64_t us);
+
+// Reports the wake to the runner and terminates the process.
+[[noreturn]] void wakesimEnd(WakeOutcome outcome, uint64_t sleepUs, const char *reason);
+
+// Starts the virtual clock of a freshly forked wake.
+void wakesimBeginWake();
+
+#endif